@@ -0,0 +1,189 @@
+#include "activation.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+
+#include "simd.hpp"
+
+namespace activation {
+
+using matrix::ConstMatrixView;
+using matrix::MatrixView;
+
+namespace {
+
+// Columns normalized at once by softmax; their maxima and sums live on the
+// stack, and every row of the chunk is one vectorized kernel call.
+constexpr size_t SOFTMAX_CHUNK = 64;
+
+void check_same_shape(ConstMatrixView a, ConstMatrixView b) {
+    if (a.N != b.N || a.M != b.M) {
+        throw std::invalid_argument("Matrix dimensions must match for activation");
+    }
+}
+
+}  // namespace
+
+Kind parse(const std::string& name) {
+    for (Kind kind :
+         {Kind::Sigmoid, Kind::Tanh, Kind::ReLU, Kind::LeakyReLU, Kind::GELU,
+          Kind::Softmax}) {
+        if (name == activation::name(kind)) {
+            return kind;
+        }
+    }
+    throw std::invalid_argument("Unknown activation: " + name);
+}
+
+const char* name(Kind kind) {
+    switch (kind) {
+        case Kind::Sigmoid:
+            return "sigmoid";
+        case Kind::Tanh:
+            return "tanh";
+        case Kind::ReLU:
+            return "relu";
+        case Kind::LeakyReLU:
+            return "leaky_relu";
+        case Kind::GELU:
+            return "gelu";
+        case Kind::Softmax:
+            return "softmax";
+    }
+    return "unknown";
+}
+
+matrix::Activation kernel(Kind kind) {
+    switch (kind) {
+        case Kind::Sigmoid:
+            return simd::sigmoid;
+        case Kind::Tanh:
+            return simd::tanh;
+        case Kind::ReLU:
+            return simd::relu;
+        case Kind::LeakyReLU:
+            return simd::leaky_relu;
+        case Kind::GELU:
+            return simd::gelu;
+        case Kind::Softmax:
+            return nullptr;
+    }
+    return nullptr;
+}
+
+matrix::Combine backward_kernel(Kind kind) {
+    switch (kind) {
+        case Kind::Sigmoid:
+            return simd::sigmoid_backward;
+        case Kind::Tanh:
+            return simd::tanh_backward;
+        case Kind::ReLU:
+            return simd::relu_backward;
+        case Kind::LeakyReLU:
+            return simd::leaky_relu_backward;
+        case Kind::GELU:
+        case Kind::Softmax:
+            return nullptr;
+    }
+    return nullptr;
+}
+
+void forward(Kind kind, ConstMatrixView x, MatrixView y) {
+    check_same_shape(x, y);
+    if (kind == Kind::Softmax) {
+        softmax(x, y);
+        return;
+    }
+    auto func = kernel(kind);
+    if (x.contiguous() && y.contiguous()) {
+        func(x.data, y.data, x.N * x.M);
+        return;
+    }
+    for (size_t i = 0; i < x.N; ++i) {
+        func(x.row(i), y.row(i), x.M);
+    }
+}
+
+void backward(
+    Kind kind,
+    ConstMatrixView g,
+    ConstMatrixView x,
+    ConstMatrixView y,
+    MatrixView out
+) {
+    check_same_shape(g, x);
+    check_same_shape(g, y);
+    check_same_shape(g, out);
+    if (kind == Kind::Softmax) {
+        softmax_backward(g, y, out);
+        return;
+    }
+    if (kind == Kind::GELU) {
+        for (size_t i = 0; i < g.N; ++i) {
+            simd::gelu_backward(g.row(i), x.row(i), y.row(i), out.row(i), g.M);
+        }
+        return;
+    }
+    g.elementwise_into(y, out, backward_kernel(kind));
+}
+
+void softmax(ConstMatrixView x, MatrixView y) {
+    check_same_shape(x, y);
+    if (x.N == 0) {
+        return;
+    }
+    float peak[SOFTMAX_CHUNK];
+    float sum[SOFTMAX_CHUNK];
+    for (size_t j = 0; j < x.M; j += SOFTMAX_CHUNK) {
+        size_t width = std::min(SOFTMAX_CHUNK, x.M - j);
+
+        std::copy(x.row(0) + j, x.row(0) + j + width, peak);
+        for (size_t i = 1; i < x.N; ++i) {
+            const float* r = x.row(i) + j;
+            for (size_t s = 0; s < width; ++s) {
+                peak[s] = std::max(peak[s], r[s]);
+            }
+        }
+
+        std::fill(sum, sum + width, 0.0f);
+        for (size_t i = 0; i < x.N; ++i) {
+            float* r = y.row(i) + j;
+            simd::sub(x.row(i) + j, peak, r, width);
+            simd::exp(r, r, width);
+            simd::add(sum, r, sum, width);
+        }
+
+        for (size_t s = 0; s < width; ++s) {
+            sum[s] = 1.0f / sum[s];
+        }
+        for (size_t i = 0; i < x.N; ++i) {
+            float* r = y.row(i) + j;
+            simd::mul(r, sum, r, width);
+        }
+    }
+}
+
+void softmax_backward(ConstMatrixView g, ConstMatrixView y, MatrixView out) {
+    check_same_shape(g, y);
+    check_same_shape(g, out);
+    float dot[SOFTMAX_CHUNK];
+    float product[SOFTMAX_CHUNK];
+    for (size_t j = 0; j < g.M; j += SOFTMAX_CHUNK) {
+        size_t width = std::min(SOFTMAX_CHUNK, g.M - j);
+
+        std::fill(dot, dot + width, 0.0f);
+        for (size_t i = 0; i < g.N; ++i) {
+            simd::mul(g.row(i) + j, y.row(i) + j, product, width);
+            simd::add(dot, product, dot, width);
+        }
+
+        for (size_t i = 0; i < g.N; ++i) {
+            float* r = out.row(i) + j;
+            simd::sub(g.row(i) + j, dot, r, width);
+            simd::mul(r, y.row(i) + j, r, width);
+        }
+    }
+}
+
+}  // namespace activation
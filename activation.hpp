@@ -0,0 +1,55 @@
+#ifndef ACTIVATION_HPP
+#define ACTIVATION_HPP
+
+#include <string>
+
+#include "matrix.hpp"
+
+namespace activation {
+
+// Activation functions of a layer. Layers hold one sample per column, so
+// softmax normalizes every column on its own; the others are elementwise.
+enum class Kind { Sigmoid, Tanh, ReLU, LeakyReLU, GELU, Softmax };
+
+// Parses sigmoid, tanh, relu, leaky_relu, gelu or softmax.
+// Throws std::invalid_argument for any other name.
+Kind parse(const std::string& name);
+
+const char* name(Kind kind);
+
+// Buffer kernel for the fused layer products (see matrix.hpp), or nullptr
+// for softmax, which needs whole columns and runs as its own pass.
+matrix::Activation kernel(Kind kind);
+
+// Combine kernel out = g * f'(x) taking the activated output y as its
+// operand, for transpose_multiply_elementwise_into. nullptr for GELU and
+// softmax, whose backward needs more than y; use backward instead.
+matrix::Combine backward_kernel(Kind kind);
+
+// y = f(x). y may be the same view as x.
+void forward(Kind kind, matrix::ConstMatrixView x, matrix::MatrixView y);
+
+// out = dL/dx given g = dL/dy, the input x and the output y of forward. The
+// derivatives are evaluated from y (and x for GELU) without transcendental
+// calls. out may be the same view as g.
+void backward(
+    Kind kind,
+    matrix::ConstMatrixView g,
+    matrix::ConstMatrixView x,
+    matrix::ConstMatrixView y,
+    matrix::MatrixView out
+);
+
+// y = softmax of every column of x, shifted by the column maximum so that
+// exp cannot overflow. y may be the same view as x.
+void softmax(matrix::ConstMatrixView x, matrix::MatrixView y);
+
+// out = y * (g - sum(g * y)) per column, the softmax Jacobian applied to g.
+// out may be the same view as g.
+void softmax_backward(
+    matrix::ConstMatrixView g, matrix::ConstMatrixView y, matrix::MatrixView out
+);
+
+}  // namespace activation
+
+#endif  // ACTIVATION_HPP
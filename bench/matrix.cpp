@@ -0,0 +1,391 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "activation.hpp"
+#include "gemm.hpp"
+#include "matrix.hpp"
+#include "network.hpp"
+#include "optimizer.hpp"
+#include "parallel.hpp"
+#include "precision.hpp"
+#include "quantize.hpp"
+#include "simd.hpp"
+#include "trainer.hpp"
+
+using namespace matrix;
+
+static Matrix random_matrix(size_t n, size_t m) {
+    std::mt19937 gen(static_cast<unsigned>(n * 31 + m + 1));
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    return Matrix(n, m, [&](size_t, size_t) { return dist(gen); });
+}
+
+// Reports the multiply-adds of an m x n x k product as FLOP/s and the bytes
+// of A, B and C touched once per iteration as bytes/s
+static void set_gemm_counters(
+    benchmark::State& state, size_t m, size_t n, size_t k
+) {
+    state.counters["FLOP/s"] = benchmark::Counter(
+        2.0 * m * n * k, benchmark::Counter::kIsIterationInvariantRate
+    );
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations()) *
+        static_cast<int64_t>((m * k + k * n + m * n) * sizeof(float))
+    );
+}
+
+// Product shapes as {m, k, n}: the layers of a 784-wide input network for
+// batch sizes 1 to 256, plus one large square product
+static void gemm_shapes(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"m", "k", "n"});
+    for (int64_t rows : {16, 128}) {
+        for (int64_t batch : {1, 8, 32, 64, 128, 256}) {
+            b->Args({rows, 784, batch});
+        }
+    }
+    b->Args({1024, 1024, 1024});
+}
+
+// result = A*B, e.g. weights times a batch of columns
+static void BM_MultiplyInto(benchmark::State& state) {
+    size_t m = state.range(0), k = state.range(1), n = state.range(2);
+    Matrix A = random_matrix(m, k);
+    Matrix B = random_matrix(k, n);
+    Matrix C(m, n);
+    for (auto _ : state) {
+        A.multiply_into(B, C);
+        benchmark::DoNotOptimize(C.view().data);
+        benchmark::ClobberMemory();
+    }
+    set_gemm_counters(state, m, n, k);
+}
+BENCHMARK(BM_MultiplyInto)->Apply(gemm_shapes);
+
+// result = A * B^T, e.g. weights times a batch stored one sample per row
+static void BM_MultiplyTransposeInto(benchmark::State& state) {
+    size_t m = state.range(0), k = state.range(1), n = state.range(2);
+    Matrix A = random_matrix(m, k);
+    Matrix B = random_matrix(n, k);
+    Matrix C(m, n);
+    for (auto _ : state) {
+        A.multiply_transpose_into(B, C);
+        benchmark::DoNotOptimize(C.view().data);
+        benchmark::ClobberMemory();
+    }
+    set_gemm_counters(state, m, n, k);
+}
+BENCHMARK(BM_MultiplyTransposeInto)->Apply(gemm_shapes);
+
+// result = A*B with both operands stored in 16 bits (format is 1 for bf16,
+// 2 for fp16), e.g. a mixed-precision forward pass. Bytes count the stored
+// operands.
+static void BM_MixedPrecisionGemm(benchmark::State& state) {
+    size_t m = state.range(0), k = state.range(1), n = state.range(2);
+    auto format = state.range(3) == 1 ? precision::Format::BF16
+                                      : precision::Format::FP16;
+    Matrix A = random_matrix(m, k);
+    Matrix B = random_matrix(k, n);
+    std::vector<uint16_t> a(m * k);
+    std::vector<uint16_t> b(k * n);
+    precision::encode(format, A.view().data, a.data(), a.size());
+    precision::encode(format, B.view().data, b.data(), b.size());
+    Matrix C(m, n);
+    for (auto _ : state) {
+        gemm::gemm(
+            gemm::Transpose::No,
+            gemm::Transpose::No,
+            m,
+            n,
+            k,
+            1.0f,
+            {a.data(), k, format},
+            {b.data(), n, format},
+            0.0f,
+            C.view().data,
+            n
+        );
+        benchmark::DoNotOptimize(C.view().data);
+        benchmark::ClobberMemory();
+    }
+    state.SetLabel(precision::name(format));
+    state.counters["FLOP/s"] = benchmark::Counter(
+        2.0 * m * n * k, benchmark::Counter::kIsIterationInvariantRate
+    );
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations()) *
+        static_cast<int64_t>((m * k + k * n) * 2 + m * n * sizeof(float))
+    );
+}
+BENCHMARK(BM_MixedPrecisionGemm)
+    ->ArgNames({"m", "k", "n", "format"})
+    ->ArgsProduct({{16, 128}, {784}, {1, 64, 256}, {1, 2}})
+    ->Args({1024, 1024, 1024, 1});
+
+// result = A^T * B, e.g. the error propagated back through the weights
+static void BM_TransposeMultiplyInto(benchmark::State& state) {
+    size_t m = state.range(0), k = state.range(1), n = state.range(2);
+    Matrix A = random_matrix(k, m);
+    Matrix B = random_matrix(k, n);
+    Matrix C(m, n);
+    for (auto _ : state) {
+        A.transpose_multiply_into(B, C);
+        benchmark::DoNotOptimize(C.view().data);
+        benchmark::ClobberMemory();
+    }
+    set_gemm_counters(state, m, n, k);
+}
+BENCHMARK(BM_TransposeMultiplyInto)->Apply(gemm_shapes);
+
+// Elementwise shapes as {rows, cols}: layer activations over batch sizes 1 to
+// 256, plus a weight matrix
+static void elementwise_shapes(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"n", "m"});
+    for (int64_t rows : {16, 128, 784}) {
+        for (int64_t batch : {1, 32, 256}) {
+            b->Args({rows, batch});
+        }
+    }
+    b->Args({1024, 1024});
+}
+
+// Reports n floats read from each of inputs buffers and written once
+static void set_elementwise_counters(
+    benchmark::State& state, size_t n, size_t inputs
+) {
+    state.SetItemsProcessed(
+        static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(n)
+    );
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations()) *
+        static_cast<int64_t>((inputs + 1) * n * sizeof(float))
+    );
+}
+
+template <typename Func>
+static void BM_Apply(benchmark::State& state, Func func) {
+    size_t n = state.range(0), m = state.range(1);
+    Matrix A = random_matrix(n, m);
+    for (auto _ : state) {
+        A.apply(func);
+        benchmark::DoNotOptimize(A.view().data);
+        benchmark::ClobberMemory();
+    }
+    set_elementwise_counters(state, n * m, 1);
+}
+BENCHMARK_CAPTURE(BM_Apply, Sigmoid, simd::Sigmoid{})
+    ->Apply(elementwise_shapes);
+BENCHMARK_CAPTURE(BM_Apply, SigmoidDerivative, simd::SigmoidDerivative{})
+    ->Apply(elementwise_shapes);
+BENCHMARK_CAPTURE(BM_Apply, Scale, simd::Scale{0.5f})
+    ->Apply(elementwise_shapes);
+
+template <typename Func>
+static void BM_Elementwise(benchmark::State& state, Func func) {
+    size_t n = state.range(0), m = state.range(1);
+    Matrix A = random_matrix(n, m);
+    Matrix B = random_matrix(n, m);
+    Matrix C(n, m);
+    for (auto _ : state) {
+        A.elementwise_into(B, C, func);
+        benchmark::DoNotOptimize(C.view().data);
+        benchmark::ClobberMemory();
+    }
+    set_elementwise_counters(state, n * m, 2);
+}
+BENCHMARK_CAPTURE(BM_Elementwise, Add, simd::Add{})
+    ->Apply(elementwise_shapes);
+BENCHMARK_CAPTURE(BM_Elementwise, Sub, simd::Sub{})
+    ->Apply(elementwise_shapes);
+BENCHMARK_CAPTURE(BM_Elementwise, Axpy, simd::Axpy{-0.1f})
+    ->Apply(elementwise_shapes);
+BENCHMARK_CAPTURE(
+    BM_Elementwise, MulSigmoidDerivative, simd::MulSigmoidDerivative{}
+)
+    ->Apply(elementwise_shapes);
+
+// Forward and backward pass of every activation over a layer
+static void BM_Activation(benchmark::State& state, activation::Kind kind) {
+    size_t n = state.range(0), m = state.range(1);
+    Matrix x = random_matrix(n, m);
+    Matrix g = random_matrix(n, m);
+    Matrix y(n, m), out(n, m);
+    for (auto _ : state) {
+        activation::forward(kind, x, y);
+        activation::backward(kind, g, x, y, out);
+        benchmark::DoNotOptimize(out.view().data);
+        benchmark::ClobberMemory();
+    }
+    // x and y, then g, x, y and out
+    set_elementwise_counters(state, n * m, 5);
+}
+BENCHMARK_CAPTURE(BM_Activation, Sigmoid, activation::Kind::Sigmoid)
+    ->Apply(elementwise_shapes);
+BENCHMARK_CAPTURE(BM_Activation, Tanh, activation::Kind::Tanh)
+    ->Apply(elementwise_shapes);
+BENCHMARK_CAPTURE(BM_Activation, ReLU, activation::Kind::ReLU)
+    ->Apply(elementwise_shapes);
+BENCHMARK_CAPTURE(BM_Activation, GELU, activation::Kind::GELU)
+    ->Apply(elementwise_shapes);
+BENCHMARK_CAPTURE(BM_Activation, Softmax, activation::Kind::Softmax)
+    ->Apply(elementwise_shapes);
+
+// Samples per second of a full training step on 28x28 images
+static void BM_TrainingStep(benchmark::State& state) {
+    size_t batch_size = state.range(0);
+    // The network trained by main.cpp, on random images
+    network::Network net({784, 16, 16, 10}, batch_size);
+    Matrix input = random_matrix(batch_size, 784);
+    Matrix target(10, batch_size);
+    for (size_t b = 0; b < batch_size; b++) {
+        target(b % 10, b) = 1.0f;
+    }
+    for (auto _ : state) {
+        net.forward(input);
+        net.backward(target);
+        net.step(0.1f);
+        benchmark::ClobberMemory();
+    }
+    state.counters["samples/s"] = benchmark::Counter(
+        static_cast<double>(batch_size),
+        benchmark::Counter::kIsIterationInvariantRate
+    );
+}
+BENCHMARK(BM_TrainingStep)
+    ->ArgName("batch")
+    ->RangeMultiplier(2)
+    ->Range(1, 256);
+
+// Bytes/s of one optimizer update over the parameters of a network with
+// 784-wide layers; each rule is one fused pass over weights, gradients and
+// its state
+static void BM_OptimizerStep(benchmark::State& state, optimizer::Kind kind) {
+    network::Network net({784, 784, 784, 10}, 1);
+    optimizer::Optimizer opt(net, {kind});
+    auto gradients = net.gradients();
+    std::fill(gradients.begin(), gradients.end(), 1e-3f);
+    for (auto _ : state) {
+        opt.step(1e-3f, 1);
+        benchmark::ClobberMemory();
+    }
+    // Weights and state are read and written, gradients only read
+    double streams = 3.0 + 2.0 * optimizer::state_count(kind);
+    state.counters["bytes/s"] = benchmark::Counter(
+        streams * static_cast<double>(gradients.size_bytes()),
+        benchmark::Counter::kIsIterationInvariantRate
+    );
+}
+BENCHMARK_CAPTURE(BM_OptimizerStep, SGD, optimizer::Kind::SGD);
+BENCHMARK_CAPTURE(BM_OptimizerStep, Momentum, optimizer::Kind::Momentum);
+BENCHMARK_CAPTURE(BM_OptimizerStep, Nesterov, optimizer::Kind::Nesterov);
+BENCHMARK_CAPTURE(BM_OptimizerStep, RMSProp, optimizer::Kind::RMSProp);
+BENCHMARK_CAPTURE(BM_OptimizerStep, Adam, optimizer::Kind::Adam);
+BENCHMARK_CAPTURE(BM_OptimizerStep, AdamW, optimizer::Kind::AdamW);
+
+// Samples per second of data-parallel training steps, with one pool thread
+// per worker; scaling stops at the physical cores
+static void BM_DataParallelStep(benchmark::State& state) {
+    size_t batch_size = state.range(0);
+    size_t workers = state.range(1);
+    parallel::set_num_threads(workers);
+    network::Network net({784, 16, 16, 10}, batch_size);
+    trainer::DataParallel trainer(net, workers);
+    Matrix input = random_matrix(batch_size, 784);
+    Matrix target(10, batch_size);
+    for (size_t b = 0; b < batch_size; b++) {
+        target(b % 10, b) = 1.0f;
+    }
+    for (auto _ : state) {
+        trainer.step(input, target, 0.1f);
+        benchmark::ClobberMemory();
+    }
+    state.counters["samples/s"] = benchmark::Counter(
+        static_cast<double>(batch_size),
+        benchmark::Counter::kIsIterationInvariantRate
+    );
+    parallel::set_num_threads(0);
+}
+BENCHMARK(BM_DataParallelStep)
+    ->ArgNames({"batch", "workers"})
+    ->ArgsProduct({{256, 1024}, {1, 2, 4, 8}})
+    ->UseRealTime();
+
+// Samples per second of Hogwild training, next to BM_DataParallelStep
+static void BM_Hogwild(benchmark::State& state) {
+    size_t batch_size = state.range(0);
+    size_t workers = state.range(1);
+    parallel::set_num_threads(workers);
+    network::Network net({784, 16, 16, 10}, batch_size);
+    trainer::Hogwild hogwild(net, workers, batch_size);
+    Matrix samples = random_matrix(1024, 784);
+    std::vector<uint8_t> labels(1024);
+    for (size_t s = 0; s < labels.size(); s++) {
+        labels[s] = static_cast<uint8_t>(s % 10);
+    }
+    for (auto _ : state) {
+        hogwild.train(samples, labels, 0, 4096, 0.1f);
+        benchmark::ClobberMemory();
+    }
+    state.counters["samples/s"] = benchmark::Counter(
+        4096.0, benchmark::Counter::kIsIterationInvariantRate
+    );
+    parallel::set_num_threads(0);
+}
+BENCHMARK(BM_Hogwild)
+    ->ArgNames({"batch", "workers"})
+    ->ArgsProduct({{1, 16}, {1, 2, 4, 8}})
+    ->UseRealTime();
+
+// Samples per second of inference on 28x28 images, through the fp32 network
+// or through its int8 copy
+static void BM_Inference(benchmark::State& state) {
+    size_t batch_size = state.range(0);
+    bool int8 = state.range(1) != 0;
+    network::Network net(
+        {784, 16, 16, 10},
+        batch_size,
+        activation::Kind::Sigmoid,
+        activation::Kind::Softmax
+    );
+    Matrix input = random_matrix(batch_size, 784);
+    quantize::Model model(net, quantize::calibrate(net, input), batch_size);
+    for (auto _ : state) {
+        auto output = int8 ? model.forward(input) : net.forward(input);
+        benchmark::DoNotOptimize(output.data);
+        benchmark::ClobberMemory();
+    }
+    state.SetLabel(int8 ? "int8" : "fp32");
+    state.counters["samples/s"] = benchmark::Counter(
+        static_cast<double>(batch_size),
+        benchmark::Counter::kIsIterationInvariantRate
+    );
+}
+BENCHMARK(BM_Inference)
+    ->ArgNames({"batch", "int8"})
+    ->ArgsProduct({{1, 16, 256, 4096}, {0, 1}});
+
+// Integer products of quantized layers, m samples of k codes against n
+// rows of weights
+static void BM_IntegerGemm(benchmark::State& state) {
+    size_t m = state.range(0);
+    size_t k = state.range(1);
+    size_t n = state.range(2);
+    std::vector<uint8_t> a(m * k, 100);
+    std::vector<int8_t> b(n * k, -3);
+    std::vector<int32_t> c(m * n);
+    for (auto _ : state) {
+        simd::gemm_u8s8(m, n, k, a.data(), k, b.data(), k, c.data(), n);
+        benchmark::DoNotOptimize(c.data());
+        benchmark::ClobberMemory();
+    }
+    state.counters["OP/s"] = benchmark::Counter(
+        2.0 * m * n * k, benchmark::Counter::kIsIterationInvariantRate
+    );
+}
+BENCHMARK(BM_IntegerGemm)
+    ->ArgNames({"m", "k", "n"})
+    ->ArgsProduct({{16, 256}, {784}, {16, 64}});
@@ -0,0 +1,328 @@
+#include "checkpoint.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include "memory.hpp"
+
+namespace checkpoint {
+
+namespace {
+
+constexpr char MAGIC[8] = {'N', 'N', 'P', 'P', 'C', 'K', 'P', 'T'};
+// Reads back as another value on a machine of the other byte order
+constexpr uint32_t ORDER_MARK = 0x01020304;
+constexpr size_t HEADER_BYTES = 64;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t depth;
+    // Values of activation::Kind
+    uint32_t hidden;
+    uint32_t output;
+    uint32_t states;
+    uint64_t parameter_count;
+    uint64_t samples;
+    float learning_rate;
+    // Value of optimizer::Kind
+    uint32_t optimizer;
+    uint64_t steps;
+};
+static_assert(sizeof(Header) <= HEADER_BYTES);
+
+size_t padded_bytes(size_t bytes) {
+    constexpr size_t A = memory::ALIGNMENT;
+    return (bytes + A - 1) / A * A;
+}
+
+// Blocks of Network's parameter layout start on a cache line
+size_t padded_floats(size_t n) {
+    return padded_bytes(n * sizeof(float)) / sizeof(float);
+}
+
+// Offset of every weight block in the parameters, then their total
+std::vector<size_t> layout(const std::vector<size_t>& sizes) {
+    std::vector<size_t> offsets;
+    size_t offset = 0;
+    for (size_t l = 0; l + 1 < sizes.size(); ++l) {
+        offsets.push_back(offset);
+        offset += padded_floats(sizes[l + 1] * sizes[l]) +
+                  padded_floats(sizes[l + 1]);
+    }
+    offsets.push_back(offset);
+    return offsets;
+}
+
+bool valid_kind(uint32_t kind) {
+    return kind <= static_cast<uint32_t>(activation::Kind::Softmax);
+}
+
+bool valid_optimizer(uint32_t kind) {
+    return kind <= static_cast<uint32_t>(optimizer::Kind::AdamW);
+}
+
+}  // namespace
+
+void save(
+    const std::string& path,
+    const network::Network& net,
+    Progress progress,
+    std::span<const std::span<const float>> optimizer_state
+) {
+    auto params = net.parameters();
+    auto offsets = layout(net.sizes());
+    if (offsets.back() != params.size()) {
+        throw std::logic_error("Network parameters do not follow the checkpoint layout");
+    }
+    for (auto state : optimizer_state) {
+        if (state.size() != params.size()) {
+            throw std::invalid_argument("Optimizer buffers must hold one value per parameter");
+        }
+    }
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byte_order = ORDER_MARK;
+    header.depth = static_cast<uint32_t>(net.depth());
+    header.hidden = static_cast<uint32_t>(net.hidden_activation());
+    header.output = static_cast<uint32_t>(net.output_activation());
+    header.states = static_cast<uint32_t>(optimizer_state.size());
+    header.parameter_count = params.size();
+    header.samples = progress.samples;
+    header.learning_rate = progress.learning_rate;
+    header.optimizer = static_cast<uint32_t>(progress.optimizer);
+    header.steps = progress.steps;
+
+    size_t sizes_bytes = padded_bytes(8 * net.sizes().size());
+    std::vector<char> head(HEADER_BYTES + sizes_bytes);
+    std::memcpy(head.data(), &header, sizeof(header));
+    for (size_t i = 0; i < net.sizes().size(); ++i) {
+        uint64_t size = net.sizes()[i];
+        std::memcpy(head.data() + HEADER_BYTES + 8 * i, &size, 8);
+    }
+
+    auto temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        auto write = [&](const void* data, size_t bytes) {
+            file.write(
+                static_cast<const char*>(data),
+                static_cast<std::streamsize>(bytes)
+            );
+        };
+        write(head.data(), head.size());
+        write(params.data(), params.size_bytes());
+        for (auto state : optimizer_state) {
+            write(state.data(), state.size_bytes());
+        }
+        file.flush();
+        if (!file) {
+            throw std::runtime_error("Cannot write checkpoint: " + temporary);
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        throw std::runtime_error("Cannot replace checkpoint: " + path);
+    }
+}
+
+Checkpoint::Checkpoint(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot stat file: " + path);
+    }
+    mapping_size = static_cast<size_t>(info.st_size);
+    if (mapping_size > 0) {
+        mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (mapping_size == 0 || mapping == MAP_FAILED) {
+        mapping = nullptr;
+        throw std::runtime_error("Cannot map file: " + path);
+    }
+
+    auto fail = [&](const std::string& message) {
+        munmap(mapping, mapping_size);
+        mapping = nullptr;
+        throw std::runtime_error(message + ": " + path);
+    };
+
+    const auto* bytes = static_cast<const uint8_t*>(mapping);
+    Header header;
+    if (mapping_size < HEADER_BYTES) {
+        fail("Not a checkpoint");
+    }
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        fail("Not a checkpoint");
+    }
+    if (header.byte_order != ORDER_MARK) {
+        fail("Checkpoint was written with the other byte order");
+    }
+    if (header.version == 0 || header.version > VERSION) {
+        fail("Unsupported checkpoint version " + std::to_string(header.version));
+    }
+    size_t sizes_bytes = padded_bytes(8 * (size_t{header.depth} + 1));
+    if (header.depth == 0 || mapping_size < HEADER_BYTES + sizes_bytes ||
+        !valid_kind(header.hidden) || !valid_kind(header.output) ||
+        !valid_optimizer(header.optimizer) ||
+        header.hidden == static_cast<uint32_t>(activation::Kind::Softmax)) {
+        fail("Invalid checkpoint header");
+    }
+
+    // Every weight block fits in the file, which also keeps the sizes below
+    // from overflowing
+    size_t floats = mapping_size / sizeof(float);
+    for (size_t i = 0; i <= header.depth; ++i) {
+        uint64_t size;
+        std::memcpy(&size, bytes + HEADER_BYTES + 8 * i, 8);
+        if (size == 0 || size > floats ||
+            (i > 0 && size > floats / layer_sizes.back())) {
+            fail("Invalid checkpoint header");
+        }
+        layer_sizes.push_back(static_cast<size_t>(size));
+    }
+    offsets = layout(layer_sizes);
+    parameter_count = offsets.back();
+    offsets.pop_back();
+    states = header.states;
+    if (states > floats / parameter_count) {
+        fail("Checkpoint size does not match its header");
+    }
+    size_t expected = HEADER_BYTES + sizes_bytes +
+                      (1 + states) * parameter_count * sizeof(float);
+    if (header.parameter_count != parameter_count || mapping_size != expected) {
+        fail("Checkpoint size does not match its header");
+    }
+
+    file_version = header.version;
+    hidden_kind = static_cast<activation::Kind>(header.hidden);
+    output_kind = static_cast<activation::Kind>(header.output);
+    saved = Progress{
+        header.samples,
+        header.learning_rate,
+        static_cast<optimizer::Kind>(header.optimizer),
+        header.steps,
+    };
+    // The mapping is page aligned, so every block is on a cache line
+    const uint8_t* first = bytes + HEADER_BYTES + sizes_bytes;
+    values = reinterpret_cast<const float*>(first);
+}
+
+Checkpoint::~Checkpoint() {
+    if (mapping != nullptr) {
+        munmap(mapping, mapping_size);
+    }
+}
+
+Checkpoint::Checkpoint(Checkpoint&& other) noexcept
+    : mapping(other.mapping),
+      mapping_size(other.mapping_size),
+      values(other.values),
+      parameter_count(other.parameter_count),
+      states(other.states),
+      file_version(other.file_version),
+      layer_sizes(std::move(other.layer_sizes)),
+      offsets(std::move(other.offsets)),
+      hidden_kind(other.hidden_kind),
+      output_kind(other.output_kind),
+      saved(other.saved) {
+    other.mapping = nullptr;
+    other.mapping_size = 0;
+    other.values = nullptr;
+}
+
+Checkpoint& Checkpoint::operator=(Checkpoint&& other) noexcept {
+    if (this != &other) {
+        if (mapping != nullptr) {
+            munmap(mapping, mapping_size);
+        }
+        mapping = other.mapping;
+        mapping_size = other.mapping_size;
+        values = other.values;
+        parameter_count = other.parameter_count;
+        states = other.states;
+        file_version = other.file_version;
+        layer_sizes = std::move(other.layer_sizes);
+        offsets = std::move(other.offsets);
+        hidden_kind = other.hidden_kind;
+        output_kind = other.output_kind;
+        saved = other.saved;
+        other.mapping = nullptr;
+        other.mapping_size = 0;
+        other.values = nullptr;
+    }
+    return *this;
+}
+
+matrix::ConstMatrixView Checkpoint::weight(size_t l) const {
+    return matrix::ConstMatrixView(
+        values + offsets.at(l), layer_sizes[l + 1], layer_sizes[l]
+    );
+}
+
+matrix::ConstMatrixView Checkpoint::bias(size_t l) const {
+    size_t rows = layer_sizes[l + 1];
+    size_t weights = padded_floats(rows * layer_sizes[l]);
+    return matrix::ConstMatrixView(values + offsets.at(l) + weights, rows, 1);
+}
+
+std::span<const float> Checkpoint::state(size_t i) const {
+    if (i >= states) {
+        throw std::out_of_range("No such optimizer buffer");
+    }
+    return {values + (1 + i) * parameter_count, parameter_count};
+}
+
+void Checkpoint::restore(network::Network& net) const {
+    if (net.sizes() != layer_sizes ||
+        net.hidden_activation() != hidden_kind ||
+        net.output_activation() != output_kind) {
+        throw std::invalid_argument("Network does not match the checkpoint");
+    }
+    auto params = parameters();
+    std::copy(params.begin(), params.end(), net.parameters().begin());
+    // Refreshes any 16-bit copies of the weights
+    net.set_storage_format(net.storage_format());
+}
+
+void Checkpoint::restore(optimizer::Optimizer& optimizer) const {
+    if (optimizer.kind() != saved.optimizer ||
+        optimizer::state_count(optimizer.kind()) != states) {
+        throw std::invalid_argument("Optimizer does not match the checkpoint");
+    }
+    for (size_t i = 0; i < states; ++i) {
+        auto buffer = optimizer.state(i);
+        if (buffer.size() != parameter_count) {
+            throw std::invalid_argument("Optimizer does not match the checkpoint");
+        }
+        auto values = state(i);
+        std::copy(values.begin(), values.end(), buffer.begin());
+    }
+    optimizer.set_steps(saved.steps);
+}
+
+network::Network Checkpoint::network(size_t batch_size) const {
+    network::Network net(layer_sizes, batch_size, hidden_kind, output_kind);
+    restore(net);
+    return net;
+}
+
+}  // namespace checkpoint
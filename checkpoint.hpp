@@ -0,0 +1,122 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "activation.hpp"
+#include "matrix.hpp"
+#include "network.hpp"
+#include "optimizer.hpp"
+
+namespace checkpoint {
+
+// Binary checkpoints of a network::Network.
+//
+// The file is laid out so that it can be mapped and used in place:
+//
+//   offset 0   Header, padded to 64 bytes
+//   64         depth + 1 layer sizes as uint64, padded to 64 bytes
+//   ...        the parameters in the layout of Network::parameters(): W0,
+//              b0, W1, b1, ... as row-major fp32, each block starting on a
+//              64-byte boundary
+//   ...        state_count() optimizer buffers in the same layout
+//
+// Values are stored in host byte order; a marker in the header rejects
+// files written on a machine of the other order. VERSION changes whenever
+// the layout does. Version 2 added the optimizer and its step count to the
+// header, where version 1 files hold zeros, so both are read.
+constexpr uint32_t VERSION = 2;
+
+// Where a training run stands, stored next to the parameters
+struct Progress {
+    // Samples trained on so far
+    uint64_t samples = 0;
+    float learning_rate = 0.0f;
+    // Rule of the optimizer buffers, and the steps it has taken
+    optimizer::Kind optimizer = optimizer::Kind::SGD;
+    uint64_t steps = 0;
+};
+
+// Writes net, its progress and any optimizer buffers, each holding one value
+// per parameter in the layout of net.parameters(), to path. The file is
+// written next to path and renamed over it, so an interrupted save leaves
+// the previous checkpoint intact. Throws std::invalid_argument for buffers of
+// the wrong size and std::runtime_error if the file cannot be written.
+void save(
+    const std::string& path,
+    const network::Network& net,
+    Progress progress = {},
+    std::span<const std::span<const float>> optimizer_state = {}
+);
+
+// Read-only memory mapping of a checkpoint. The header is validated once on
+// construction; weights, biases and optimizer buffers are views into the
+// mapping, so opening a checkpoint neither parses nor copies them.
+class Checkpoint {
+  public:
+    // Maps path and checks its header, version and size. Throws
+    // std::runtime_error otherwise.
+    explicit Checkpoint(const std::string& path);
+    ~Checkpoint();
+
+    Checkpoint(Checkpoint&& other) noexcept;
+    Checkpoint& operator=(Checkpoint&& other) noexcept;
+    Checkpoint(const Checkpoint&) = delete;
+    Checkpoint& operator=(const Checkpoint&) = delete;
+
+    uint32_t version() const { return file_version; }
+
+    // Topology, as passed to the Network constructor
+    const std::vector<size_t>& sizes() const { return layer_sizes; }
+    size_t depth() const { return layer_sizes.size() - 1; }
+    activation::Kind hidden_activation() const { return hidden_kind; }
+    activation::Kind output_activation() const { return output_kind; }
+
+    Progress progress() const { return saved; }
+
+    // Weight l (sizes[l + 1] x sizes[l]) and bias l (sizes[l + 1] x 1)
+    matrix::ConstMatrixView weight(size_t l) const;
+    matrix::ConstMatrixView bias(size_t l) const;
+
+    // Every parameter, including the padding between blocks
+    std::span<const float> parameters() const {
+        return {values, parameter_count};
+    }
+
+    size_t state_count() const { return states; }
+    std::span<const float> state(size_t i) const;
+
+    // Copies the parameters into net. Throws std::invalid_argument if its
+    // topology or activations differ.
+    void restore(network::Network& net) const;
+
+    // Copies the optimizer buffers and step count into optimizer. Throws
+    // std::invalid_argument if it follows another rule or was made for
+    // another topology.
+    void restore(optimizer::Optimizer& optimizer) const;
+
+    // New network with the stored topology and parameters, for batches of
+    // up to batch_size samples
+    network::Network network(size_t batch_size) const;
+
+  private:
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+    const float* values = nullptr;
+    size_t parameter_count = 0;
+    size_t states = 0;
+    uint32_t file_version = 0;
+    std::vector<size_t> layer_sizes;
+    std::vector<size_t> offsets;
+    activation::Kind hidden_kind = activation::Kind::Sigmoid;
+    activation::Kind output_kind = activation::Kind::Sigmoid;
+    Progress saved;
+};
+
+}  // namespace checkpoint
+
+#endif  // CHECKPOINT_HPP
@@ -0,0 +1,303 @@
+#include "distributed.hpp"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#include "simd.hpp"
+
+namespace distributed {
+
+namespace {
+
+sockaddr_un socket_address(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("Socket path is too long: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+int unix_socket() {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create socket");
+    }
+    return fd;
+}
+
+}  // namespace
+
+Ring::Ring(
+    const std::string& path, size_t rank, size_t size, double timeout_seconds
+)
+    : my_rank(rank),
+      world(size),
+      timeout_ms(static_cast<int>(timeout_seconds * 1000.0)) {
+    if (size == 0 || rank >= size) {
+        throw std::invalid_argument("Rank must be below the ring size");
+    }
+    if (size == 1) {
+        return;
+    }
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(timeout_ms);
+    auto name = [&](size_t r) { return path + "." + std::to_string(r); };
+
+    try {
+        // Listen first, so that the predecessor can connect before this
+        // rank accepts
+        auto own = socket_address(name(rank));
+        auto successor = socket_address(name((rank + 1) % size));
+        listener = unix_socket();
+        listen_path = name(rank);
+        unlink(listen_path.c_str());
+        auto* own_address = reinterpret_cast<sockaddr*>(&own);
+        if (bind(listener, own_address, sizeof(own)) != 0 ||
+            listen(listener, 1) != 0) {
+            throw std::runtime_error("Cannot listen on " + listen_path);
+        }
+
+        // The successor may not be listening yet
+        auto* successor_address = reinterpret_cast<sockaddr*>(&successor);
+        for (;;) {
+            next = unix_socket();
+            if (connect(next, successor_address, sizeof(successor)) == 0) {
+                break;
+            }
+            close(next);
+            next = -1;
+            if (std::chrono::steady_clock::now() > deadline) {
+                throw std::runtime_error(
+                    "Timed out connecting to " + name((rank + 1) % size)
+                );
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()
+        );
+        int wait_ms = static_cast<int>(std::max<int64_t>(left.count(), 0));
+        pollfd connection{listener, POLLIN, 0};
+        if (poll(&connection, 1, wait_ms) <= 0) {
+            throw std::runtime_error(
+                "Timed out waiting for rank " +
+                std::to_string((rank + size - 1) % size)
+            );
+        }
+        previous = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (previous < 0) {
+            throw std::runtime_error("Cannot accept the predecessor");
+        }
+    } catch (...) {
+        disconnect();
+        throw;
+    }
+}
+
+Ring::~Ring() { disconnect(); }
+
+void Ring::disconnect() {
+    for (int* fd : {&next, &previous, &listener}) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+    if (!listen_path.empty()) {
+        unlink(listen_path.c_str());
+        listen_path.clear();
+    }
+}
+
+void Ring::exchange(
+    const void* send, size_t send_bytes, void* receive, size_t receive_bytes
+) {
+    const auto* out = static_cast<const char*>(send);
+    auto* in = static_cast<char*>(receive);
+    size_t sent = 0;
+    size_t received = 0;
+    while (sent < send_bytes || received < receive_bytes) {
+        pollfd fds[2];
+        nfds_t count = 0;
+        if (sent < send_bytes) {
+            fds[count++] = pollfd{next, POLLOUT, 0};
+        }
+        if (received < receive_bytes) {
+            fds[count++] = pollfd{previous, POLLIN, 0};
+        }
+        int ready = poll(fds, count, timeout_ms);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready <= 0) {
+            throw std::runtime_error("Timed out exchanging with the ring");
+        }
+        for (nfds_t i = 0; i < count; ++i) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            if (fds[i].fd == next) {
+                ssize_t n = ::send(
+                    next,
+                    out + sent,
+                    send_bytes - sent,
+                    MSG_DONTWAIT | MSG_NOSIGNAL
+                );
+                if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                    throw std::runtime_error("Cannot send to the successor");
+                }
+                sent += n > 0 ? static_cast<size_t>(n) : 0;
+            } else {
+                ssize_t n = recv(
+                    previous,
+                    in + received,
+                    receive_bytes - received,
+                    MSG_DONTWAIT
+                );
+                if (n == 0) {
+                    throw std::runtime_error("Predecessor closed the ring");
+                }
+                if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                    throw std::runtime_error("Cannot receive from the predecessor");
+                }
+                received += n > 0 ? static_cast<size_t>(n) : 0;
+            }
+        }
+    }
+}
+
+void Ring::all_reduce(std::span<float> data) {
+    if (world == 1) {
+        return;
+    }
+    size_t n = data.size();
+    auto chunk = [&](size_t c) {
+        size_t begin = c * n / world;
+        size_t end = (c + 1) * n / world;
+        return data.subspan(begin, end - begin);
+    };
+    incoming.resize(std::max(incoming.size(), n / world + 1));
+
+    // Reduce-scatter: in step s, rank r adds its own values to the partial
+    // sum of chunk r - s - 1 and passes it on; chunk r + 1 ends up complete
+    for (size_t s = 0; s + 1 < world; ++s) {
+        auto out = chunk((my_rank + world - s) % world);
+        auto in = chunk((my_rank + 2 * world - s - 1) % world);
+        exchange(
+            out.data(), out.size_bytes(), incoming.data(), in.size_bytes()
+        );
+        simd::add(incoming.data(), in.data(), in.data(), in.size());
+    }
+    // All-gather: the complete chunks travel once around the ring
+    for (size_t s = 0; s + 1 < world; ++s) {
+        auto out = chunk((my_rank + 1 + world - s) % world);
+        auto in = chunk((my_rank + world - s) % world);
+        exchange(out.data(), out.size_bytes(), in.data(), in.size_bytes());
+    }
+}
+
+Trainer::Trainer(
+    network::Network& net, Ring& ring, optimizer::Optimizer* optimizer
+)
+    : net(net), ring(ring), optimizer(optimizer) {
+    auto gradients = net.gradients();
+    for (size_t l = 0; l < net.depth(); ++l) {
+        auto offset = [&](size_t layer) {
+            return static_cast<size_t>(
+                net.weight_gradient(layer).data - gradients.data()
+            );
+        };
+        size_t begin = offset(l);
+        size_t end = l + 1 < net.depth() ? offset(l + 1) : gradients.size();
+        blocks.push_back(gradients.subspan(begin, end - begin));
+    }
+    thread = std::thread([this] { communicate(); });
+}
+
+Trainer::~Trainer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    thread.join();
+}
+
+void Trainer::communicate() {
+    for (;;) {
+        size_t l;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || reduced < ready; });
+            if (stopping) {
+                return;
+            }
+            // backward finishes the layers from the last one down
+            l = blocks.size() - 1 - reduced;
+        }
+        try {
+            ring.all_reduce(blocks[l]);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = std::current_exception();
+            done.notify_all();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++reduced;
+        }
+        done.notify_all();
+    }
+}
+
+matrix::ConstMatrixView Trainer::step(
+    matrix::ConstMatrixView input,
+    matrix::ConstMatrixView target,
+    float learning_rate
+) {
+    auto output = net.forward(input);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        ready = 0;
+        reduced = 0;
+    }
+    net.backward(target, [this](size_t) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++ready;
+        }
+        wake.notify_one();
+    });
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return reduced == blocks.size() || error; });
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    // The gradients hold the sums over every rank's batch of the same size;
+    // Network::step averages over the local batch only
+    if (optimizer != nullptr) {
+        optimizer->step(learning_rate, input.N * ring.size());
+    } else {
+        net.step(learning_rate / static_cast<float>(ring.size()));
+    }
+    return output;
+}
+
+}  // namespace distributed
@@ -0,0 +1,135 @@
+#ifndef DISTRIBUTED_HPP
+#define DISTRIBUTED_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "matrix.hpp"
+#include "network.hpp"
+#include "optimizer.hpp"
+
+namespace distributed {
+
+// Ring of processes connected over Unix domain sockets, one per rank.
+//
+// Rank r listens on path + "." + r, connects to the listener of rank r + 1
+// and accepts rank r - 1 (modulo size), so every rank sends to its
+// successor and receives from its predecessor. The ranks may be started in
+// any order on one machine; each waits up to timeout_seconds for the
+// others. The sockets are closed and the listener removed on destruction.
+class Ring {
+  public:
+    // Throws std::invalid_argument if rank >= size and std::runtime_error if
+    // the ring cannot be set up in time.
+    Ring(
+        const std::string& path,
+        size_t rank,
+        size_t size,
+        double timeout_seconds = 60.0
+    );
+    ~Ring();
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    size_t rank() const { return my_rank; }
+    size_t size() const { return world; }
+
+    // Replaces data with its elementwise sum over every rank, which must all
+    // call this with spans of the same length. Ring all-reduce: the span is
+    // cut into size() chunks; size() - 1 reduce-scatter steps pass partial
+    // sums around the ring until every chunk is complete on one rank, and
+    // size() - 1 all-gather steps pass the complete chunks on. Each rank
+    // sends and receives about 2 * data.size() values, whatever the number
+    // of ranks. Every chunk is summed in ring order and copied, not summed
+    // again, so all ranks end up with the same bits. Throws
+    // std::runtime_error if a peer fails or times out.
+    void all_reduce(std::span<float> data);
+
+  private:
+    // Closes the sockets and removes the listener
+    void disconnect();
+
+    // Sends bytes to the successor while receiving into the predecessor's
+    // buffer, so that neither side of the ring blocks the other
+    void exchange(
+        const void* send, size_t send_bytes, void* receive, size_t receive_bytes
+    );
+
+    size_t my_rank;
+    size_t world;
+    int timeout_ms;
+    std::string listen_path;
+    int listener = -1;
+    int next = -1;
+    int previous = -1;
+    // A chunk received from the predecessor
+    std::vector<float> incoming;
+};
+
+// Synchronous data-parallel SGD across the ranks of a Ring.
+//
+// Every rank trains the same network on batches of its own samples. While
+// backward moves on to the layers below, a communication thread all-reduces
+// the gradients of each layer as soon as they are final, so sending the
+// upper layers overlaps with computing the lower ones. Once every layer is
+// reduced, each rank applies the same update to its own copy, and the
+// copies stay identical as long as they start identical, e.g. from the same
+// seed or checkpoint.
+class Trainer {
+  public:
+    // net and ring must outlive the trainer. Updates go through optimizer
+    // if given, which must train net and outlive the trainer, and are plain
+    // SGD otherwise.
+    Trainer(
+        network::Network& net,
+        Ring& ring,
+        optimizer::Optimizer* optimizer = nullptr
+    );
+    ~Trainer();
+
+    Trainer(const Trainer&) = delete;
+    Trainer& operator=(const Trainer&) = delete;
+
+    // One training step on input (n x input_size(), one sample per row)
+    // against target (output_size() x n). Every rank must call it with the
+    // same n; the update uses the gradient averaged over the n * size()
+    // samples of all ranks. Returns the output of this rank's forward pass.
+    // Rethrows any error of the communication thread.
+    matrix::ConstMatrixView step(
+        matrix::ConstMatrixView input,
+        matrix::ConstMatrixView target,
+        float learning_rate
+    );
+
+  private:
+    void communicate();
+
+    network::Network& net;
+    Ring& ring;
+    optimizer::Optimizer* optimizer;
+    // Flat range of every layer's weight and bias gradients, padding
+    // included
+    std::vector<std::span<float>> blocks;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    // Layers whose gradients are final in this step, and how many of them
+    // are reduced; backward hands them over from the last layer down
+    size_t ready = 0;
+    size_t reduced = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+};
+
+}  // namespace distributed
+
+#endif  // DISTRIBUTED_HPP
@@ -0,0 +1,683 @@
+#include "gemm.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "memory.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+// Compile the micro-kernel once per ISA level and let the loader pick the
+// best one through CPUID. GCC can dispatch on whole x86-64 levels (which
+// include FMA); other compilers fall back to single feature names.
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__) && \
+    __GNUC__ >= 12
+#define GEMM_MULTIVERSION \
+    __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+#elif defined(__x86_64__) && defined(__clang__)
+#define GEMM_MULTIVERSION \
+    __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define GEMM_MULTIVERSION
+#endif
+
+namespace gemm {
+
+namespace {
+
+// Register tile: MR rows of A times NR columns of B stay in registers.
+constexpr size_t MR = 6;
+constexpr size_t NR = 16;
+
+// Cache blocking. A KC x NR sliver of B stays in L1, the packed MC x KC block
+// of A in L2 and the packed KC x NC panel of B in L3.
+constexpr size_t MC = 120;
+constexpr size_t KC = 256;
+constexpr size_t NC = 3072;
+
+// Rows of A packed at once; the packed block is shared by all threads.
+constexpr size_t MS = 2048;
+
+// Columns of a block finished at once by the epilogue; MC rows of them fit
+// in L1.
+constexpr size_t EPILOGUE_WIDTH = 4 * NR;
+
+// Below this many multiply-adds, packing costs more than it saves.
+constexpr size_t DIRECT_THRESHOLD = 32 * 32 * 32;
+
+// Longest contiguous 16-bit run the direct path widens on the stack
+constexpr size_t WIDEN_MAX = 1024;
+
+// Below this many multiply-adds, waking the thread pool costs more than it
+// saves.
+constexpr size_t PARALLEL_THRESHOLD = 64 * 64 * 64;
+
+constexpr size_t ceil_div(size_t a, size_t b) { return (a + b - 1) / b; }
+
+constexpr size_t round_up(size_t a, size_t b) { return ceil_div(a, b) * b; }
+
+// Cache-line aligned buffer that only grows, so that packing into it stops
+// allocating once it has seen the largest call.
+class Scratch {
+  public:
+    float* get(size_t n) {
+        if (n > capacity) {
+            buffer = memory::make_buffer(n);
+            capacity = n;
+        }
+        return buffer.get();
+    }
+
+  private:
+    memory::Buffer buffer;
+    size_t capacity = 0;
+};
+
+typedef float vec8 __attribute__((vector_size(32), aligned(4)));
+
+// Readers of the stored operand formats. Packing and the direct path widen
+// every value to fp32 as they load it, so the micro-kernel only sees fp32.
+// widen converts a contiguous run at once with the vector kernels.
+struct Fp32 {
+    using type = float;
+    static float load(const float* p) { return *p; }
+    static void widen(const float* p, float* out, size_t n) {
+        std::copy(p, p + n, out);
+    }
+};
+
+struct Bf16 {
+    using type = uint16_t;
+    static float load(const uint16_t* p) { return precision::from_bf16(*p); }
+    static void widen(const uint16_t* p, float* out, size_t n) {
+        simd::from_bf16(p, out, n);
+    }
+};
+
+struct Fp16 {
+    using type = uint16_t;
+    static float load(const uint16_t* p) { return precision::from_fp16(*p); }
+    static void widen(const uint16_t* p, float* out, size_t n) {
+        simd::from_fp16(p, out, n);
+    }
+};
+
+// Computes the MR x NR tile alpha * a * b over kc steps from packed slivers
+// and stores it into c, adding to the existing values when accumulate is set.
+GEMM_MULTIVERSION
+void micro_kernel(
+    size_t kc,
+    float alpha,
+    const float* a,
+    const float* b,
+    float* c,
+    size_t ldc,
+    bool accumulate
+) {
+    // vec8 is declared with 4-byte alignment, so plain dereferences are
+    // unaligned loads and stores.
+    vec8 acc[MR][2] = {};
+    for (size_t p = 0; p < kc; ++p) {
+        vec8 b0 = *reinterpret_cast<const vec8*>(b);
+        vec8 b1 = *reinterpret_cast<const vec8*>(b + 8);
+        // Fully unrolled so that the accumulators live in registers.
+#pragma GCC unroll 8
+        for (size_t r = 0; r < MR; ++r) {
+            acc[r][0] += a[r] * b0;
+            acc[r][1] += a[r] * b1;
+        }
+        a += MR;
+        b += NR;
+    }
+#pragma GCC unroll 8
+    for (size_t r = 0; r < MR; ++r) {
+        vec8* row = reinterpret_cast<vec8*>(c + r * ldc);
+        acc[r][0] *= alpha;
+        acc[r][1] *= alpha;
+        if (accumulate) {
+            acc[r][0] += row[0];
+            acc[r][1] += row[1];
+        }
+        row[0] = acc[r][0];
+        row[1] = acc[r][1];
+    }
+}
+
+bool has_work(const Epilogue& e) {
+    return e.bias != nullptr || e.pre != nullptr || e.activation != nullptr ||
+           e.combine != nullptr;
+}
+
+// Epilogue for the block of C starting at (i, j)
+Epilogue shifted(const Epilogue& e, size_t i, size_t j) {
+    Epilogue block = e;
+    if (block.bias != nullptr) {
+        block.bias += i;
+    }
+    if (block.pre != nullptr) {
+        block.pre += i * block.ldpre + j;
+    }
+    if (block.operand != nullptr) {
+        block.operand += i * block.ldoperand + j;
+    }
+    return block;
+}
+
+// Applies the epilogue to the rows x cols block C.
+void finish(
+    const Epilogue& e, size_t rows, size_t cols, float* C, size_t ldc
+) {
+    for (size_t r = 0; r < rows; ++r) {
+        float* c = C + r * ldc;
+        if (e.bias != nullptr) {
+            float b = e.bias[r];
+            for (size_t s = 0; s < cols; ++s) {
+                c[s] += b;
+            }
+        }
+        if (e.pre != nullptr) {
+            std::copy(c, c + cols, e.pre + r * e.ldpre);
+        }
+        if (e.activation != nullptr) {
+            e.activation(c, c, cols);
+        }
+        if (e.combine != nullptr) {
+            e.combine(c, e.operand + r * e.ldoperand, c, cols);
+        }
+    }
+}
+
+// Packs the mc x kc block of op(A) starting at (i0, p0) into MR-row slivers,
+// zero-padding the last one.
+template <typename TA>
+void pack_a(
+    size_t mc,
+    size_t kc,
+    const typename TA::type* A,
+    size_t lda,
+    Transpose trans,
+    size_t i0,
+    size_t p0,
+    float* packed
+) {
+    for (size_t i = 0; i < mc; i += MR) {
+        size_t mr = std::min(MR, mc - i);
+        for (size_t p = 0; p < kc; ++p) {
+            if (trans == Transpose::Yes) {
+                // Rows of op(A) are columns of A, contiguous in memory.
+                const auto* col = A + (p0 + p) * lda + i0 + i;
+                for (size_t r = 0; r < mr; ++r) {
+                    packed[r] = TA::load(col + r);
+                }
+            } else {
+                const auto* row = A + (i0 + i) * lda + p0 + p;
+                for (size_t r = 0; r < mr; ++r) {
+                    packed[r] = TA::load(row + r * lda);
+                }
+            }
+            for (size_t r = mr; r < MR; ++r) {
+                packed[r] = 0.0f;
+            }
+            packed += MR;
+        }
+    }
+}
+
+// Packs the kc x nc panel of op(B) starting at (p0, j0) into NR-column
+// slivers, zero-padding the last one.
+template <typename TB>
+void pack_b(
+    size_t kc,
+    size_t nc,
+    const typename TB::type* B,
+    size_t ldb,
+    Transpose trans,
+    size_t p0,
+    size_t j0,
+    float* packed
+) {
+    for (size_t j = 0; j < nc; j += NR) {
+        size_t nr = std::min(NR, nc - j);
+        if (trans == Transpose::Yes) {
+            // Walk each row of B contiguously and scatter it into a column
+            // of the sliver, which is small enough to stay in L1.
+            for (size_t c = 0; c < nr; ++c) {
+                const auto* row = B + (j0 + j + c) * ldb + p0;
+                for (size_t p = 0; p < kc; ++p) {
+                    packed[p * NR + c] = TB::load(row + p);
+                }
+            }
+            for (size_t c = nr; c < NR; ++c) {
+                for (size_t p = 0; p < kc; ++p) {
+                    packed[p * NR + c] = 0.0f;
+                }
+            }
+            packed += kc * NR;
+            continue;
+        }
+        for (size_t p = 0; p < kc; ++p) {
+            const auto* row = B + (p0 + p) * ldb + j0 + j;
+            for (size_t c = 0; c < nr; ++c) {
+                packed[c] = TB::load(row + c);
+            }
+            for (size_t c = nr; c < NR; ++c) {
+                packed[c] = 0.0f;
+            }
+            packed += NR;
+        }
+    }
+}
+
+// Runs the micro-kernel over every tile of a packed mc x nc block. On the
+// last step over k, epilogue (if any) finishes each EPILOGUE_WIDTH-column
+// strip as soon as it is complete.
+void macro_kernel(
+    size_t mc,
+    size_t nc,
+    size_t kc,
+    float alpha,
+    const float* packed_a,
+    const float* packed_b,
+    float* C,
+    size_t ldc,
+    bool accumulate,
+    const Epilogue* epilogue
+) {
+    float edge[MR * NR];
+    for (size_t j = 0; j < nc; j += NR) {
+        if (epilogue != nullptr && j > 0 && j % EPILOGUE_WIDTH == 0) {
+            size_t j0 = j - EPILOGUE_WIDTH;
+            finish(shifted(*epilogue, 0, j0), mc, EPILOGUE_WIDTH, C + j0, ldc);
+        }
+        size_t nr = std::min(NR, nc - j);
+        const float* b = packed_b + j * kc;
+        for (size_t i = 0; i < mc; i += MR) {
+            size_t mr = std::min(MR, mc - i);
+            const float* a = packed_a + i * kc;
+            float* c = C + i * ldc + j;
+            if (mr == MR && nr == NR) {
+                micro_kernel(kc, alpha, a, b, c, ldc, accumulate);
+                continue;
+            }
+            // Partial tile: compute into a scratch tile and copy the valid
+            // part out.
+            micro_kernel(kc, alpha, a, b, edge, NR, false);
+            for (size_t r = 0; r < mr; ++r) {
+                for (size_t s = 0; s < nr; ++s) {
+                    if (accumulate) {
+                        c[r * ldc + s] += edge[r * NR + s];
+                    } else {
+                        c[r * ldc + s] = edge[r * NR + s];
+                    }
+                }
+            }
+        }
+    }
+    if (epilogue != nullptr) {
+        size_t j0 = (nc - 1) / EPILOGUE_WIDTH * EPILOGUE_WIDTH;
+        finish(shifted(*epilogue, 0, j0), mc, nc - j0, C + j0, ldc);
+    }
+}
+
+// Performs C = beta * C on an m x n block. beta == 0 clears C without
+// reading it.
+void scale_block(size_t m, size_t n, float beta, float* C, size_t ldc) {
+    if (beta == 1.0f) {
+        return;
+    }
+    for (size_t i = 0; i < m; ++i) {
+        float* c = C + i * ldc;
+        if (beta == 0.0f) {
+            std::fill(c, c + n, 0.0f);
+        } else {
+            for (size_t j = 0; j < n; ++j) {
+                c[j] *= beta;
+            }
+        }
+    }
+}
+
+// Unblocked path for small or skinny products, e.g. the per-sample
+// matrix-vector products. Each case orders its loops so that the innermost
+// accesses are contiguous.
+template <typename TA, typename TB>
+void direct(
+    Transpose trans_a,
+    Transpose trans_b,
+    size_t m,
+    size_t n,
+    size_t k,
+    float alpha,
+    const typename TA::type* A,
+    size_t lda,
+    const typename TB::type* B,
+    size_t ldb,
+    float beta,
+    float* C,
+    size_t ldc
+) {
+    bool ta = trans_a == Transpose::Yes;
+    bool tb = trans_b == Transpose::Yes;
+
+    if (!tb && (n > 1 || ta)) {
+        // C[i][:] += op(A)[i][p] * B[p][:], rows of B are contiguous.
+        scale_block(m, n, beta, C, ldc);
+        for (size_t i = 0; i < m; ++i) {
+            float* c = C + i * ldc;
+            for (size_t p = 0; p < k; ++p) {
+                float a =
+                    alpha * TA::load(ta ? A + p * lda + i : A + i * lda + p);
+                const auto* b = B + p * ldb;
+                for (size_t j = 0; j < n; ++j) {
+                    c[j] += a * TB::load(b + j);
+                }
+            }
+        }
+        return;
+    }
+
+    // Dot products: C[i][j] = op(A)[i][:] . op(B)[:][j]
+    size_t a_step = ta ? lda : 1;
+    size_t b_step = tb ? 1 : ldb;
+    constexpr bool mixed =
+        !std::is_same_v<TA, Fp32> || !std::is_same_v<TB, Fp32>;
+    if (mixed && k <= WIDEN_MAX && (a_step == 1 || b_step == 1)) {
+        // Widen each contiguous row of op(A), and a contiguous single column
+        // of op(B), once with the vector kernels rather than value by value
+        float a_row[WIDEN_MAX];
+        float b_col[WIDEN_MAX];
+        bool wide_b = n == 1 && b_step == 1;
+        if (wide_b) {
+            TB::widen(B, b_col, k);
+        }
+        for (size_t i = 0; i < m; ++i) {
+            const auto* a = ta ? A + i : A + i * lda;
+            if (a_step == 1) {
+                TA::widen(a, a_row, k);
+            } else {
+                for (size_t p = 0; p < k; ++p) {
+                    a_row[p] = TA::load(a + p * a_step);
+                }
+            }
+            for (size_t j = 0; j < n; ++j) {
+                float sum = 0.0f;
+                if (wide_b) {
+                    for (size_t p = 0; p < k; ++p) {
+                        sum += a_row[p] * b_col[p];
+                    }
+                } else {
+                    const auto* b = tb ? B + j * ldb : B + j;
+                    for (size_t p = 0; p < k; ++p) {
+                        sum += a_row[p] * TB::load(b + p * b_step);
+                    }
+                }
+                float& c = C[i * ldc + j];
+                c = beta == 0.0f ? alpha * sum : alpha * sum + beta * c;
+            }
+        }
+        return;
+    }
+    for (size_t i = 0; i < m; ++i) {
+        const auto* a = ta ? A + i : A + i * lda;
+        for (size_t j = 0; j < n; ++j) {
+            const auto* b = tb ? B + j * ldb : B + j;
+            float sum = 0.0f;
+            for (size_t p = 0; p < k; ++p) {
+                sum += TA::load(a + p * a_step) * TB::load(b + p * b_step);
+            }
+            float& c = C[i * ldc + j];
+            c = beta == 0.0f ? alpha * sum : alpha * sum + beta * c;
+        }
+    }
+}
+
+// Blocked product shared by every combination of operand formats
+template <typename TA, typename TB>
+void run(
+    Transpose trans_a,
+    Transpose trans_b,
+    size_t m,
+    size_t n,
+    size_t k,
+    float alpha,
+    const typename TA::type* A,
+    size_t lda,
+    const typename TB::type* B,
+    size_t ldb,
+    float beta,
+    float* C,
+    size_t ldc,
+    const Epilogue& epilogue
+) {
+    if (m == 0 || n == 0) {
+        return;
+    }
+    bool fused = has_work(epilogue);
+    if (k == 0 || alpha == 0.0f) {
+        scale_block(m, n, beta, C, ldc);
+        if (fused) {
+            finish(epilogue, m, n, C, ldc);
+        }
+        return;
+    }
+    // Only hand work to the pool when it outweighs waking the threads.
+    size_t threads = parallel::num_threads();
+    bool threaded = threads > 1 && m * n * k >= PARALLEL_THRESHOLD;
+    auto for_each = [threaded](size_t count, const auto& fn) {
+        if (threaded) {
+            parallel::parallel_for(count, fn);
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                fn(i);
+            }
+        }
+    };
+
+    if (m == 1 || n == 1 || m * n * k <= DIRECT_THRESHOLD) {
+        // Split the rows of C into contiguous chunks
+        size_t chunks = threaded ? std::min(m, 4 * threads) : 1;
+        for_each(chunks, [&](size_t chunk) {
+            size_t i0 = m * chunk / chunks;
+            size_t i1 = m * (chunk + 1) / chunks;
+            const auto* a = trans_a == Transpose::Yes ? A + i0
+                                                      : A + i0 * lda;
+            direct<TA, TB>(
+                trans_a,
+                trans_b,
+                i1 - i0,
+                n,
+                k,
+                alpha,
+                a,
+                lda,
+                B,
+                ldb,
+                beta,
+                C + i0 * ldc,
+                ldc
+            );
+            if (fused) {
+                finish(shifted(epilogue, i0, 0), i1 - i0, n, C + i0 * ldc, ldc);
+            }
+        });
+        return;
+    }
+
+    // Packing buffers are shared by the pool threads for the duration of a
+    // call and reused across calls to keep the hot path free of allocations.
+    thread_local Scratch scratch_a;
+    thread_local Scratch scratch_b;
+    float* packed_a = scratch_a.get(round_up(std::min(m, MS), MR) * KC);
+    float* packed_b = scratch_b.get(KC * NC);
+
+    // The micro-kernel can only overwrite or add to C, so any other beta is
+    // applied up front.
+    if (beta != 0.0f && beta != 1.0f) {
+        size_t chunks = threaded ? std::min(m, 4 * threads) : 1;
+        for_each(chunks, [&](size_t chunk) {
+            size_t i0 = m * chunk / chunks;
+            size_t i1 = m * (chunk + 1) / chunks;
+            scale_block(i1 - i0, n, beta, C + i0 * ldc, ldc);
+        });
+    }
+
+    for (size_t jc = 0; jc < n; jc += NC) {
+        size_t nc = std::min(NC, n - jc);
+        for (size_t pc = 0; pc < k; pc += KC) {
+            size_t kc = std::min(KC, k - pc);
+            float* pb = packed_b;
+            for_each(ceil_div(nc, NR), [&](size_t s) {
+                size_t j = s * NR;
+                size_t nr = std::min(NR, nc - j);
+                pack_b<TB>(kc, nr, B, ldb, trans_b, pc, jc + j, pb + j * kc);
+            });
+
+            for (size_t is = 0; is < m; is += MS) {
+                size_t ms = std::min(MS, m - is);
+                float* pa = packed_a;
+                for_each(ceil_div(ms, MR), [&](size_t s) {
+                    size_t i = s * MR;
+                    size_t mr = std::min(MR, ms - i);
+                    pack_a<TA>(mr, kc, A, lda, trans_a, is + i, pc, pa + i * kc);
+                });
+
+                // Each task owns a block of C, so every element is computed
+                // by one thread in the same order whatever the thread count.
+                size_t row_blocks = ceil_div(ms, MC);
+                size_t col_blocks = threaded
+                    ? std::max<size_t>(1, ceil_div(4 * threads, row_blocks))
+                    : 1;
+                size_t width = round_up(ceil_div(nc, col_blocks), NR);
+                col_blocks = ceil_div(nc, width);
+                bool last = pc + kc == k;
+                for_each(row_blocks * col_blocks, [&](size_t t) {
+                    size_t i = (t / col_blocks) * MC;
+                    size_t j = (t % col_blocks) * width;
+                    Epilogue block = shifted(epilogue, is + i, jc + j);
+                    macro_kernel(
+                        std::min(MC, ms - i),
+                        std::min(width, nc - j),
+                        kc,
+                        alpha,
+                        pa + i * kc,
+                        pb + j * kc,
+                        C + (is + i) * ldc + jc + j,
+                        ldc,
+                        pc != 0 || beta != 0.0f,
+                        fused && last ? &block : nullptr
+                    );
+                });
+            }
+        }
+    }
+}
+
+// Calls fn with the reader of format
+template <typename Fn>
+void with_reader(precision::Format format, const Fn& fn) {
+    switch (format) {
+        case precision::Format::FP32:
+            fn(Fp32{});
+            return;
+        case precision::Format::BF16:
+            fn(Bf16{});
+            return;
+        case precision::Format::FP16:
+            fn(Fp16{});
+            return;
+    }
+}
+
+}  // namespace
+
+void sgemm(
+    Transpose trans_a,
+    Transpose trans_b,
+    size_t m,
+    size_t n,
+    size_t k,
+    const float* A,
+    size_t lda,
+    const float* B,
+    size_t ldb,
+    float* C,
+    size_t ldc
+) {
+    sgemm(trans_a, trans_b, m, n, k, 1.0f, A, lda, B, ldb, 0.0f, C, ldc);
+}
+
+void sgemm(
+    Transpose trans_a,
+    Transpose trans_b,
+    size_t m,
+    size_t n,
+    size_t k,
+    float alpha,
+    const float* A,
+    size_t lda,
+    const float* B,
+    size_t ldb,
+    float beta,
+    float* C,
+    size_t ldc,
+    const Epilogue& epilogue
+) {
+    run<Fp32, Fp32>(
+        trans_a,
+        trans_b,
+        m,
+        n,
+        k,
+        alpha,
+        A,
+        lda,
+        B,
+        ldb,
+        beta,
+        C,
+        ldc,
+        epilogue
+    );
+}
+
+void gemm(
+    Transpose trans_a,
+    Transpose trans_b,
+    size_t m,
+    size_t n,
+    size_t k,
+    float alpha,
+    Operand A,
+    Operand B,
+    float beta,
+    float* C,
+    size_t ldc,
+    const Epilogue& epilogue
+) {
+    with_reader(A.format, [&](auto a) {
+        with_reader(B.format, [&](auto b) {
+            using TA = decltype(a);
+            using TB = decltype(b);
+            run<TA, TB>(
+                trans_a,
+                trans_b,
+                m,
+                n,
+                k,
+                alpha,
+                static_cast<const typename TA::type*>(A.data),
+                A.ld,
+                static_cast<const typename TB::type*>(B.data),
+                B.ld,
+                beta,
+                C,
+                ldc,
+                epilogue
+            );
+        });
+    });
+}
+
+}  // namespace gemm
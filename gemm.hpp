@@ -0,0 +1,103 @@
+#ifndef GEMM_HPP
+#define GEMM_HPP
+
+#include <cstddef>
+
+#include "precision.hpp"
+
+namespace gemm {
+
+// Whether an operand is used as stored or transposed, like BLAS trans flags.
+enum class Transpose { No, Yes };
+
+// Work done on each block of C right after its last product step, while the
+// block is still in cache, so that a layer's bias and activation cost no
+// extra pass over memory. Steps are optional and run in this order:
+//   C += bias      bias holds one value per row of C
+//   pre = C        pre is m x n with row stride ldpre
+//   C = activation(C)
+//   C = combine(C, operand)   operand is m x n with row stride ldoperand
+struct Epilogue {
+    const float* bias = nullptr;
+    float* pre = nullptr;
+    size_t ldpre = 0;
+    void (*activation)(const float* x, float* out, size_t n) = nullptr;
+    const float* operand = nullptr;
+    size_t ldoperand = 0;
+    void (*combine)(const float* c, const float* x, float* out, size_t n) =
+        nullptr;
+};
+
+// Performs C = op(A) * op(B) on row-major buffers, where op(X) is X or X^T.
+// op(A) is m x k and op(B) is k x n; lda and ldb are the row strides of A and
+// B as stored. C is m x n with row stride ldc and must not alias A or B.
+// Transposed operands are read in place, never copied.
+// Large products are split into blocks of C and run on parallel::pool(); each
+// element is computed by one thread in a fixed order, so results are bitwise
+// identical for any thread count.
+void sgemm(
+    Transpose trans_a,
+    Transpose trans_b,
+    size_t m,
+    size_t n,
+    size_t k,
+    const float* A,
+    size_t lda,
+    const float* B,
+    size_t ldb,
+    float* C,
+    size_t ldc
+);
+
+// Performs C = alpha * op(A) * op(B) + beta * C like BLAS sgemm, then applies
+// epilogue to every element of C. With beta == 0, C is not read, so it may
+// hold garbage. beta == 1 adds the product in place, e.g. an SGD step
+// straight from the outer products of a batch.
+void sgemm(
+    Transpose trans_a,
+    Transpose trans_b,
+    size_t m,
+    size_t n,
+    size_t k,
+    float alpha,
+    const float* A,
+    size_t lda,
+    const float* B,
+    size_t ldb,
+    float beta,
+    float* C,
+    size_t ldc,
+    const Epilogue& epilogue = {}
+);
+
+// Operand of a mixed-precision product: a row-major matrix with row stride
+// ld, stored in format
+struct Operand {
+    const void* data;
+    size_t ld;
+    precision::Format format = precision::Format::FP32;
+};
+
+// Like the full sgemm, with A and B stored in any precision::Format. 16-bit
+// values are widened to fp32 as they are packed (or read, for products small
+// enough to skip packing), so they cross memory at half the bytes while the
+// products and sums stay in fp32. With both operands in fp32 the results are
+// bitwise identical to sgemm.
+void gemm(
+    Transpose trans_a,
+    Transpose trans_b,
+    size_t m,
+    size_t n,
+    size_t k,
+    float alpha,
+    Operand A,
+    Operand B,
+    float beta,
+    float* C,
+    size_t ldc,
+    const Epilogue& epilogue = {}
+);
+
+}  // namespace gemm
+
+#endif  // GEMM_HPP
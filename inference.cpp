@@ -0,0 +1,217 @@
+#include "inference.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+#include "gemm.hpp"
+
+namespace inference {
+
+using matrix::ConstMatrixView;
+using matrix::MatrixView;
+
+namespace {
+
+constexpr size_t ALIGNMENT_FLOATS = memory::ALIGNMENT / sizeof(float);
+
+size_t padded(size_t n) {
+    return (n + ALIGNMENT_FLOATS - 1) / ALIGNMENT_FLOATS * ALIGNMENT_FLOATS;
+}
+
+// Index of the largest of n values stride apart
+size_t argmax(const float* x, size_t n, size_t stride) {
+    size_t best = 0;
+    for (size_t i = 1; i < n; ++i) {
+        if (x[i * stride] > x[best * stride]) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+}  // namespace
+
+Engine::Engine(const checkpoint::Checkpoint& saved, size_t batch_size)
+    : max_batch(batch_size) {
+    for (size_t l = 0; l < saved.depth(); ++l) {
+        bool last = l + 1 == saved.depth();
+        layers.push_back(Layer{
+            saved.weight(l),
+            saved.bias(l),
+            MatrixView(nullptr, 0, 0),
+            last ? saved.output_activation() : saved.hidden_activation(),
+        });
+    }
+    allocate();
+}
+
+Engine::Engine(const network::Network& net, size_t batch_size)
+    : max_batch(batch_size) {
+    for (size_t l = 0; l < net.depth(); ++l) {
+        bool last = l + 1 == net.depth();
+        layers.push_back(Layer{
+            net.weight(l),
+            net.bias(l),
+            MatrixView(nullptr, 0, 0),
+            last ? net.output_activation() : net.hidden_activation(),
+        });
+    }
+    allocate();
+}
+
+void Engine::allocate() {
+    if (max_batch == 0) {
+        throw std::invalid_argument("Batch size must be positive");
+    }
+    if (layers.empty()) {
+        throw std::invalid_argument("An engine needs at least one layer");
+    }
+
+    // A batch of input, then the output of every layer
+    arena_floats = padded(max_batch * input_size());
+    for (const auto& layer : layers) {
+        arena_floats += padded(layer.weight.N * max_batch);
+    }
+    arena = memory::make_buffer(arena_floats);
+    std::fill(arena.get(), arena.get() + arena_floats, 0.0f);
+
+    input = arena.get();
+    float* buffer = input + padded(max_batch * input_size());
+    for (auto& layer : layers) {
+        layer.out = MatrixView(buffer, layer.weight.N, max_batch);
+        buffer += padded(layer.weight.N * max_batch);
+    }
+}
+
+ConstMatrixView Engine::forward(ConstMatrixView x) {
+    if (x.M != input_size()) {
+        throw std::invalid_argument("Input must hold one sample of input_size() values per row");
+    }
+    if (x.N == 0 || x.N > max_batch) {
+        throw std::invalid_argument("Batch must hold between 1 and batch_size() samples");
+    }
+    batch = x.N;
+
+    // The same products as Network::forward, without the pre-activations
+    // it keeps for backprop
+    for (size_t l = 0; l < layers.size(); ++l) {
+        auto& layer = layers[l];
+        auto out = layer.out.block(0, 0, layer.out.N, batch);
+        bool first = l == 0;
+        ConstMatrixView below =
+            first ? x : layers[l - 1].out.block(0, 0, layer.weight.M, batch);
+        gemm::sgemm(
+            gemm::Transpose::No,
+            first ? gemm::Transpose::Yes : gemm::Transpose::No,
+            out.N,
+            out.M,
+            layer.weight.M,
+            1.0f,
+            layer.weight.data,
+            layer.weight.ld,
+            below.data,
+            below.ld,
+            0.0f,
+            out.data,
+            out.ld,
+            gemm::Epilogue{
+                layer.bias.data, nullptr, 0, activation::kernel(layer.kind)
+            }
+        );
+        if (layer.kind == activation::Kind::Softmax) {
+            activation::softmax(out, out);
+        }
+    }
+    auto& last = layers.back().out;
+    return last.block(0, 0, last.N, batch);
+}
+
+ConstMatrixView Engine::forward(
+    const mnist::MappedDataset& source, size_t first, size_t n
+) {
+    if (source.pixels() != input_size()) {
+        throw std::invalid_argument("Images must have input_size() pixels");
+    }
+    if (n == 0 || n > max_batch) {
+        throw std::invalid_argument("Batch must hold between 1 and batch_size() samples");
+    }
+    source.normalize_into(first, n, input);
+    return forward(ConstMatrixView(input, n, input_size()));
+}
+
+double Report::accuracy() const {
+    if (samples == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(correct) / static_cast<double>(samples);
+}
+
+double Report::images_per_second() const {
+    if (seconds <= 0.0) {
+        return 0.0;
+    }
+    return static_cast<double>(samples) / seconds;
+}
+
+double Report::latency_percentile(double p) const {
+    if (latencies.empty()) {
+        return 0.0;
+    }
+    auto sorted = latencies;
+    std::sort(sorted.begin(), sorted.end());
+    // Nearest rank
+    auto rank = static_cast<size_t>(
+        std::ceil(std::clamp(p, 0.0, 1.0) * static_cast<double>(sorted.size()))
+    );
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+Report evaluate(Engine& engine, const mnist::MappedDataset& source) {
+    return evaluate(engine, source, 0, source.size());
+}
+
+Report evaluate(
+    Engine& engine,
+    const mnist::MappedDataset& source,
+    size_t first,
+    size_t count
+) {
+    if (first > source.size() || count > source.size() - first) {
+        throw std::out_of_range("Evaluated samples exceed the dataset");
+    }
+    using clock = std::chrono::steady_clock;
+    Report report;
+    report.latencies.reserve(
+        (count + engine.batch_size() - 1) / engine.batch_size()
+    );
+    double cost = 0.0;
+    auto start = clock::now();
+    for (size_t done = 0; done < count; done += engine.batch_size()) {
+        size_t n = std::min(engine.batch_size(), count - done);
+        auto batch_start = clock::now();
+        auto output = engine.forward(source, first + done, n);
+        auto batch_end = clock::now();
+        report.latencies.push_back(
+            std::chrono::duration<double>(batch_end - batch_start).count()
+        );
+
+        for (size_t s = 0; s < n; ++s) {
+            size_t label = source.label(first + done + s);
+            size_t predicted = argmax(&output(0, s), output.N, output.ld);
+            report.correct += predicted == label;
+            for (size_t i = 0; i < output.N; ++i) {
+                double diff = output(i, s) - (i == label ? 1.0 : 0.0);
+                cost += diff * diff;
+            }
+        }
+    }
+    report.samples = count;
+    report.loss = count > 0 ? cost / static_cast<double>(count) : 0.0;
+    report.seconds =
+        std::chrono::duration<double>(clock::now() - start).count();
+    return report;
+}
+
+}  // namespace inference
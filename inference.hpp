@@ -0,0 +1,116 @@
+#ifndef INFERENCE_HPP
+#define INFERENCE_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "activation.hpp"
+#include "checkpoint.hpp"
+#include "matrix.hpp"
+#include "memory.hpp"
+#include "mnist.hpp"
+#include "network.hpp"
+
+namespace inference {
+
+// Forward-only network for batched inference.
+//
+// The weights are read in place, from the mapping of a checkpoint or from a
+// trained network. The engine allocates one arena holding a batch of
+// normalized input and the output of every layer; it keeps no gradients,
+// errors or pre-activations. Each layer is one gemm::sgemm with the bias and
+// activation fused in, split over parallel::pool(), and the outputs are
+// bitwise those of network::Network::forward.
+class Engine {
+  public:
+    // Reads the weights of saved, which must outlive the engine. Batches may
+    // hold up to batch_size samples.
+    Engine(const checkpoint::Checkpoint& saved, size_t batch_size);
+
+    // Reads the weights of net, which must outlive the engine
+    Engine(const network::Network& net, size_t batch_size);
+
+    Engine(Engine&&) noexcept = default;
+    Engine& operator=(Engine&&) noexcept = default;
+    Engine(const Engine&) = delete;
+    Engine& operator=(const Engine&) = delete;
+
+    size_t depth() const { return layers.size(); }
+    size_t input_size() const { return layers.front().weight.M; }
+    size_t output_size() const { return layers.back().weight.N; }
+    size_t batch_size() const { return max_batch; }
+
+    // Bytes the engine allocated, against the arena of a Network of the same
+    // topology and batch size
+    size_t buffer_bytes() const { return arena_floats * sizeof(float); }
+
+    // Runs input (n x input_size(), n <= batch_size()) through every layer
+    // and returns the output layer, output_size() x n
+    matrix::ConstMatrixView forward(matrix::ConstMatrixView input);
+
+    // Normalizes images [first, first + n) of source into the input buffer
+    // and runs them like forward. Throws std::invalid_argument if the images
+    // are not input_size() pixels.
+    matrix::ConstMatrixView forward(
+        const mnist::MappedDataset& source, size_t first, size_t n
+    );
+
+  private:
+    struct Layer {
+        matrix::ConstMatrixView weight;
+        matrix::ConstMatrixView bias;
+        // Activated output, weight.N x batch_size
+        matrix::MatrixView out;
+        activation::Kind kind;
+    };
+
+    // Checks the layers and allocates the input and output buffers
+    void allocate();
+
+    size_t max_batch;
+    std::vector<Layer> layers;
+    memory::Buffer arena;
+    size_t arena_floats = 0;
+    // batch_size x input_size(), one sample per row
+    float* input = nullptr;
+    size_t batch = 0;
+};
+
+// Result of running a labelled dataset through an Engine
+struct Report {
+    size_t samples = 0;
+    size_t correct = 0;
+    // Squared error against the one-hot labels, averaged over the samples:
+    // the cost the training loop reports
+    double loss = 0.0;
+    // Wall time of the whole run
+    double seconds = 0.0;
+    // Seconds per batch, from normalizing its images to its last output, in
+    // the order of the batches
+    std::vector<double> latencies;
+
+    double accuracy() const;
+    double images_per_second() const;
+
+    // Smallest batch latency that at least fraction p of the batches do not
+    // exceed, e.g. 0.99 for the p99; 0 without batches
+    double latency_percentile(double p) const;
+};
+
+// Streams every image of source through engine in batches of
+// engine.batch_size() and counts the samples whose largest output is their
+// label
+Report evaluate(Engine& engine, const mnist::MappedDataset& source);
+
+// The same over samples [first, first + count) of source only, e.g. a
+// validation split. Throws std::out_of_range if they are not all in source.
+Report evaluate(
+    Engine& engine,
+    const mnist::MappedDataset& source,
+    size_t first,
+    size_t count
+);
+
+}  // namespace inference
+
+#endif  // INFERENCE_HPP
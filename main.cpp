@@ -1,208 +1,705 @@
 #include <algorithm>
-#include <backward.hpp>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <filesystem>
+#include <iomanip>
 #include <iostream>
-#include <random>
+#include <optional>
 #include <ranges>
+#include <string>
 
+#include "activation.hpp"
+#include "checkpoint.hpp"
+#include "distributed.hpp"
+#include "inference.hpp"
 #include "matrix.hpp"
+#include "memory.hpp"
 #include "mnist.hpp"
+#include "network.hpp"
+#include "optimizer.hpp"
+#include "parallel.hpp"
+#include "pipeline.hpp"
+#include "precision.hpp"
+#include "quantize.hpp"
+#include "trainer.hpp"
+
+#ifdef NNPP_BACKWARD
+#include <backward.hpp>
+
+backward::SignalHandling sh{};
+#endif
 
 using namespace matrix;
 
-float sigmoid(float x) {
-    auto res = std::exp(x);
-    return res / (1 + res);
+// Returns true if a multiple of period lies in [start, start + count)
+static bool crosses(size_t start, size_t count, size_t period) {
+    return (period - start % period) % period < count;
 }
 
-float sigmoid_derivative(float x) {
-    auto res = sigmoid(x);
-    return res * (1 - res);
+// Index of the largest of n values stride apart
+static uint8_t argmax(const float* x, size_t n, size_t stride) {
+    uint8_t best = 0;
+    for (uint8_t i = 1; i < n; i++) {
+        if (x[i * stride] > x[best * stride]) {
+            best = i;
+        }
+    }
+    return best;
 }
 
-backward::SignalHandling sh{};
-
-int main() {
-    auto cwd = std::filesystem::current_path();
-
-    std::cout << "Loading MNIST dataset..." << std::endl;
-    auto [images, labels] = mnist::load_mnist(
-        (cwd / "data" / "train-images.idx3-ubyte").string(),
-        (cwd / "data" / "train-labels.idx1-ubyte").string()
-    );
-    std::cout << "Done" << std::endl;
-
-    images[0].print();
-
-    std::cout << "Number of images: " << images.size() << std::endl;
-    std::cout << "Number of labels: " << labels.size() << std::endl;
+// Quantizes net to int8, calibrated on the first calibration samples, and
+// compares both on the whole dataset in batches of net.batch_size()
+static void report_quantized(
+    network::Network& net, const mnist::Dataset& dataset, size_t calibration
+) {
+    calibration = std::min(calibration, dataset.size());
+    auto calibrated = quantize::calibrate(net, dataset.batch(0, calibration));
+    quantize::Model model(net, calibrated, net.batch_size());
+
+    size_t fp32_bytes = 0;
+    for (size_t l = 0; l < net.depth(); l++) {
+        fp32_bytes += (net.weight(l).N * net.weight(l).M + net.bias(l).N) *
+                      sizeof(float);
+    }
+    std::cout << "Int8 model calibrated on " << calibration << " samples: "
+              << model.parameter_bytes() << " bytes of parameters, fp32 "
+              << fp32_bytes << std::endl;
+
+    size_t correct_fp32 = 0;
+    size_t correct_int8 = 0;
+    size_t agree = 0;
+    std::chrono::steady_clock::duration fp32_time{};
+    std::chrono::steady_clock::duration int8_time{};
+    for (size_t first = 0; first < dataset.size(); first += net.batch_size()) {
+        size_t n = std::min(net.batch_size(), dataset.size() - first);
+        auto input = dataset.batch(first, n);
+
+        auto start = std::chrono::steady_clock::now();
+        auto reference = net.forward(input);
+        auto middle = std::chrono::steady_clock::now();
+        auto quantized = model.forward(input);
+        int8_time += std::chrono::steady_clock::now() - middle;
+        fp32_time += middle - start;
+
+        for (size_t s = 0; s < n; s++) {
+            uint8_t expected =
+                argmax(&reference(0, s), reference.N, reference.ld);
+            uint8_t predicted = argmax(quantized.row(s), quantized.M, 1);
+            correct_fp32 += expected == dataset.label(first + s);
+            correct_int8 += predicted == dataset.label(first + s);
+            agree += predicted == expected;
+        }
+    }
 
-    // RNG
-    std::mt19937 gen(0);
-    std::uniform_real_distribution<> dist(-0.1, 0.1);
-    auto init = [&dist, &gen](size_t i, size_t j) {
-        return static_cast<float>(dist(gen));
+    auto rate = [&](std::chrono::steady_clock::duration time) {
+        return static_cast<double>(dataset.size()) /
+               std::chrono::duration<double>(time).count();
     };
-
-    // Declarative layers
-    Matrix RealLayer(10, 1);
-    std::vector<Matrix> Layer = {
-        Matrix(images[0].N, 1),
-        // Matrix(128, 1),
-        Matrix(16, 1),
-        Matrix(16, 1),
-        Matrix(RealLayer.N, 1)
+    auto percent = [&](size_t count) {
+        return 100.0 * static_cast<double>(count) /
+               static_cast<double>(dataset.size());
     };
+    std::cout << "fp32: " << percent(correct_fp32) << "% accuracy, "
+              << rate(fp32_time) << " samples/s" << std::endl;
+    std::cout << "int8: " << percent(correct_int8) << "% accuracy, "
+              << rate(int8_time) << " samples/s, " << percent(agree)
+              << "% of predictions agree with fp32" << std::endl;
+}
 
-    // Declarative Biases
-    std::vector<Matrix> Bias{};
-    std::vector<Matrix> Activation{};
-    for (auto layer : Layer) {
-        Bias.push_back(layer.cloned());
-        Activation.push_back(layer.cloned());
-    }
+// Streams the images and labels through the network of a checkpoint,
+// forward only, and reports accuracy, throughput and batch latency
+static void evaluate_checkpoint(
+    const std::string& path,
+    const std::string& images,
+    const std::string& labels,
+    size_t batch_size
+) {
+    checkpoint::Checkpoint saved(path);
+    mnist::MappedDataset dataset(images, labels);
+    inference::Engine engine(saved, batch_size);
+    std::cout << "Evaluating " << path << " on " << dataset.size()
+              << " images of " << images << std::endl;
+    std::cout << "Batch size: " << batch_size
+              << ", threads: " << parallel::num_threads() << std::endl;
+    std::cout << "Weights mapped in place: "
+              << saved.parameters().size_bytes() << " bytes, buffers "
+              << engine.buffer_bytes() << " bytes" << std::endl;
+
+    auto report = inference::evaluate(engine, dataset);
+    auto micros = [](double seconds) { return seconds * 1e6; };
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Accuracy: " << 100.0 * report.accuracy() << "% of "
+              << report.samples << " images" << std::endl;
+    std::cout << "Throughput: " << report.images_per_second() << " images/s"
+              << std::endl;
+    std::cout << "Batch latency: p50 "
+              << micros(report.latency_percentile(0.5)) << " us, p99 "
+              << micros(report.latency_percentile(0.99)) << " us"
+              << std::endl;
+}
 
-    // Declarative Weights
-    std::vector<Matrix> Weight{};
-    for (size_t i = 0; i < Layer.size() - 1; i++) {
-        Weight.push_back(Matrix(Layer[i + 1].N, Layer[i].N, init));
+int main(int argc, char* argv[]) {
+    // Samples per training step. 1 trains on single samples, larger values
+    // stack that many images into the columns of each layer.
+    size_t batch_size = 1;
+    // Gradients are averaged over the batch, so larger batches usually want a
+    // larger rate. Adaptive optimizers default to 0.001 instead.
+    float learning_rate = 0.1f;
+    // Update rule and its hyperparameters, and the shape of the learning
+    // rate over the run
+    optimizer::Settings optimizer_settings;
+    bool optimizer_given = false;
+    bool weight_decay_given = false;
+    optimizer::Schedule schedule;
+    // Activation of the hidden layers, and of the output layer, whose error
+    // is taken as output - target: the gradient of cross-entropy for sigmoid
+    // and softmax alike.
+    auto hidden = activation::Kind::Sigmoid;
+    auto output = activation::Kind::Sigmoid;
+    // Passes over the training split, each in a new random order unless
+    // shuffle is off
+    size_t epochs = 1;
+    bool shuffle = true;
+    // Samples held out from the end of the training file, validated on in
+    // batched inference after every epoch; 0 validates nothing
+    size_t validation = 10000;
+    // Stop after patience epochs without a better validation loss or
+    // accuracy (0 never stops), or once the validation accuracy reaches
+    // target_accuracy percent (0 never does)
+    auto monitor = trainer::Monitor::Loss;
+    size_t patience = 3;
+    double target_accuracy = 0.0;
+    // Samples calibrating an int8 copy of the trained network, compared with
+    // it after training; 0 skips quantization
+    size_t calibration = 0;
+    // Replicas training on shards of every batch; 1 trains the network
+    // directly, 0 runs one per thread, as Hogwild does unless given
+    size_t workers = 1;
+    bool workers_given = false;
+    // Workers update the shared weights asynchronously, without locks
+    bool hogwild = false;
+    // Processes training together, each on its own shard of the dataset,
+    // this process's rank among them and the path their sockets meet at
+    size_t world = 1;
+    size_t rank = 0;
+    std::string rendezvous =
+        (std::filesystem::temp_directory_path() / "nn++-ring").string();
+    // Storage of the weights and activations in forward passes
+    auto storage = precision::Format::FP32;
+    // Checkpoint written every checkpoint_every samples and after training,
+    // and one to continue from
+    std::string checkpoint_path;
+    size_t checkpoint_every = 10000;
+    bool checkpoint_every_given = false;
+    std::string resume_path;
+    bool rate_given = false;
+    // Checkpoint to evaluate instead of training, and the IDX files to
+    // evaluate it on
+    std::string evaluate_path;
+    std::string images_path;
+    std::string labels_path;
+    for (int arg = 1; arg < argc; arg++) {
+        std::string flag = argv[arg];
+        if (flag == "--batch-size" && arg + 1 < argc) {
+            batch_size = std::stoul(argv[++arg]);
+        } else if (flag == "--learning-rate" && arg + 1 < argc) {
+            learning_rate = std::stof(argv[++arg]);
+            rate_given = true;
+        } else if (flag == "--optimizer" && arg + 1 < argc) {
+            optimizer_settings.kind = optimizer::parse(argv[++arg]);
+            optimizer_given = true;
+        } else if (flag == "--momentum" && arg + 1 < argc) {
+            optimizer_settings.momentum = std::stof(argv[++arg]);
+        } else if (flag == "--weight-decay" && arg + 1 < argc) {
+            optimizer_settings.weight_decay = std::stof(argv[++arg]);
+            weight_decay_given = true;
+        } else if (flag == "--schedule" && arg + 1 < argc) {
+            schedule.decay = optimizer::parse_decay(argv[++arg]);
+        } else if (flag == "--warmup" && arg + 1 < argc) {
+            schedule.warmup = std::stoul(argv[++arg]);
+        } else if (flag == "--decay-steps" && arg + 1 < argc) {
+            schedule.period = std::stoul(argv[++arg]);
+        } else if (flag == "--decay-rate" && arg + 1 < argc) {
+            schedule.gamma = std::stof(argv[++arg]);
+        } else if (flag == "--epochs" && arg + 1 < argc) {
+            epochs = std::stoul(argv[++arg]);
+        } else if (flag == "--validation" && arg + 1 < argc) {
+            validation = std::stoul(argv[++arg]);
+        } else if (flag == "--monitor" && arg + 1 < argc) {
+            monitor = trainer::parse_monitor(argv[++arg]);
+        } else if (flag == "--patience" && arg + 1 < argc) {
+            patience = std::stoul(argv[++arg]);
+        } else if (flag == "--target-accuracy" && arg + 1 < argc) {
+            target_accuracy = std::stod(argv[++arg]);
+        } else if (flag == "--threads" && arg + 1 < argc) {
+            parallel::set_num_threads(std::stoul(argv[++arg]));
+        } else if (flag == "--workers" && arg + 1 < argc) {
+            workers = std::stoul(argv[++arg]);
+            workers_given = true;
+        } else if (flag == "--activation" && arg + 1 < argc) {
+            hidden = activation::parse(argv[++arg]);
+        } else if (flag == "--output" && arg + 1 < argc) {
+            output = activation::parse(argv[++arg]);
+        } else if (flag == "--precision" && arg + 1 < argc) {
+            storage = precision::parse(argv[++arg]);
+        } else if (flag == "--quantize" && arg + 1 < argc) {
+            calibration = std::stoul(argv[++arg]);
+        } else if (flag == "--checkpoint" && arg + 1 < argc) {
+            checkpoint_path = argv[++arg];
+        } else if (flag == "--checkpoint-every" && arg + 1 < argc) {
+            checkpoint_every = std::stoul(argv[++arg]);
+            checkpoint_every_given = true;
+        } else if (flag == "--resume" && arg + 1 < argc) {
+            resume_path = argv[++arg];
+        } else if (flag == "--evaluate" && arg + 1 < argc) {
+            evaluate_path = argv[++arg];
+        } else if (flag == "--images" && arg + 1 < argc) {
+            images_path = argv[++arg];
+        } else if (flag == "--labels" && arg + 1 < argc) {
+            labels_path = argv[++arg];
+        } else if (flag == "--world" && arg + 1 < argc) {
+            world = std::stoul(argv[++arg]);
+        } else if (flag == "--rank" && arg + 1 < argc) {
+            rank = std::stoul(argv[++arg]);
+        } else if (flag == "--rendezvous" && arg + 1 < argc) {
+            rendezvous = argv[++arg];
+        } else if (flag == "--hogwild") {
+            hogwild = true;
+        } else if (flag == "--no-shuffle") {
+            shuffle = false;
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--batch-size N] [--learning-rate X] [--threads N]"
+                         " [--epochs N] [--validation N] [--patience N]"
+                         " [--monitor loss|accuracy] [--target-accuracy X]"
+                         " [--optimizer NAME] [--momentum X]"
+                         " [--weight-decay X] [--schedule NAME] [--warmup N]"
+                         " [--decay-steps N] [--decay-rate X]"
+                         " [--workers N] [--hogwild]"
+                         " [--world N --rank R [--rendezvous PATH]]"
+                         " [--activation NAME] [--output sigmoid|softmax]"
+                         " [--precision fp32|bf16|fp16] [--quantize N]"
+                         " [--checkpoint PATH] [--checkpoint-every N]"
+                         " [--resume PATH] [--no-shuffle]"
+                         " [--evaluate PATH [--images PATH --labels PATH]]"
+                      << std::endl;
+            return 1;
+        }
+    }
+    if (batch_size == 0) {
+        std::cerr << "Batch size must be positive" << std::endl;
+        return 1;
+    }
+    if (epochs == 0) {
+        std::cerr << "Train for at least one epoch" << std::endl;
+        return 1;
+    }
+    if (checkpoint_every == 0) {
+        std::cerr << "Checkpoint interval must be positive" << std::endl;
+        return 1;
+    }
+    if (world == 0 || rank >= world) {
+        std::cerr << "Rank must be below the world size" << std::endl;
+        return 1;
+    }
+    if (schedule.decay == optimizer::Decay::Step && schedule.period == 0) {
+        std::cerr << "The step schedule needs --decay-steps" << std::endl;
+        return 1;
+    }
+    if (world > 1 && (hogwild || workers != 1)) {
+        std::cerr << "Distributed training runs one worker per process"
+                  << std::endl;
+        return 1;
     }
 
-    // Declarative deltas
-    std::vector<Matrix> dWeight{};
-    for (auto w : Weight) {
-        dWeight.push_back(w.clone_seeded(0.0f));
+    // A resumed run keeps the activations of the checkpoint and, unless
+    // given, its optimizer and learning rate
+    std::optional<checkpoint::Checkpoint> resumed;
+    if (!resume_path.empty()) {
+        resumed.emplace(resume_path);
+        hidden = resumed->hidden_activation();
+        output = resumed->output_activation();
+        if (!optimizer_given) {
+            optimizer_settings.kind = resumed->progress().optimizer;
+        }
+        if (!rate_given) {
+            learning_rate = resumed->progress().learning_rate;
+        }
+    }
+    auto adaptive = optimizer_settings.kind == optimizer::Kind::RMSProp ||
+                    optimizer_settings.kind == optimizer::Kind::Adam ||
+                    optimizer_settings.kind == optimizer::Kind::AdamW;
+    if (adaptive && !rate_given && !resumed) {
+        learning_rate = 0.001f;
     }
-    std::vector<Matrix> dBias{};
-    for (auto b : Bias) {
-        dBias.push_back(b.clone_seeded(0.0f));
+    // Only AdamW decays the weights apart from the gradient
+    if (weight_decay_given &&
+        optimizer_settings.kind != optimizer::Kind::AdamW) {
+        std::cerr << "Weight decay needs the adamw optimizer" << std::endl;
+        return 1;
+    }
+    // Hogwild workers would race on the moments as well as the weights
+    if (hogwild && optimizer_settings.kind != optimizer::Kind::SGD) {
+        std::cerr << "Hogwild trains with plain SGD" << std::endl;
+        return 1;
+    }
+    // Its workers step at one rate on samples reshuffled every epoch, and
+    // the run is checkpointed once it ends
+    if (hogwild && (schedule.decay != optimizer::Decay::Constant ||
+                    schedule.warmup > 0)) {
+        std::cerr << "Hogwild trains at a constant learning rate" << std::endl;
+        return 1;
+    }
+    if (hogwild && (checkpoint_every_given || !shuffle)) {
+        std::cerr << "Hogwild shuffles every epoch and checkpoints after "
+                     "training"
+                  << std::endl;
+        return 1;
+    }
+    if (hogwild && !workers_given) {
+        workers = 0;
+    }
+    if (hidden == activation::Kind::Softmax) {
+        std::cerr << "Hidden layers need an elementwise activation" << std::endl;
+        return 1;
+    }
+    if (output != activation::Kind::Sigmoid &&
+        output != activation::Kind::Softmax) {
+        std::cerr << "Output activation must be sigmoid or softmax" << std::endl;
+        return 1;
     }
 
-    auto epochs = std::max(static_cast<size_t>(10000), images.size());
-    bool do_break = false;
+    auto cwd = std::filesystem::current_path();
 
-    std::vector<float> window{};
+    if (!evaluate_path.empty()) {
+        // The MNIST test set unless other files are given
+        if (images_path.empty()) {
+            images_path = (cwd / "data" / "t10k-images.idx3-ubyte").string();
+        }
+        if (labels_path.empty()) {
+            labels_path = (cwd / "data" / "t10k-labels.idx1-ubyte").string();
+        }
+        evaluate_checkpoint(
+            evaluate_path, images_path, labels_path, batch_size
+        );
+        return 0;
+    }
 
-    auto now = std::chrono::steady_clock::now();
+    std::cout << "Loading MNIST dataset..." << std::endl;
+    auto load_start = std::chrono::steady_clock::now();
+    // The last validation samples of the file are held out, and stay
+    // mapped for the validation passes. The training split is normalized
+    // into one contiguous buffer; samples are views into it. Distributed
+    // ranks keep only their own shard of it, and all validate on the whole
+    // held-out split.
+    mnist::MappedDataset source(
+        (cwd / "data" / "train-images.idx3-ubyte").string(),
+        (cwd / "data" / "train-labels.idx1-ubyte").string()
+    );
+    if (validation >= source.size()) {
+        std::cerr << "The validation split leaves no samples to train on"
+                  << std::endl;
+        return 1;
+    }
+    size_t train_count = source.size() - validation;
+    auto dataset = world > 1
+                       ? mnist::load_shard(source, train_count, rank, world)
+                       : mnist::Dataset(source, 0, train_count);
+    auto load_time = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - load_start
+    );
+    std::cout << "Done in " << load_time.count() << " us" << std::endl;
+
+    Matrix first_image(dataset.pixels(), 1);
+    first_image.set_column(0, dataset.sample(0));
+    first_image.print();
+
+    std::cout << "Number of images: " << dataset.size() << std::endl;
+    std::cout << "Number of labels: " << dataset.size() << std::endl;
+    std::cout << "Validation samples: " << validation << std::endl;
+    std::cout << "Epochs: " << epochs << std::endl;
+    std::cout << "Batch size: " << batch_size << std::endl;
+    std::cout << "Learning rate: " << learning_rate << std::endl;
+    std::cout << "Optimizer: " << optimizer::name(optimizer_settings.kind)
+              << ", schedule " << optimizer::name(schedule.decay) << std::endl;
+    std::cout << "Threads: " << parallel::num_threads() << std::endl;
+    std::cout << "Activation: " << activation::name(hidden) << ", output "
+              << activation::name(output) << std::endl;
+    std::cout << "Precision: " << precision::name(storage) << std::endl;
+
+    // 784-16-16-10 network; all of its storage is allocated here, once
+    network::Network net(
+        {dataset.pixels(), 16, 16, mnist::CLASSES}, batch_size, hidden, output
+    );
+    net.set_storage_format(storage);
+    // Its moment buffers are allocated here too
+    optimizer::Optimizer optimizer(net, optimizer_settings);
+    // Samples this process trained on before this run; checkpoints count
+    // the samples of every rank
+    size_t start = 0;
+    if (resumed) {
+        resumed->restore(net);
+        if (resumed->progress().optimizer == optimizer.kind()) {
+            resumed->restore(optimizer);
+        } else {
+            std::cout << "Optimizer state not restored: the checkpoint used "
+                      << optimizer::name(resumed->progress().optimizer)
+                      << std::endl;
+        }
+        start = resumed->progress().samples / world;
+        std::cout << "Resumed from " << resume_path << " after " << start
+                  << " samples" << std::endl;
+    }
 
-    for (size_t epoch = 0; epoch < epochs; epoch++) {
-        auto image = images[epoch];
-        auto label = labels[epoch];
+    // Data-parallel training, with the gradients of the shards all-reduced
+    // into net
+    std::optional<trainer::DataParallel> data_parallel;
+    // Or asynchronous training, each worker stepping on its own batches
+    std::optional<trainer::Hogwild> hogwild_trainer;
+    // Or synchronous training with the other ranks, which all start from
+    // the same weights: the seeded ones or the same checkpoint
+    std::optional<distributed::Ring> ring;
+    std::optional<distributed::Trainer> distributed_trainer;
+    if (world > 1) {
+        std::cout << "Rank " << rank << " of " << world << ", waiting at "
+                  << rendezvous << std::endl;
+        ring.emplace(rendezvous, rank, world);
+        distributed_trainer.emplace(net, *ring, &optimizer);
+    }
+    if (hogwild) {
+        hogwild_trainer.emplace(net, workers, batch_size);
+        std::cout << "Hogwild workers: " << hogwild_trainer->workers()
+                  << std::endl;
+    } else if (workers != 1) {
+        data_parallel.emplace(net, workers, &optimizer);
+        std::cout << "Workers: " << data_parallel->workers() << std::endl;
+    }
 
-        // Populate real layer
-        for (uint8_t i = 0; i < 10; i++) {
-            RealLayer(i, 0) = (label == i) ? 1.0f : 0.0f;
-        }
+    // Batches are shuffled, gathered into contiguous buffers and one-hot
+    // encoded on a background thread while the network trains on the
+    // previous one
+    pipeline::Options loader_options;
+    loader_options.batch_size = batch_size;
+    loader_options.classes = net.output_size();
+    loader_options.shuffle = shuffle;
+    loader_options.start = start;
+    pipeline::BatchLoader loader(dataset, loader_options);
+
+    // Samples of the whole run: epochs passes over the training split
+    size_t total = epochs * dataset.size();
+    // Cosine annealing spans the steps of the run after the warmup unless
+    // told otherwise
+    if (schedule.decay == optimizer::Decay::Cosine && schedule.period == 0) {
+        uint64_t steps = epochs * loader.batches_per_epoch();
+        schedule.period = steps > schedule.warmup ? steps - schedule.warmup : 1;
+    }
+    // Saves the network with the optimizer's state; the ranks hold the same
+    // weights, so rank 0 saves them for all
+    auto save = [&](uint64_t samples) {
+        checkpoint::Progress progress{
+            samples * world, learning_rate, optimizer.kind(), optimizer.steps()
+        };
+        checkpoint::save(checkpoint_path, net, progress, optimizer.state());
+    };
 
-        // Copy input image to first layer
-        image.clone_into(Layer[0]);
-        image.clone_into(Activation[0]);
+    // Forward-only view of net's weights, running the validation split in
+    // large batches whatever the training batch size
+    std::optional<inference::Engine> validator;
+    if (validation > 0) {
+        validator.emplace(net, std::max(batch_size, size_t{512}));
+    }
+    trainer::EarlyStopping stopping(monitor, patience);
+    std::optional<double> target_seconds;
+    std::chrono::steady_clock::duration validation_time{};
+
+    // Samples whose prediction, made before training on them, was right;
+    // compares precisions on the same run
+    size_t correct = 0;
+    size_t seen = 0;
+    // The same for the epoch being trained, with its summed cost
+    size_t epoch_correct = 0;
+    size_t epoch_seen = 0;
+    double epoch_cost = 0.0;
+
+    // Every buffer of the loop is allocated above, so the heap counters only
+    // move for the first GEMM calls sizing their packing buffers and for the
+    // latency list of each validation pass
+    auto heap_before = memory::heap_stats();
+    auto now = std::chrono::steady_clock::now();
+    auto seconds = [](std::chrono::steady_clock::duration time) {
+        return std::chrono::duration<double>(time).count();
+    };
 
-        // Forward propagation
-        for (size_t i = 0; i < Weight.size(); i++) {
-            Weight[i].multiply_into(Layer[i], Activation[i + 1]);
-            Activation[i + 1].sum_into(Bias[i + 1]);
-            Activation[i + 1].clone_into(Layer[i + 1]);
-            Layer[i + 1].apply(sigmoid);
+    // Validates the weights trained for epoch + 1 epochs, reports them and
+    // returns whether to stop. Ranks validate the same weights on the same
+    // split, and stop together.
+    auto validate = [&](size_t epoch) {
+        auto validation_start = std::chrono::steady_clock::now();
+        auto report =
+            inference::evaluate(*validator, source, train_count, validation);
+        validation_time += std::chrono::steady_clock::now() - validation_start;
+        auto elapsed = seconds(std::chrono::steady_clock::now() - now);
+        std::cout << std::fixed << std::setprecision(4);
+        std::cout << "Validation after epoch " << epoch + 1 << ": loss "
+                  << report.loss << ", accuracy " << 100.0 * report.accuracy()
+                  << "%, " << elapsed << " s elapsed" << std::endl;
+        bool stop = stopping.update(report.loss, report.accuracy());
+        if (stop) {
+            std::cout << "Early stop: " << patience
+                      << " epochs without a better validation "
+                      << trainer::name(stopping.monitor())
+                      << " than after epoch " << stopping.best_epoch() + 1
+                      << std::endl;
         }
-
-        // Cost calculation
-        float cost = 0.0f;
-        for (size_t i = 0; i < RealLayer.N; i++) {
-            auto diff = Layer.back()(i, 0) - RealLayer(i, 0);
-            cost += diff * diff;
+        if (target_accuracy > 0.0 && !target_seconds &&
+            100.0 * report.accuracy() >= target_accuracy) {
+            target_seconds = elapsed;
+            std::cout << "Reached " << target_accuracy
+                      << "% validation accuracy after " << epoch + 1
+                      << " epochs in " << elapsed << " s" << std::endl;
+            stop = true;
         }
-        float learning_rate = 0.1f;  // Fixed learning rate
+        return stop;
+    };
 
-        // Backpropagation
-        // Calculate output layer error
-        Layer.back().elementwise_into(
-            RealLayer, dBias.back(), [](auto n, auto r) { return n - r; }
+    // Hogwild runs the epochs of the synchronous loop one call at a time,
+    // continuing a resumed run from its sample, and validates after each
+    for (size_t sample = start; hogwild_trainer && sample < total;) {
+        size_t epoch = sample / dataset.size();
+        size_t end = std::min(total, (epoch + 1) * dataset.size());
+        auto report = hogwild_trainer->train(
+            dataset.batch(0, dataset.size()),
+            dataset.labels(0, dataset.size()),
+            sample,
+            end - sample,
+            learning_rate
         );
+        sample = end;
+        std::cout << std::fixed << std::setprecision(4) << std::endl
+                  << "Epoch " << epoch + 1 << " of " << epochs
+                  << ": training cost "
+                  << report.cost / static_cast<double>(report.samples)
+                  << ", accuracy " << 100.0 * report.accuracy() << "%"
+                  << std::endl;
+        correct += report.correct;
+        seen += report.samples;
+        if (validator && validate(epoch)) {
+            break;
+        }
+    }
 
-        // Backpropagate through hidden layers
-        for (int i = static_cast<int>(Weight.size()) - 1; i >= 0; i--) {
-            if (i > 0) {
-                // Calculate dBias for hidden layers
-                Weight[i].transpose_multiply_into(dBias[i + 1], dBias[i]);
-                dBias[i].elementwise_into(
-                    Activation[i],
-                    dBias[i],
-                    [](auto left, auto right) {
-                        return left * sigmoid_derivative(right);
-                    }
-                );
-            }
-
-            // Calculate dWeight
-            dBias[i + 1].multiply_transpose_into(Layer[i], dWeight[i]);
-        }
-        // Apply deltas to biases (skip input layer at index 0)
-        for (size_t i = 1; i < Bias.size(); i++) {
-            Bias[i].elementwise_into(
-                dBias[i],
-                Bias[i],
-                [learning_rate](auto b, auto db) {
-                    return b - db * learning_rate;
-                }
-            );
-        }
-
-        // Apply deltas to weights
-        for (size_t i = 0; i < Weight.size(); i++) {
-            Weight[i].elementwise_into(
-                dWeight[i],
-                Weight[i],
-                [learning_rate](auto w, auto dw) {
-                    return w - dw * learning_rate;
-                }
-            );
-        }
-
-        float max_pred = 0.0f;
-        for (uint8_t i = 0; i<10; i++) {
-            if (Layer.back()(i, 0) > max_pred) {
-                max_pred = Layer.back()(i, 0);
-            }
+    for (size_t sample = start; !hogwild_trainer && sample < total;) {
+        const auto& batch = loader.next();
+        float rate = schedule.rate(learning_rate, optimizer.steps());
+        ConstMatrixView prediction{nullptr, 0, 0};
+        if (distributed_trainer) {
+            prediction =
+                distributed_trainer->step(batch.input, batch.target, rate);
+        } else if (data_parallel) {
+            prediction = data_parallel->step(batch.input, batch.target, rate);
+        } else {
+            prediction = net.forward(batch.input);
+            net.backward(batch.target);
+            optimizer.step(rate, batch.size);
         }
-        window.push_back(max_pred);
-        if (epoch % 30 == 0) {
-            // Calculate the average of the window
-            float avg = std::accumulate(window.begin(), window.end(), 0.0f) / window.size();
-            if (avg > 0.9f) {
-                do_break = true;
+
+        // Cost calculation, averaged over the batch
+        float cost = 0.0f;
+        for (size_t b = 0; b < batch.size; b++) {
+            for (size_t i = 0; i < batch.target.N; i++) {
+                auto diff = prediction(i, b) - batch.target(i, b);
+                cost += diff * diff;
             }
-            window.clear();
+            uint8_t predicted =
+                argmax(&prediction(0, b), prediction.N, prediction.ld);
+            epoch_correct += predicted == batch.labels[b];
         }
+        epoch_cost += cost;
+        epoch_seen += batch.size;
+        cost /= static_cast<float>(batch.size);
 
+        if (!checkpoint_path.empty() && rank == 0 &&
+            crosses(sample, batch.size, checkpoint_every)) {
+            save(sample + batch.size);
+        }
 
-        if (epoch % 1000 == 0 || do_break) {
+        if (crosses(sample, batch.size, 1000)) {
             std::cout << std::fixed;
-            std::cout << std::endl << "=> Epoch: " << epoch << std::endl;
+            std::cout << std::endl
+                      << "=> Sample: " << sample << ", epoch "
+                      << batch.epoch + 1 << std::endl;
             std::cout << "Cost: " << cost << std::endl;
 
-            // Prediction
+            // Prediction for the first sample of the batch
             std::cout << "Predicted:\t";
-            for (size_t i = 0; i < RealLayer.N; i++) {
-                std::cout << Layer.back()(i, 0) << " ";
+            for (size_t i = 0; i < batch.target.N; i++) {
+                std::cout << prediction(i, 0) << " ";
             }
             std::cout << std::endl;
             std::cout << "Actual:\t\t";
-            for (size_t i = 0; i < RealLayer.N; i++) {
-                std::cout << RealLayer(i, 0) << " ";
+            for (size_t i = 0; i < batch.target.N; i++) {
+                std::cout << batch.target(i, 0) << " ";
             }
+            std::cout << std::endl;
         }
+        sample += batch.size;
 
-        if (do_break) {
-            auto elapsed = std::chrono::steady_clock::now() - now;
-            auto t = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
-            std::cout << std::endl << "Training complete in " << t << " ms." << std::endl;
+        if (batch.offset + batch.size < dataset.size()) {
+            continue;
+        }
+        // The batch ended an epoch
+        std::cout << std::fixed << std::setprecision(4) << std::endl
+                  << "Epoch " << batch.epoch + 1 << " of " << epochs
+                  << ": training cost "
+                  << epoch_cost / static_cast<double>(epoch_seen)
+                  << ", accuracy "
+                  << 100.0 * static_cast<double>(epoch_correct) /
+                         static_cast<double>(epoch_seen)
+                  << "%" << std::endl;
+        correct += epoch_correct;
+        seen += epoch_seen;
+        epoch_correct = 0;
+        epoch_seen = 0;
+        epoch_cost = 0.0;
+        if (validator && validate(batch.epoch)) {
             break;
-        };
+        }
+    }
+
+    auto train_time = std::chrono::steady_clock::now() - now;
+    std::cout << std::fixed << std::setprecision(2) << std::endl
+              << "Training complete in " << seconds(train_time) << " s"
+              << std::endl;
+
+    if (seen > 0) {
+        std::cout << "Training accuracy: "
+                  << 100.0 * static_cast<double>(correct) /
+                         static_cast<double>(seen)
+                  << "% of " << seen << " samples" << std::endl;
+        std::cout << "Throughput: "
+                  << static_cast<double>(seen) /
+                         seconds(train_time - validation_time)
+                  << " samples/s" << std::endl;
+    }
+    if (target_accuracy > 0.0 && !target_seconds) {
+        std::cout << "Validation accuracy never reached " << target_accuracy
+                  << "%" << std::endl;
+    }
+
+    auto heap = memory::heap_stats();
+    std::cout << "Heap allocations while training: "
+              << heap.allocations - heap_before.allocations << " ("
+              << heap.bytes - heap_before.bytes << " bytes)" << std::endl;
+
+    if (!checkpoint_path.empty() && rank == 0) {
+        save(start + seen);
+        std::cout << "Saved checkpoint to " << checkpoint_path << std::endl;
+    }
+
+    if (calibration > 0) {
+        report_quantized(net, dataset, calibration);
     }
 
     return 0;
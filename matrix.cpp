@@ -1,86 +1,281 @@
 #include "matrix.hpp"
 
+#include "gemm.hpp"
+
 namespace matrix {
 
-// Performs result = this * B
+namespace {
+
+// Checks the extra operands of the fused layer products against result and
+// builds the matching GEMM epilogue.
+gemm::Epilogue layer_epilogue(
+    ConstMatrixView bias,
+    MatrixView pre,
+    MatrixView result,
+    Activation activation
+) {
+    if (bias.N != result.N || bias.M != 1 || !bias.contiguous()) {
+        throw std::runtime_error("Bias must be a contiguous column matching the result rows");
+    }
+    if (pre.N != result.N || pre.M != result.M) {
+        throw std::runtime_error("Pre-activation matrix has incorrect dimensions");
+    }
+    return gemm::Epilogue{bias.data, pre.data, pre.ld, activation};
+}
+
+}  // namespace
+
+// Performs result = A * B
 // Result must be a valid matrix with the proper size.
-void Matrix::multiply_into(const Matrix& B, Matrix& result) {
-    // Check if multiplication is valid: this->M must equal B.N
-    if (this->M != B.N) {
+void multiply_into(ConstMatrixView A, ConstMatrixView B, MatrixView result) {
+    // Check if multiplication is valid: A.M must equal B.N
+    if (A.M != B.N) {
         throw std::runtime_error(
             "Matrix dimensions incompatible for multiplication");
     }
 
-    // Check if result matrix has correct dimensions: this->N x B.M
-    if (result.N != this->N || result.M != B.M) {
+    // Check if result matrix has correct dimensions: A.N x B.M
+    if (result.N != A.N || result.M != B.M) {
         throw std::runtime_error("Result matrix has incorrect dimensions");
     }
 
     // Perform matrix multiplication: C[i][j] = sum(A[i][k] * B[k][j])
-    for (size_t i = 0; i < this->N; ++i) {
-        for (size_t j = 0; j < B.M; ++j) {
-            float sum = 0.0f;
-            for (size_t k = 0; k < this->M; ++k) {
-                sum += this->data[i * this->M + k] * B.data[k * B.M + j];
-            }
-            result.data[i * result.M + j] = sum;
-        }
-    }
+    gemm::sgemm(
+        gemm::Transpose::No,
+        gemm::Transpose::No,
+        A.N,
+        B.M,
+        A.M,
+        A.data,
+        A.ld,
+        B.data,
+        B.ld,
+        result.data,
+        result.ld
+    );
 }
 
-void Matrix::multiply_transpose_into(const Matrix& B, Matrix& result) {
-    // For this * B^T, dimensions should be:
-    // this: N x M, B^T: M x N (B is N x M), result: N x N
-    // Check if multiplication is valid: this->M must equal B.M (since B^T has dimensions B.M x B.N)
-    if (this->M != B.M) {
+void multiply_transpose_into(
+    ConstMatrixView A, ConstMatrixView B, MatrixView result
+) {
+    // For A * B^T, dimensions should be:
+    // A: N x M, B^T: M x N (B is N x M), result: N x N
+    // Check if multiplication is valid: A.M must equal B.M (since B^T has dimensions B.M x B.N)
+    if (A.M != B.M) {
         throw std::runtime_error(
             "Matrix dimensions incompatible for transpose multiplication");
     }
 
-    // Check if result matrix has correct dimensions: this->N x B.N
-    if (result.N != this->N || result.M != B.N) {
+    // Check if result matrix has correct dimensions: A.N x B.N
+    if (result.N != A.N || result.M != B.N) {
         throw std::runtime_error("Result matrix has incorrect dimensions for transpose multiplication");
     }
 
     // Perform matrix multiplication: C[i][j] = sum(A[i][k] * B^T[k][j])
     // Since B^T[k][j] = B[j][k], we have: C[i][j] = sum(A[i][k] * B[j][k])
-    for (size_t i = 0; i < this->N; ++i) {
-        for (size_t j = 0; j < B.N; ++j) {
-            float sum = 0.0f;
-            for (size_t k = 0; k < this->M; ++k) {
-                sum += this->data[i * this->M + k] * B.data[j * B.M + k];
-            }
-            result.data[i * result.M + j] = sum;
-        }
-    }
+    gemm::sgemm(
+        gemm::Transpose::No,
+        gemm::Transpose::Yes,
+        A.N,
+        B.N,
+        A.M,
+        A.data,
+        A.ld,
+        B.data,
+        B.ld,
+        result.data,
+        result.ld
+    );
 }
 
-// Performs result=this^T * B
-void Matrix::transpose_multiply_into(const Matrix& B, Matrix& result) {
-    // For this^T * B, dimensions should be:
-    // this^T: M x N (this is N x M), B: N x M, result: M x M
-    // Check if multiplication is valid: this->N must equal B.N (since this^T has dimensions this.M x this.N)
-    if (this->N != B.N) {
+// Performs result=A^T * B
+void transpose_multiply_into(
+    ConstMatrixView A, ConstMatrixView B, MatrixView result
+) {
+    // For A^T * B, dimensions should be:
+    // A^T: M x N (A is N x M), B: N x M, result: M x M
+    // Check if multiplication is valid: A.N must equal B.N (since A^T has dimensions A.M x A.N)
+    if (A.N != B.N) {
         throw std::runtime_error(
             "Matrix dimensions incompatible for transpose multiplication");
     }
 
-    // Check if result matrix has correct dimensions: this->M x B.M
-    if (result.N != this->M || result.M != B.M) {
+    // Check if result matrix has correct dimensions: A.M x B.M
+    if (result.N != A.M || result.M != B.M) {
         throw std::runtime_error("Result matrix has incorrect dimensions for transpose multiplication");
     }
 
     // Perform matrix multiplication: C[i][j] = sum(A^T[i][k] * B[k][j])
     // Since A^T[i][k] = A[k][i], we have: C[i][j] = sum(A[k][i] * B[k][j])
-    for (size_t i = 0; i < this->M; ++i) {
-        for (size_t j = 0; j < B.M; ++j) {
-            float sum = 0.0f;
-            for (size_t k = 0; k < this->N; ++k) {
-                sum += this->data[k * this->M + i] * B.data[k * B.M + j];
-            }
-            result.data[i * result.M + j] = sum;
-        }
+    gemm::sgemm(
+        gemm::Transpose::Yes,
+        gemm::Transpose::No,
+        A.M,
+        B.M,
+        A.N,
+        A.data,
+        A.ld,
+        B.data,
+        B.ld,
+        result.data,
+        result.ld
+    );
+}
+
+void multiply_bias_activate_into(
+    ConstMatrixView A,
+    ConstMatrixView B,
+    ConstMatrixView bias,
+    MatrixView pre,
+    MatrixView result,
+    Activation activation
+) {
+    if (A.M != B.N) {
+        throw std::runtime_error(
+            "Matrix dimensions incompatible for multiplication");
+    }
+    if (result.N != A.N || result.M != B.M) {
+        throw std::runtime_error("Result matrix has incorrect dimensions");
+    }
+    gemm::sgemm(
+        gemm::Transpose::No,
+        gemm::Transpose::No,
+        A.N,
+        B.M,
+        A.M,
+        1.0f,
+        A.data,
+        A.ld,
+        B.data,
+        B.ld,
+        0.0f,
+        result.data,
+        result.ld,
+        layer_epilogue(bias, pre, result, activation)
+    );
+}
+
+void multiply_transpose_bias_activate_into(
+    ConstMatrixView A,
+    ConstMatrixView B,
+    ConstMatrixView bias,
+    MatrixView pre,
+    MatrixView result,
+    Activation activation
+) {
+    if (A.M != B.M) {
+        throw std::runtime_error(
+            "Matrix dimensions incompatible for transpose multiplication");
+    }
+    if (result.N != A.N || result.M != B.N) {
+        throw std::runtime_error("Result matrix has incorrect dimensions for transpose multiplication");
+    }
+    gemm::sgemm(
+        gemm::Transpose::No,
+        gemm::Transpose::Yes,
+        A.N,
+        B.N,
+        A.M,
+        1.0f,
+        A.data,
+        A.ld,
+        B.data,
+        B.ld,
+        0.0f,
+        result.data,
+        result.ld,
+        layer_epilogue(bias, pre, result, activation)
+    );
+}
+
+void transpose_multiply_elementwise_into(
+    ConstMatrixView A,
+    ConstMatrixView B,
+    ConstMatrixView C,
+    MatrixView result,
+    Combine combine
+) {
+    if (A.N != B.N) {
+        throw std::runtime_error(
+            "Matrix dimensions incompatible for transpose multiplication");
+    }
+    if (result.N != A.M || result.M != B.M || C.N != A.M || C.M != B.M) {
+        throw std::runtime_error("Result matrix has incorrect dimensions for transpose multiplication");
+    }
+    gemm::Epilogue epilogue{};
+    epilogue.operand = C.data;
+    epilogue.ldoperand = C.ld;
+    epilogue.combine = combine;
+    gemm::sgemm(
+        gemm::Transpose::Yes,
+        gemm::Transpose::No,
+        A.M,
+        B.M,
+        A.N,
+        1.0f,
+        A.data,
+        A.ld,
+        B.data,
+        B.ld,
+        0.0f,
+        result.data,
+        result.ld,
+        epilogue
+    );
+}
+
+void multiply_add_into(
+    ConstMatrixView A, ConstMatrixView B, float alpha, MatrixView result
+) {
+    if (A.M != B.N) {
+        throw std::runtime_error(
+            "Matrix dimensions incompatible for multiplication");
+    }
+    if (result.N != A.N || result.M != B.M) {
+        throw std::runtime_error("Result matrix has incorrect dimensions");
+    }
+    gemm::sgemm(
+        gemm::Transpose::No,
+        gemm::Transpose::No,
+        A.N,
+        B.M,
+        A.M,
+        alpha,
+        A.data,
+        A.ld,
+        B.data,
+        B.ld,
+        1.0f,
+        result.data,
+        result.ld
+    );
+}
+
+void multiply_transpose_add_into(
+    ConstMatrixView A, ConstMatrixView B, float alpha, MatrixView result
+) {
+    if (A.M != B.M) {
+        throw std::runtime_error(
+            "Matrix dimensions incompatible for transpose multiplication");
+    }
+    if (result.N != A.N || result.M != B.N) {
+        throw std::runtime_error("Result matrix has incorrect dimensions for transpose multiplication");
     }
+    gemm::sgemm(
+        gemm::Transpose::No,
+        gemm::Transpose::Yes,
+        A.N,
+        B.N,
+        A.M,
+        alpha,
+        A.data,
+        A.ld,
+        B.data,
+        B.ld,
+        1.0f,
+        result.data,
+        result.ld
+    );
 }
 
-}  // namespace matrix
\ No newline at end of file
+}  // namespace matrix
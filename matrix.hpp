@@ -1,25 +1,341 @@
 #ifndef MATRIX_HPP
 #define MATRIX_HPP
 
+#include <algorithm>
 #include <cstddef>
 #include <iostream>
-#include <vector>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "memory.hpp"
+#include "simd.hpp"
 
 namespace matrix {
 
+template <typename T>
+class BasicMatrixView;
+
+// Writable and read-only views
+using MatrixView = BasicMatrixView<float>;
+using ConstMatrixView = BasicMatrixView<const float>;
+
+// Performs result=A*B
+// Result must be a valid matrix with the proper size.
+void multiply_into(ConstMatrixView A, ConstMatrixView B, MatrixView result);
+
+// Performs result=A * B^T
+void multiply_transpose_into(
+    ConstMatrixView A, ConstMatrixView B, MatrixView result
+);
+
+// Performs result=A^T * B
+void transpose_multiply_into(
+    ConstMatrixView A, ConstMatrixView B, MatrixView result
+);
+
+// Buffer kernel applied by the fused layer products, e.g. simd::sigmoid
+using Activation = void (*)(const float* x, float* out, size_t n);
+
+// Performs pre = A*B + bias and result = activation(pre), finishing each
+// block of result while it is still in cache instead of in separate passes.
+// bias is a contiguous N x 1 column added to every column of the product.
+void multiply_bias_activate_into(
+    ConstMatrixView A,
+    ConstMatrixView B,
+    ConstMatrixView bias,
+    MatrixView pre,
+    MatrixView result,
+    Activation activation
+);
+
+// Performs pre = A * B^T + bias and result = activation(pre)
+void multiply_transpose_bias_activate_into(
+    ConstMatrixView A,
+    ConstMatrixView B,
+    ConstMatrixView bias,
+    MatrixView pre,
+    MatrixView result,
+    Activation activation
+);
+
+// Buffer kernel combining a product with another matrix elementwise, e.g.
+// simd::mul_sigmoid_derivative
+using Combine = void (*)(const float* a, const float* b, float* out, size_t n);
+
+// Performs result = combine(A^T * B, C) in one pass over result, e.g. the
+// error of a hidden layer times its activation derivative
+void transpose_multiply_elementwise_into(
+    ConstMatrixView A,
+    ConstMatrixView B,
+    ConstMatrixView C,
+    MatrixView result,
+    Combine combine
+);
+
+// Performs result += alpha * A*B
+void multiply_add_into(
+    ConstMatrixView A, ConstMatrixView B, float alpha, MatrixView result
+);
+
+// Performs result += alpha * A * B^T, e.g. an SGD step taken straight from
+// the outer products of a batch without materializing the gradient
+void multiply_transpose_add_into(
+    ConstMatrixView A, ConstMatrixView B, float alpha, MatrixView result
+);
+
+// Non-owning view of an N x M row-major block whose rows are ld elements
+// apart. It can point into a Matrix, a slice of a larger buffer or a mapped
+// file, and Matrix converts to it implicitly. T is float or const float.
+template <typename T>
+class BasicMatrixView {
+  public:
+    T* data;
+    size_t N;
+    size_t M;
+    size_t ld;
+
+    BasicMatrixView(T* data, size_t n, size_t m)
+        : BasicMatrixView(data, n, m, m) {}
+
+    BasicMatrixView(T* data, size_t n, size_t m, size_t ld)
+        : data(data), N(n), M(m), ld(ld) {
+        if (ld < m) {
+            throw std::invalid_argument("Row stride must cover every column");
+        }
+    }
+
+    // Writable views convert to read-only ones
+    template <typename U>
+        requires std::is_same_v<const U, T> && (!std::is_same_v<U, T>)
+    BasicMatrixView(const BasicMatrixView<U>& other)
+        : data(other.data), N(other.N), M(other.M), ld(other.ld) {}
+
+    // Index a value
+    T& operator()(size_t i, size_t j) const {
+        if (i >= N || j >= M) {
+            throw std::out_of_range("Index out of bounds");
+        }
+        return data[i * ld + j];
+    }
+
+    T* row(size_t i) const { return data + i * ld; }
+
+    // Whether the rows follow each other without gaps
+    bool contiguous() const { return ld == M || N <= 1; }
+
+    // View of the n x m block starting at (i, j)
+    BasicMatrixView block(size_t i, size_t j, size_t n, size_t m) const {
+        if (i + n > N || j + m > M) {
+            throw std::out_of_range("Block out of bounds");
+        }
+        return BasicMatrixView(data + i * ld + j, n, m, ld);
+    }
+
+    // View of rows [first, first + n)
+    BasicMatrixView rows(size_t first, size_t n) const {
+        return block(first, 0, n, M);
+    }
+
+    // Performs result=this*B
+    void multiply_into(ConstMatrixView B, MatrixView result) const {
+        matrix::multiply_into(*this, B, result);
+    }
+
+    // Performs result=this * B^T
+    void multiply_transpose_into(ConstMatrixView B, MatrixView result) const {
+        matrix::multiply_transpose_into(*this, B, result);
+    }
+
+    // Performs result=this^T * B
+    void transpose_multiply_into(ConstMatrixView B, MatrixView result) const {
+        matrix::transpose_multiply_into(*this, B, result);
+    }
+
+    // Performs pre = this*B + bias and result = activation(pre)
+    void multiply_bias_activate_into(
+        ConstMatrixView B,
+        ConstMatrixView bias,
+        MatrixView pre,
+        MatrixView result,
+        Activation activation
+    ) const {
+        matrix::multiply_bias_activate_into(
+            *this, B, bias, pre, result, activation
+        );
+    }
+
+    // Performs pre = this * B^T + bias and result = activation(pre)
+    void multiply_transpose_bias_activate_into(
+        ConstMatrixView B,
+        ConstMatrixView bias,
+        MatrixView pre,
+        MatrixView result,
+        Activation activation
+    ) const {
+        matrix::multiply_transpose_bias_activate_into(
+            *this, B, bias, pre, result, activation
+        );
+    }
+
+    // Performs result = combine(this^T * B, C)
+    void transpose_multiply_elementwise_into(
+        ConstMatrixView B, ConstMatrixView C, MatrixView result, Combine combine
+    ) const {
+        matrix::transpose_multiply_elementwise_into(
+            *this, B, C, result, combine
+        );
+    }
+
+    // Performs result += alpha * this*B
+    void multiply_add_into(
+        ConstMatrixView B, float alpha, MatrixView result
+    ) const {
+        matrix::multiply_add_into(*this, B, alpha, result);
+    }
+
+    // Performs result += alpha * this * B^T
+    void multiply_transpose_add_into(
+        ConstMatrixView B, float alpha, MatrixView result
+    ) const {
+        matrix::multiply_transpose_add_into(*this, B, alpha, result);
+    }
+
+    // Applies func to every element. Function objects that can also be called
+    // on whole buffers (see simd.hpp) run their vectorized kernel instead,
+    // once for contiguous views and once per row otherwise.
+    template <typename Func>
+    void apply(Func func) const {
+        if constexpr (std::is_invocable_v<Func&, const float*, float*, size_t>) {
+            if (contiguous()) {
+                func(data, data, N * M);
+                return;
+            }
+            for (size_t i = 0; i < N; ++i) {
+                func(row(i), row(i), M);
+            }
+        } else {
+            for (size_t i = 0; i < N; ++i) {
+                T* r = row(i);
+                for (size_t j = 0; j < M; ++j) {
+                    r[j] = func(r[j]);
+                }
+            }
+        }
+    }
+
+    // Element-wise sum all elements of B into this
+    void sum_into(ConstMatrixView B) const {
+        if (N != B.N || M != B.M) {
+            throw std::invalid_argument("Matrix dimensions must match for sum");
+        }
+        elementwise_into(B, *this, simd::Add{});
+    }
+
+    // Performs C = func(this, B) element-wise. Like apply, vectorized
+    // function objects run over whole buffers or rows.
+    template <typename Func>
+    void elementwise_into(ConstMatrixView B, MatrixView C, Func func) const {
+        if (N != B.N || M != B.M || N != C.N || M != C.M) {
+            throw std::invalid_argument("Matrix dimensions must match for elementwise operation");
+        }
+        if constexpr (std::is_invocable_v<
+                          Func&,
+                          const float*,
+                          const float*,
+                          float*,
+                          size_t>) {
+            if (contiguous() && B.contiguous() && C.contiguous()) {
+                func(data, B.data, C.data, N * M);
+                return;
+            }
+            for (size_t i = 0; i < N; ++i) {
+                func(row(i), B.row(i), C.row(i), M);
+            }
+        } else {
+            for (size_t i = 0; i < N; ++i) {
+                const float* a = row(i);
+                const float* b = B.row(i);
+                float* c = C.row(i);
+                for (size_t j = 0; j < M; ++j) {
+                    c[j] = func(a[j], b[j]);
+                }
+            }
+        }
+    }
+
+    // Adds the column vector B (N x 1) to every column of this, e.g. a bias
+    // onto a batch of activations
+    void broadcast_sum_into(ConstMatrixView B) const {
+        if (N != B.N || B.M != 1) {
+            throw std::invalid_argument("Matrix dimensions must match for broadcast sum");
+        }
+        for (size_t i = 0; i < N; ++i) {
+            float b = *B.row(i);
+            T* r = row(i);
+            for (size_t j = 0; j < M; ++j) {
+                r[j] += b;
+            }
+        }
+    }
+
+    // Sums every row of this into the column vector result (N x 1), e.g. the
+    // bias gradient of a batch
+    void row_sum_into(MatrixView result) const {
+        if (N != result.N || result.M != 1) {
+            throw std::invalid_argument("Result matrix must be a column with matching rows");
+        }
+        for (size_t i = 0; i < N; ++i) {
+            const T* r = row(i);
+            float sum = 0.0f;
+            for (size_t j = 0; j < M; ++j) {
+                sum += r[j];
+            }
+            *result.row(i) = sum;
+        }
+    }
+};
+
+// Owning N x M row-major matrix. Storage is aligned to memory::ALIGNMENT
+// and comes either from the heap, counted in memory::heap_stats(), or from
+// a memory::Arena, in which case the matrix must not be used after the
+// arena is reset.
 class Matrix {
   private:
-    std::vector<float> data;
+    memory::Buffer owned;
+    float* data = nullptr;
+    memory::Arena* arena = nullptr;
+
+    struct Uninitialized {};
+
+    // Storage for n * m values, from source if not null
+    Matrix(size_t n, size_t m, memory::Arena* source, Uninitialized)
+        : owned(source == nullptr ? memory::make_buffer(n * m) : nullptr),
+          data(source == nullptr ? owned.get() : source->allocate(n * m)),
+          arena(source),
+          N(n),
+          M(m) {}
 
   public:
     size_t N;
     size_t M;
-    Matrix(size_t n, size_t m, float seed) : data(n * m, seed), N(n), M(m) {};
+    Matrix(size_t n, size_t m, float seed)
+        : Matrix(n, m, nullptr, Uninitialized{}) {
+        std::fill(data, data + n * m, seed);
+    };
     Matrix(size_t n, size_t m) : Matrix(n, m, 0.0f) {};
 
+    // Zeroed matrix drawn from arena
+    Matrix(size_t n, size_t m, memory::Arena& arena, float seed = 0.0f)
+        : Matrix(n, m, &arena, Uninitialized{}) {
+        std::fill(data, data + n * m, seed);
+    }
+
     // Template constructor for function objects (lambdas with captures)
     template <typename Func>
-    Matrix(size_t n, size_t m, Func func) : data(n * m), N(n), M(m) {
+    Matrix(size_t n, size_t m, Func func)
+        : Matrix(n, m, nullptr, Uninitialized{}) {
         for (size_t i = 0; i < n; ++i) {
             for (size_t j = 0; j < m; ++j) {
                 data[i * m + j] = func(i, j);
@@ -27,6 +343,35 @@ class Matrix {
         }
     }
 
+    // Copies land on the heap, even when other lives in an arena
+    Matrix(const Matrix& other)
+        : Matrix(other.N, other.M, nullptr, Uninitialized{}) {
+        std::copy(other.data, other.data + N * M, data);
+    }
+
+    Matrix& operator=(const Matrix& other) {
+        if (this != &other) {
+            *this = Matrix(other);
+        }
+        return *this;
+    }
+
+    Matrix(Matrix&& other) noexcept
+        : owned(std::move(other.owned)),
+          data(std::exchange(other.data, nullptr)),
+          arena(std::exchange(other.arena, nullptr)),
+          N(std::exchange(other.N, 0)),
+          M(std::exchange(other.M, 0)) {}
+
+    Matrix& operator=(Matrix&& other) noexcept {
+        owned = std::move(other.owned);
+        data = std::exchange(other.data, nullptr);
+        arena = std::exchange(other.arena, nullptr);
+        N = std::exchange(other.N, 0);
+        M = std::exchange(other.M, 0);
+        return *this;
+    }
+
     void print() {
         std::cout << "Matrix " << this->N << "x" << this->M << ": "
                   << std::endl;
@@ -57,15 +402,76 @@ class Matrix {
         }
     }
 
+    // Views of the whole matrix; Matrix converts to them implicitly, so
+    // every operation taking a view also accepts a Matrix.
+    MatrixView view() { return MatrixView(data, N, M); }
+    ConstMatrixView view() const { return ConstMatrixView(data, N, M); }
+    operator MatrixView() { return view(); }
+    operator ConstMatrixView() const { return view(); }
+
     // Performs result=this*B
     // Result must be a valid matrix with the proper size.
-    void multiply_into(const Matrix& B, Matrix& result);
+    void multiply_into(ConstMatrixView B, MatrixView result) const {
+        matrix::multiply_into(view(), B, result);
+    }
 
     // Permorms result=this * B^T
-    void multiply_transpose_into(const Matrix& B, Matrix& result);
+    void multiply_transpose_into(ConstMatrixView B, MatrixView result) const {
+        matrix::multiply_transpose_into(view(), B, result);
+    }
 
     // Performs result=this^T * B
-    void transpose_multiply_into(const Matrix& B, Matrix& result);
+    void transpose_multiply_into(ConstMatrixView B, MatrixView result) const {
+        matrix::transpose_multiply_into(view(), B, result);
+    }
+
+    // Performs pre = this*B + bias and result = activation(pre) in one pass,
+    // e.g. a whole forward layer
+    void multiply_bias_activate_into(
+        ConstMatrixView B,
+        ConstMatrixView bias,
+        MatrixView pre,
+        MatrixView result,
+        Activation activation
+    ) const {
+        view().multiply_bias_activate_into(B, bias, pre, result, activation);
+    }
+
+    // Performs pre = this * B^T + bias and result = activation(pre)
+    void multiply_transpose_bias_activate_into(
+        ConstMatrixView B,
+        ConstMatrixView bias,
+        MatrixView pre,
+        MatrixView result,
+        Activation activation
+    ) const {
+        view().multiply_transpose_bias_activate_into(
+            B, bias, pre, result, activation
+        );
+    }
+
+    // Performs result = combine(this^T * B, C) in one pass, e.g. a hidden
+    // layer's error times its activation derivative
+    void transpose_multiply_elementwise_into(
+        ConstMatrixView B, ConstMatrixView C, MatrixView result, Combine combine
+    ) const {
+        view().transpose_multiply_elementwise_into(B, C, result, combine);
+    }
+
+    // Performs result += alpha * this*B
+    void multiply_add_into(
+        ConstMatrixView B, float alpha, MatrixView result
+    ) const {
+        view().multiply_add_into(B, alpha, result);
+    }
+
+    // Performs result += alpha * this * B^T, e.g. an SGD step from the outer
+    // products of a batch
+    void multiply_transpose_add_into(
+        ConstMatrixView B, float alpha, MatrixView result
+    ) const {
+        view().multiply_transpose_add_into(B, alpha, result);
+    }
 
     // Index a value
     float& operator()(size_t i, size_t j) {
@@ -75,65 +481,83 @@ class Matrix {
         return data[i * M + j];
     }
 
+    // Applies func to every element. Function objects that can also be called
+    // on whole buffers (see simd.hpp) run their vectorized kernel instead.
     template <typename Func>
     void apply(Func func) {
-        for (auto& value : data) {
-            value = func(value);
-        }
+        view().apply(func);
     }
 
     // Element-wise sum all elements of B into this
-    void sum_into(Matrix& B) {
-        if (N != B.N || M != B.M) {
-            throw std::invalid_argument("Matrix dimensions must match for sum");
-        }
-        for (size_t i = 0; i < N * M; ++i) {
-            data[i] += B.data[i];
+    void sum_into(ConstMatrixView B) { view().sum_into(B); }
+
+    // Adds the column vector B (N x 1) to every column of this, e.g. a bias
+    // onto a batch of activations
+    void broadcast_sum_into(ConstMatrixView B) { view().broadcast_sum_into(B); }
+
+    // Sums every row of this into the column vector result (N x 1), e.g. the
+    // bias gradient of a batch
+    void row_sum_into(MatrixView result) const { view().row_sum_into(result); }
+
+    // Copies the column vector src (N x 1) into column j of this
+    void set_column(size_t j, const Matrix& src) {
+        if (src.M != 1) {
+            throw std::invalid_argument("Source must be a column with matching rows");
         }
+        set_column(j, std::span<const float>(src.data, src.N));
     }
 
-    template <typename Func>
-    void elementwise_into(Matrix& B, Matrix& C, Func func) {
-        if (N != B.N || M != B.M || N != C.N || M != C.M) {
-            throw std::invalid_argument("Matrix dimensions must match for elementwise operation");
+    // Copies N values from src into column j of this
+    void set_column(size_t j, std::span<const float> src) {
+        if (N != src.size() || j >= M) {
+            throw std::invalid_argument("Source must be a column with matching rows");
         }
-        for (size_t i = 0; i < N * M; ++i) {
-            C.data[i] = func(data[i], B.data[i]);
+        for (size_t i = 0; i < N; ++i) {
+            data[i * M + j] = src[i];
         }
     }
 
+    // Performs C = func(this, B) element-wise. Like apply, vectorized
+    // function objects run over whole buffers.
+    template <typename Func>
+    void elementwise_into(ConstMatrixView B, MatrixView C, Func func) {
+        view().elementwise_into(B, C, func);
+    }
+
+    // Copy drawn from the same arena as this, or the heap
     Matrix cloned() {
-        Matrix res(this->N, this->M);
-        std::vector<float> new_data(this->data);  // Clone
-        res.data = std::move(new_data);
+        Matrix res(N, M, arena, Uninitialized{});
+        std::copy(data, data + N * M, res.data);
         return res;
     }
 
+    // Matrix of the same shape and storage filled with seed
     Matrix clone_seeded(float seed) {
-        Matrix res(this->N, this->M, seed);
+        Matrix res(N, M, arena, Uninitialized{});
+        std::fill(res.data, res.data + N * M, seed);
         return res;
     }
 
+    // Copies the values into dest without reallocating it
     void clone_into(Matrix& dest) {
         if (N != dest.N || M != dest.M) {
             throw std::invalid_argument("Destination matrix dimensions must match");
         }
-        dest.data = data;  // Copy data
+        std::copy(data, data + N * M, dest.data);
     }
 
-    void operator-=(Matrix& B) {
+    // Arena the storage comes from, or nullptr for the heap
+    memory::Arena* source() const { return arena; }
+
+    void operator-=(ConstMatrixView B) {
         if (N != B.N || M != B.M) {
             throw std::invalid_argument("Matrix dimensions must match for subtraction");
         }
-        for (size_t i = 0; i < N * M; ++i) {
-            data[i] -= B.data[i];
-        }
+        view().elementwise_into(B, view(), simd::Sub{});
     }
 
     void operator*(float x) {
-        for (auto& value : data) {
-            value *= x;
-        }
+        simd::scale(data, x, data, N * M);
     }
 };
 
@@ -0,0 +1,124 @@
+#include "memory.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+namespace memory {
+
+namespace {
+
+struct Counters {
+    std::atomic<size_t> allocations{0};
+    std::atomic<size_t> deallocations{0};
+    std::atomic<size_t> bytes{0};
+    std::atomic<size_t> live_bytes{0};
+    std::atomic<size_t> peak_bytes{0};
+};
+
+Counters& counters() {
+    static Counters c;
+    return c;
+}
+
+// Each buffer is preceded by one cache line holding its size, so that
+// deallocate can keep live_bytes without the caller passing it in.
+constexpr size_t HEADER = ALIGNMENT;
+
+size_t round_up(size_t n) { return (n + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT; }
+
+}  // namespace
+
+float* allocate(size_t n) {
+    size_t bytes = round_up(n * sizeof(float));
+    auto* base = static_cast<std::byte*>(
+        ::operator new(HEADER + bytes, std::align_val_t{ALIGNMENT})
+    );
+    *reinterpret_cast<size_t*>(base) = bytes;
+
+    auto& c = counters();
+    c.allocations.fetch_add(1, std::memory_order_relaxed);
+    c.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    size_t live = c.live_bytes.fetch_add(bytes, std::memory_order_relaxed) +
+                  bytes;
+    size_t peak = c.peak_bytes.load(std::memory_order_relaxed);
+    while (live > peak &&
+           !c.peak_bytes.compare_exchange_weak(
+               peak, live, std::memory_order_relaxed
+           )) {
+    }
+    return reinterpret_cast<float*>(base + HEADER);
+}
+
+void deallocate(float* p) {
+    if (p == nullptr) {
+        return;
+    }
+    auto* base = reinterpret_cast<std::byte*>(p) - HEADER;
+    size_t bytes = *reinterpret_cast<size_t*>(base);
+    auto& c = counters();
+    c.deallocations.fetch_add(1, std::memory_order_relaxed);
+    c.live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    ::operator delete(base, std::align_val_t{ALIGNMENT});
+}
+
+Stats heap_stats() {
+    auto& c = counters();
+    Stats s;
+    s.allocations = c.allocations.load(std::memory_order_relaxed);
+    s.deallocations = c.deallocations.load(std::memory_order_relaxed);
+    s.bytes = c.bytes.load(std::memory_order_relaxed);
+    s.live_bytes = c.live_bytes.load(std::memory_order_relaxed);
+    s.peak_bytes = c.peak_bytes.load(std::memory_order_relaxed);
+    return s;
+}
+
+Arena::Arena(size_t capacity) {
+    if (capacity > 0) {
+        add_chunk(capacity);
+    }
+}
+
+void Arena::add_chunk(size_t bytes) {
+    bytes = round_up(bytes);
+    chunks.push_back(Chunk{make_buffer(bytes / sizeof(float)), bytes});
+    offset = 0;
+    counters.capacity_bytes += bytes;
+    counters.chunk_allocations++;
+}
+
+float* Arena::allocate(size_t n) {
+    size_t bytes = round_up(n * sizeof(float));
+    if (chunks.empty() || offset + bytes > chunks.back().size) {
+        // Grow geometrically so that a step outgrowing the arena adds few
+        // chunks
+        size_t size = chunks.empty() ? 0 : chunks.back().size;
+        add_chunk(std::max(bytes, 2 * size));
+    }
+    auto* base = reinterpret_cast<std::byte*>(chunks.back().data.get());
+    float* block = reinterpret_cast<float*>(base + offset);
+    offset += bytes;
+
+    counters.allocations++;
+    counters.total_allocations++;
+    counters.used_bytes += bytes;
+    counters.peak_bytes = std::max(counters.peak_bytes, counters.used_bytes);
+    return block;
+}
+
+void Arena::reset() {
+    if (chunks.size() > 1) {
+        // Replace the chunks by one that holds everything the last round
+        // needed
+        size_t total = counters.capacity_bytes;
+        chunks.clear();
+        counters.capacity_bytes = 0;
+        add_chunk(total);
+    }
+    offset = 0;
+    counters.allocations = 0;
+    counters.used_bytes = 0;
+    counters.resets++;
+}
+
+}  // namespace memory
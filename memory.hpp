@@ -0,0 +1,90 @@
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace memory {
+
+// Alignment of every buffer handed out here: one cache line, which also
+// suits aligned loads of the widest (AVX-512) registers.
+constexpr size_t ALIGNMENT = 64;
+
+// Counters of allocations made through this module
+struct Stats {
+    size_t allocations = 0;
+    size_t deallocations = 0;
+    size_t bytes = 0;
+    size_t live_bytes = 0;
+    size_t peak_bytes = 0;
+};
+
+// Heap buffers of n floats aligned to ALIGNMENT. Every call is counted in
+// heap_stats(), so a training loop can check that it makes none.
+float* allocate(size_t n);
+void deallocate(float* p);
+
+struct AlignedDelete {
+    void operator()(float* p) const { deallocate(p); }
+};
+
+using Buffer = std::unique_ptr<float[], AlignedDelete>;
+
+inline Buffer make_buffer(size_t n) { return Buffer(allocate(n)); }
+
+// Process-wide counters of allocate and deallocate. Thread safe.
+Stats heap_stats();
+
+// Bump allocator for short-lived matrices, e.g. the scratch of one training
+// step. Blocks are carved out of large chunks and never freed one by one;
+// reset() releases all of them at once. When a step outgrows the chunk, more
+// chunks are added, and the next reset merges them into one chunk big enough
+// for the whole step, so a repeating workload stops touching the heap after
+// its first round. Not thread safe.
+class Arena {
+  public:
+    // Chunk size in bytes to start with; 0 defers the first chunk to the
+    // first allocation.
+    explicit Arena(size_t capacity = 0);
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // n floats aligned to ALIGNMENT, valid until the next reset
+    float* allocate(size_t n);
+
+    // Invalidates every block handed out so far
+    void reset();
+
+    struct Stats {
+        // Blocks handed out since the last reset and in total
+        size_t allocations = 0;
+        size_t total_allocations = 0;
+        // Bytes in use since the last reset, and the most ever in use
+        size_t used_bytes = 0;
+        size_t peak_bytes = 0;
+        // Bytes reserved in chunks, and chunks taken from the heap
+        size_t capacity_bytes = 0;
+        size_t chunk_allocations = 0;
+        size_t resets = 0;
+    };
+
+    const Stats& stats() const { return counters; }
+
+  private:
+    struct Chunk {
+        Buffer data;
+        size_t size;
+    };
+
+    void add_chunk(size_t bytes);
+
+    std::vector<Chunk> chunks;
+    size_t offset = 0;
+    Stats counters;
+};
+
+}  // namespace memory
+
+#endif  // MEMORY_HPP
@@ -1,91 +1,240 @@
 #include "mnist.hpp"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
-#include <fstream>
 #include <stdexcept>
 
 #include "matrix.hpp"
+#include "memory.hpp"
+#include "parallel.hpp"
 
 namespace mnist {
 
+namespace {
+
 // Helper function to read big-endian 32-bit integer
-uint32_t read_uint32_be(std::ifstream& file) {
-    uint32_t value;
-    file.read(reinterpret_cast<char*>(&value), sizeof(value));
-    // Convert from big-endian to host byte order
-    return ((value & 0xFF000000) >> 24) | ((value & 0x00FF0000) >> 8) |
-           ((value & 0x0000FF00) << 8) | ((value & 0x000000FF) << 24);
+uint32_t read_uint32_be(const uint8_t* bytes) {
+    return (static_cast<uint32_t>(bytes[0]) << 24) |
+           (static_cast<uint32_t>(bytes[1]) << 16) |
+           (static_cast<uint32_t>(bytes[2]) << 8) |
+           static_cast<uint32_t>(bytes[3]);
 }
 
-// Function to load MNIST training dataset
-std::pair<std::vector<matrix::Matrix>, std::vector<uint8_t>> load_mnist(
-    const std::string& images_path, const std::string& labels_path
-) {
-    std::vector<matrix::Matrix> images;
-    std::vector<uint8_t> labels;
+// count, once images [first, first + count) are known to be in source
+size_t checked_range(const MappedDataset& source, size_t first, size_t count) {
+    if (first > source.size() || count > source.size() - first) {
+        throw std::out_of_range("Image range out of bounds");
+    }
+    return count;
+}
+
+}  // namespace
+
+IdxFile::IdxFile(const std::string& path, uint8_t expected_dims) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot stat file: " + path);
+    }
+    mapping_size = static_cast<size_t>(info.st_size);
+    if (mapping_size > 0) {
+        mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (mapping_size == 0 || mapping == MAP_FAILED) {
+        mapping = nullptr;
+        throw std::runtime_error("Cannot map file: " + path);
+    }
 
-    // Open images file
-    std::ifstream images_file(images_path, std::ios::binary);
-    if (!images_file.is_open()) {
-        throw std::runtime_error("Cannot open images file: " + images_path);
+    // Magic number: two zero bytes, the element type and the number of
+    // dimensions, followed by one big-endian uint32 per dimension
+    const uint8_t* bytes = static_cast<const uint8_t*>(mapping);
+    size_t header = 4 + 4 * static_cast<size_t>(expected_dims);
+    if (mapping_size < header || bytes[0] != 0 || bytes[1] != 0 ||
+        bytes[2] != 0x08 || bytes[3] != expected_dims) {
+        munmap(mapping, mapping_size);
+        mapping = nullptr;
+        throw std::runtime_error("Invalid magic number in file: " + path);
     }
 
-    // Read images header
-    uint32_t images_magic = read_uint32_be(images_file);
-    if (images_magic != 2051) {
-        throw std::runtime_error("Invalid magic number in images file");
+    // The product of the dimensions is checked against the payload before
+    // every multiply, so that a crafted header cannot wrap it around to the
+    // file size
+    size_t available = mapping_size - header;
+    size_t elements = 1;
+    bool fits = true;
+    for (uint8_t d = 0; d < expected_dims; ++d) {
+        dimensions.push_back(read_uint32_be(bytes + 4 + 4 * d));
+        size_t dimension = dimensions.back();
+        if (dimension != 0 && elements > available / dimension) {
+            fits = false;
+            break;
+        }
+        elements *= dimension;
+    }
+    if (!fits || elements != available) {
+        munmap(mapping, mapping_size);
+        mapping = nullptr;
+        throw std::runtime_error("File size does not match header: " + path);
     }
+    payload = bytes + header;
 
-    uint32_t num_images = read_uint32_be(images_file);
-    uint32_t rows = read_uint32_be(images_file);
-    uint32_t cols = read_uint32_be(images_file);
+    // Samples are read front to back
+    madvise(mapping, mapping_size, MADV_SEQUENTIAL);
+}
 
-    // Open labels file
-    std::ifstream labels_file(labels_path, std::ios::binary);
-    if (!labels_file.is_open()) {
-        throw std::runtime_error("Cannot open labels file: " + labels_path);
+IdxFile::~IdxFile() {
+    if (mapping != nullptr) {
+        munmap(mapping, mapping_size);
     }
+}
+
+IdxFile::IdxFile(IdxFile&& other) noexcept
+    : mapping(other.mapping),
+      mapping_size(other.mapping_size),
+      payload(other.payload),
+      dimensions(std::move(other.dimensions)) {
+    other.mapping = nullptr;
+    other.mapping_size = 0;
+    other.payload = nullptr;
+}
 
-    // Read labels header
-    uint32_t labels_magic = read_uint32_be(labels_file);
-    if (labels_magic != 2049) {
-        throw std::runtime_error("Invalid magic number in labels file");
+IdxFile& IdxFile::operator=(IdxFile&& other) noexcept {
+    if (this != &other) {
+        if (mapping != nullptr) {
+            munmap(mapping, mapping_size);
+        }
+        mapping = other.mapping;
+        mapping_size = other.mapping_size;
+        payload = other.payload;
+        dimensions = std::move(other.dimensions);
+        other.mapping = nullptr;
+        other.mapping_size = 0;
+        other.payload = nullptr;
     }
+    return *this;
+}
 
-    uint32_t num_labels = read_uint32_be(labels_file);
-    if (num_images != num_labels) {
+MappedDataset::MappedDataset(
+    const std::string& images_path, const std::string& labels_path
+)
+    : images_file(images_path, 3), labels_file(labels_path, 1) {
+    count = images_file.dims()[0];
+    image_rows = images_file.dims()[1];
+    image_cols = images_file.dims()[2];
+    if (count != labels_file.dims()[0]) {
         throw std::runtime_error("Number of images and labels don't match");
     }
+    if (std::any_of(labels(), labels() + count, [](uint8_t label) {
+            return label >= CLASSES;
+        })) {
+        throw std::runtime_error("Label out of range in file: " + labels_path);
+    }
+}
 
-    // Reserve space for efficiency
-    images.reserve(num_images);
-    labels.reserve(num_images);
+void MappedDataset::image_into(size_t i, matrix::Matrix& dest, size_t j)
+    const {
+    if (i >= count) {
+        throw std::out_of_range("Image index out of bounds");
+    }
+    if (dest.N != pixels()) {
+        throw std::invalid_argument("Destination must have one row per pixel");
+    }
+    const uint8_t* src = image(i);
+    for (size_t p = 0; p < pixels(); ++p) {
+        dest(p, j) = static_cast<float>(src[p]) / 255.0f;
+    }
+}
 
-    // Read image and label data
-    // for (uint32_t i = 0; i < num_images; ++i) {
-    for (size_t i = 0; i < num_images; i++) {
-        matrix::Matrix image(rows * cols, 1);
+void MappedDataset::normalize_into(size_t first, size_t n, float* out) const {
+    if (first + n > count) {
+        throw std::out_of_range("Image range out of bounds");
+    }
+    const uint8_t* src = image(first);
+    size_t total = n * pixels();
+    for (size_t p = 0; p < total; ++p) {
+        out[p] = static_cast<float>(src[p]) / 255.0f;
+    }
+}
 
-        // Read pixel data
-        for (size_t row = 0; row < rows; ++row) {
-            for (size_t col = 0; col < cols; ++col) {
-                uint8_t pixel;
-                images_file.read(reinterpret_cast<char*>(&pixel), 1);
-                // Normalize pixel value to [0,1] range
-                image(row * cols + col, 0) = static_cast<float>(pixel) / 255.0f;
-            }
-        }
+Dataset::Dataset(const MappedDataset& source)
+    : Dataset(source, 0, source.size()) {}
+
+Dataset::Dataset(const MappedDataset& source, size_t first, size_t count)
+    : values(memory::make_buffer(
+          checked_range(source, first, count) * source.pixels()
+      )),
+      labels_data(
+          source.labels() + first, source.labels() + first + count
+      ),
+      image_rows(source.rows()),
+      image_cols(source.cols()) {
+    // Normalize in chunks of images spread over the thread pool
+    constexpr size_t CHUNK = 1024;
+    size_t chunks = (count + CHUNK - 1) / CHUNK;
+    float* out = values.get();
+    parallel::parallel_for(chunks, [&](size_t c) {
+        size_t begin = c * CHUNK;
+        size_t n = std::min(CHUNK, count - begin);
+        source.normalize_into(first + begin, n, out + begin * pixels());
+    });
+}
 
-        // Read label
-        uint8_t label;
-        labels_file.read(reinterpret_cast<char*>(&label), 1);
+matrix::ConstMatrixView Dataset::batch(size_t first, size_t n) const {
+    if (first + n > size()) {
+        throw std::out_of_range("Sample range out of bounds");
+    }
+    return {values.get() + first * pixels(), n, pixels()};
+}
 
-        images.push_back(std::move(image));
-        labels.push_back(label);
+std::span<const uint8_t> Dataset::labels(size_t first, size_t n) const {
+    if (first + n > size()) {
+        throw std::out_of_range("Sample range out of bounds");
     }
+    return {labels_data.data() + first, n};
+}
 
-    return std::make_pair(std::move(images), std::move(labels));
+// Function to load MNIST training dataset
+Dataset load_mnist(
+    const std::string& images_path, const std::string& labels_path
+) {
+    return Dataset(MappedDataset(images_path, labels_path));
+}
+
+Dataset load_mnist_shard(
+    const std::string& images_path,
+    const std::string& labels_path,
+    size_t shard,
+    size_t shards
+) {
+    MappedDataset source(images_path, labels_path);
+    return load_shard(source, source.size(), shard, shards);
+}
+
+Dataset load_shard(
+    const MappedDataset& source, size_t count, size_t shard, size_t shards
+) {
+    if (shard >= shards) {
+        throw std::invalid_argument("Shard index must be below the shard count");
+    }
+    if (count > source.size()) {
+        throw std::out_of_range("Sharded samples exceed the dataset");
+    }
+    size_t per_shard = count / shards;
+    if (per_shard == 0) {
+        throw std::invalid_argument("Dataset has fewer samples than shards");
+    }
+    return Dataset(source, shard * per_shard, per_shard);
 }
 
 }  // namespace mnist
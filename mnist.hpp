@@ -1,16 +1,145 @@
+#ifndef MNIST_HPP
+#define MNIST_HPP
+
+#include <cstddef>
 #include <cstdint>
+#include <span>
 #include <string>
-#include <utility>
 #include <vector>
 
 #include "matrix.hpp"
+#include "memory.hpp"
 
 namespace mnist {
 
+// Read-only memory mapping of an IDX file, the container format of MNIST.
+// The header is validated once on construction; the payload is exposed in
+// place without copying.
+class IdxFile {
+  public:
+    // Maps path and checks that it holds unsigned bytes with the expected
+    // number of dimensions and exactly the payload size the header declares.
+    IdxFile(const std::string& path, uint8_t expected_dims);
+    ~IdxFile();
+
+    IdxFile(IdxFile&& other) noexcept;
+    IdxFile& operator=(IdxFile&& other) noexcept;
+    IdxFile(const IdxFile&) = delete;
+    IdxFile& operator=(const IdxFile&) = delete;
+
+    // Size of each dimension, outermost first
+    const std::vector<uint32_t>& dims() const { return dimensions; }
+
+    // Payload following the header
+    const uint8_t* data() const { return payload; }
+
+  private:
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+    const uint8_t* payload = nullptr;
+    std::vector<uint32_t> dimensions;
+};
+
+// Labels are the digits 0 to 9
+constexpr size_t CLASSES = 10;
+
+// MNIST images and labels mapped straight from disk. Pixels stay raw uint8
+// until a sample is requested, so opening the dataset only parses the
+// headers and checks that every label is below CLASSES.
+class MappedDataset {
+  public:
+    MappedDataset(const std::string& images_path, const std::string& labels_path);
+
+    size_t size() const { return count; }
+    size_t rows() const { return image_rows; }
+    size_t cols() const { return image_cols; }
+    size_t pixels() const { return image_rows * image_cols; }
+
+    // Raw pixels of every image, row-major, one image after the other
+    const uint8_t* images() const { return images_file.data(); }
+    const uint8_t* image(size_t i) const { return images() + i * pixels(); }
+
+    const uint8_t* labels() const { return labels_file.data(); }
+    uint8_t label(size_t i) const { return labels()[i]; }
+
+    // Writes image i normalized to [0, 1] into column j of dest, which must
+    // have pixels() rows.
+    void image_into(size_t i, matrix::Matrix& dest, size_t j = 0) const;
+
+    // Writes images [first, first + n) normalized to [0, 1] into out, one
+    // image per row of pixels() floats.
+    void normalize_into(size_t first, size_t n, float* out) const;
+
+  private:
+    IdxFile images_file;
+    IdxFile labels_file;
+    size_t count;
+    size_t image_rows;
+    size_t image_cols;
+};
+
+// Every sample of a dataset normalized to [0, 1] in one contiguous float
+// buffer aligned to memory::ALIGNMENT, one row of pixels() floats per sample.
+// Samples and batches are handed out as views into the buffer, so fetching
+// them neither allocates nor copies.
+class Dataset {
+  public:
+    // Normalizes every image of source in one pass.
+    explicit Dataset(const MappedDataset& source);
+
+    // Normalizes images [first, first + count) of source only. Throws
+    // std::out_of_range if they are not all in source.
+    Dataset(const MappedDataset& source, size_t first, size_t count);
+
+    size_t size() const { return labels_data.size(); }
+    size_t rows() const { return image_rows; }
+    size_t cols() const { return image_cols; }
+    size_t pixels() const { return image_rows * image_cols; }
+
+    // Pixels of sample i
+    std::span<const float> sample(size_t i) const {
+        return {batch(i, 1).data, pixels()};
+    }
+
+    // Samples [first, first + n) as an n x pixels() matrix, one per row
+    matrix::ConstMatrixView batch(size_t first, size_t n) const;
+
+    uint8_t label(size_t i) const { return labels_data[i]; }
+    std::span<const uint8_t> labels(size_t first, size_t n) const;
+
+    const float* data() const { return values.get(); }
+
+  private:
+    memory::Buffer values;
+    std::vector<uint8_t> labels_data;
+    size_t image_rows;
+    size_t image_cols;
+};
+
 // Function to load MNIST training dataset
-std::pair<std::vector<matrix::Matrix>, std::vector<uint8_t>> load_mnist(
+Dataset load_mnist(
     const std::string& images_path = "./data/train-images.idx3-ubyte",
     const std::string& labels_path = "./data/train-labels.idx1-ubyte"
 );
 
-}  // namespace mnist
\ No newline at end of file
+// Shard shard of shards equal, contiguous shards of the dataset, e.g. the
+// samples of one rank in distributed training. The last size() % shards
+// samples belong to no shard, so that every shard trains on as many
+// batches. Only the shard is normalized and kept in memory.
+Dataset load_mnist_shard(
+    const std::string& images_path,
+    const std::string& labels_path,
+    size_t shard,
+    size_t shards
+);
+
+// The same over the first count samples of an open source only, e.g. the
+// training split when the rest is held out for validation. Throws
+// std::out_of_range if count exceeds source.size().
+Dataset load_shard(
+    const MappedDataset& source, size_t count, size_t shard, size_t shards
+);
+
+}  // namespace mnist
+
+#endif  // MNIST_HPP
@@ -0,0 +1,303 @@
+#include "network.hpp"
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+#include "gemm.hpp"
+#include "simd.hpp"
+
+namespace network {
+
+using matrix::ConstMatrixView;
+using matrix::MatrixView;
+
+namespace {
+
+// Every block of the arena starts on a cache line
+constexpr size_t ALIGNMENT_FLOATS = memory::ALIGNMENT / sizeof(float);
+
+size_t padded(size_t n) {
+    return (n + ALIGNMENT_FLOATS - 1) / ALIGNMENT_FLOATS * ALIGNMENT_FLOATS;
+}
+
+}  // namespace
+
+Network::Network(
+    std::vector<size_t> sizes,
+    size_t batch_size,
+    activation::Kind hidden,
+    activation::Kind output,
+    uint32_t seed
+)
+    : layer_sizes(std::move(sizes)),
+      max_batch(batch_size),
+      hidden_kind(hidden),
+      output_kind(output) {
+    if (layer_sizes.size() < 2) {
+        throw std::invalid_argument("A network needs an input and an output layer");
+    }
+    if (std::find(layer_sizes.begin(), layer_sizes.end(), 0) !=
+        layer_sizes.end()) {
+        throw std::invalid_argument("Layer sizes must be positive");
+    }
+    if (max_batch == 0) {
+        throw std::invalid_argument("Batch size must be positive");
+    }
+    if (hidden_kind == activation::Kind::Softmax) {
+        throw std::invalid_argument("Hidden layers need an elementwise activation");
+    }
+
+    allocate(nullptr);
+
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<> dist(-0.1, 0.1);
+    for (auto& layer : layers) {
+        for (size_t i = 0; i < layer.weight.N; ++i) {
+            float* row = layer.weight.row(i);
+            for (size_t j = 0; j < layer.weight.M; ++j) {
+                row[j] = static_cast<float>(dist(gen));
+            }
+        }
+    }
+}
+
+Network::Network(Network& owner, size_t batch_size)
+    : layer_sizes(owner.layer_sizes),
+      max_batch(batch_size),
+      hidden_kind(owner.hidden_kind),
+      output_kind(owner.output_kind),
+      shared(true) {
+    if (owner.storage != precision::Format::FP32) {
+        throw std::invalid_argument("Networks sharing parameters train in fp32");
+    }
+    if (max_batch == 0) {
+        throw std::invalid_argument("Batch size must be positive");
+    }
+    allocate(owner.parameter_data);
+}
+
+void Network::allocate(float* parameters) {
+    // Parameters unless shared, gradients in the same layout, the
+    // pre-activation, output and error of every layer, then the input copy
+    size_t buffer_count = padded(max_batch * layer_sizes.front());
+    for (size_t l = 0; l + 1 < layer_sizes.size(); ++l) {
+        size_t rows = layer_sizes[l + 1];
+        parameter_count += padded(rows * layer_sizes[l]) + padded(rows);
+        buffer_count += 3 * padded(rows * max_batch);
+    }
+    size_t own_parameters = parameters == nullptr ? parameter_count : 0;
+    size_t total = own_parameters + parameter_count + buffer_count;
+    arena = memory::make_buffer(total);
+    std::fill(arena.get(), arena.get() + total, 0.0f);
+
+    parameter_data = parameters == nullptr ? arena.get() : parameters;
+    gradient_data = arena.get() + own_parameters;
+    float* parameter = parameter_data;
+    float* gradient = gradient_data;
+    float* buffer = gradient + parameter_count;
+    layers.reserve(layer_sizes.size() - 1);
+    for (size_t l = 0; l + 1 < layer_sizes.size(); ++l) {
+        size_t rows = layer_sizes[l + 1];
+        size_t cols = layer_sizes[l];
+        size_t weights = padded(rows * cols);
+        size_t values = padded(rows * max_batch);
+        bool last = l + 2 == layer_sizes.size();
+        layers.push_back(Layer{
+            MatrixView(parameter, rows, cols),
+            MatrixView(parameter + weights, rows, 1),
+            MatrixView(gradient, rows, cols),
+            MatrixView(gradient + weights, rows, 1),
+            MatrixView(buffer, rows, max_batch),
+            MatrixView(buffer + values, rows, max_batch),
+            MatrixView(buffer + 2 * values, rows, max_batch),
+            last ? output_kind : hidden_kind,
+        });
+        parameter += weights + padded(rows);
+        gradient += weights + padded(rows);
+        buffer += 3 * values;
+    }
+    input = MatrixView(buffer, max_batch, layer_sizes.front());
+}
+
+ConstMatrixView Network::forward(ConstMatrixView x) {
+    if (x.M != input_size()) {
+        throw std::invalid_argument("Input must hold one sample of input_size() values per row");
+    }
+    if (x.N == 0 || x.N > max_batch) {
+        throw std::invalid_argument("Batch must hold between 1 and batch_size() samples");
+    }
+    batch = x.N;
+    for (size_t b = 0; b < batch; ++b) {
+        std::copy(x.row(b), x.row(b) + x.M, input.row(b));
+    }
+
+    // Each layer is one fused pass: the product, the bias, the
+    // pre-activation kept for backprop and the activation. Softmax needs
+    // whole columns, so it runs after the product.
+    for (size_t l = 0; l < layers.size(); ++l) {
+        auto& layer = layers[l];
+        auto pre = columns(layer.pre);
+        auto out = columns(layer.out);
+        auto func = activation::kernel(layer.kind);
+        if (storage != precision::Format::FP32) {
+            forward16(l);
+        } else if (l == 0) {
+            layer.weight.multiply_transpose_bias_activate_into(
+                inputs(), layer.bias, pre, out, func
+            );
+        } else {
+            layer.weight.multiply_bias_activate_into(
+                columns(layers[l - 1].out), layer.bias, pre, out, func
+            );
+        }
+        if (layer.kind == activation::Kind::Softmax) {
+            activation::softmax(out, out);
+        }
+    }
+    return output();
+}
+
+void Network::forward16(size_t l) {
+    auto& layer = layers[l];
+    auto pre = columns(layer.pre);
+    auto out = columns(layer.out);
+    gemm::Operand weight{layer.weight16, layer.weight.ld, storage};
+    // The input stays in fp32, one sample per row
+    gemm::Operand x = l == 0
+        ? gemm::Operand{input.data, input.ld, precision::Format::FP32}
+        : gemm::Operand{layers[l - 1].out16, max_batch, storage};
+    gemm::gemm(
+        gemm::Transpose::No,
+        l == 0 ? gemm::Transpose::Yes : gemm::Transpose::No,
+        out.N,
+        out.M,
+        layer.weight.M,
+        1.0f,
+        weight,
+        x,
+        0.0f,
+        out.data,
+        out.ld,
+        gemm::Epilogue{
+            layer.bias.data, pre.data, pre.ld, activation::kernel(layer.kind)
+        }
+    );
+    if (l + 1 < layers.size()) {
+        for (size_t i = 0; i < out.N; ++i) {
+            precision::encode(
+                storage, out.row(i), layer.out16 + i * max_batch, out.M
+            );
+        }
+    }
+}
+
+void Network::set_storage_format(precision::Format format) {
+    if (shared && format != precision::Format::FP32) {
+        throw std::invalid_argument("Networks sharing parameters train in fp32");
+    }
+    storage = format;
+    if (storage == precision::Format::FP32) {
+        return;
+    }
+    if (!arena16) {
+        // Copies of the parameters in their layout, then of every output
+        size_t count = parameter_count;
+        for (const auto& layer : layers) {
+            count += padded(layer.out.N * max_batch);
+        }
+        arena16 = memory::make_buffer((count + 1) / 2);
+        auto* weight16 = reinterpret_cast<uint16_t*>(arena16.get());
+        auto* out16 = weight16 + parameter_count;
+        const float* params = parameters().data();
+        for (auto& layer : layers) {
+            layer.weight16 = weight16 + (layer.weight.data - params);
+            layer.out16 = out16;
+            out16 += padded(layer.out.N * max_batch);
+        }
+    }
+    precision::encode(
+        storage,
+        parameters().data(),
+        reinterpret_cast<uint16_t*>(arena16.get()),
+        parameter_count
+    );
+}
+
+ConstMatrixView Network::output() const { return columns(layers.back().out); }
+
+void Network::backward(
+    ConstMatrixView target, const std::function<void(size_t)>& layer_done
+) {
+    if (batch == 0) {
+        throw std::logic_error("backward needs a forward pass first");
+    }
+    if (target.N != output_size() || target.M != batch) {
+        throw std::invalid_argument("Target must hold one column per sample of the last forward");
+    }
+    auto& last = layers.back();
+    columns(last.out).elementwise_into(target, columns(last.delta), simd::Sub{});
+
+    for (size_t l = layers.size(); l-- > 0;) {
+        auto& layer = layers[l];
+        auto delta = columns(layer.delta);
+        if (l == 0) {
+            // The input holds one sample per row
+            delta.multiply_into(inputs(), layer.dweight);
+        } else {
+            delta.multiply_transpose_into(
+                columns(layers[l - 1].out), layer.dweight
+            );
+        }
+        delta.row_sum_into(layer.dbias);
+        if (layer_done) {
+            layer_done(l);
+        }
+
+        if (l == 0) {
+            break;
+        }
+        // Error of the layer below, times its activation derivative taken
+        // from its output, in the same pass when the activation allows it
+        auto& below = layers[l - 1];
+        auto combine = activation::backward_kernel(below.kind);
+        if (combine != nullptr) {
+            layer.weight.transpose_multiply_elementwise_into(
+                delta, columns(below.out), columns(below.delta), combine
+            );
+        } else {
+            layer.weight.transpose_multiply_into(delta, columns(below.delta));
+            activation::backward(
+                below.kind,
+                columns(below.delta),
+                columns(below.pre),
+                columns(below.out),
+                columns(below.delta)
+            );
+        }
+    }
+}
+
+void Network::step(float learning_rate) {
+    if (batch == 0) {
+        throw std::logic_error("step needs a backward pass first");
+    }
+    float* params = parameters().data();
+    simd::axpy(
+        params,
+        gradients().data(),
+        -learning_rate / static_cast<float>(batch),
+        params,
+        parameter_count
+    );
+    if (storage != precision::Format::FP32) {
+        precision::encode(
+            storage,
+            params,
+            reinterpret_cast<uint16_t*>(arena16.get()),
+            parameter_count
+        );
+    }
+}
+
+}  // namespace network
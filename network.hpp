@@ -0,0 +1,196 @@
+#ifndef NETWORK_HPP
+#define NETWORK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "activation.hpp"
+#include "matrix.hpp"
+#include "memory.hpp"
+#include "precision.hpp"
+
+namespace network {
+
+// Fully connected network trained on mini-batches.
+//
+// Every parameter, gradient and per-layer buffer lives in one 64-byte
+// aligned arena allocated by the constructor, so forward, backward and step
+// never allocate. Parameters are laid out as W0, b0, W1, b1, ... with each
+// block starting on a cache line, and the gradients mirror that layout, so
+// an update is a single pass over two flat buffers.
+//
+// Layers hold one sample per column. Batches come in one sample per row, as
+// handed out by mnist::Dataset::batch; forward copies them into the arena,
+// where backward finds them.
+class Network {
+  public:
+    // sizes[0] is the input width and sizes.back() the output width; every
+    // size in between adds a hidden layer. Batches may hold up to batch_size
+    // samples. Weights are drawn uniformly from [-0.1, 0.1) with seed, row by
+    // row, layer by layer; biases start at zero.
+    Network(
+        std::vector<size_t> sizes,
+        size_t batch_size,
+        activation::Kind hidden = activation::Kind::Sigmoid,
+        activation::Kind output = activation::Kind::Sigmoid,
+        uint32_t seed = 0
+    );
+
+    // Network sharing the parameters of owner, e.g. one per thread of
+    // asynchronous SGD: forward reads owner's weights and step writes them,
+    // while the gradients and layer buffers, for batches of up to
+    // batch_size samples, are its own and the only storage it allocates.
+    // owner must outlive it. Sharing networks train in fp32; throws
+    // std::invalid_argument if owner stores 16-bit copies.
+    Network(Network& owner, size_t batch_size);
+
+    Network(Network&&) noexcept = default;
+    Network& operator=(Network&&) noexcept = default;
+    Network(const Network&) = delete;
+    Network& operator=(const Network&) = delete;
+
+    // Number of weight layers
+    size_t depth() const { return layers.size(); }
+    const std::vector<size_t>& sizes() const { return layer_sizes; }
+    size_t input_size() const { return layer_sizes.front(); }
+    size_t output_size() const { return layer_sizes.back(); }
+    size_t batch_size() const { return max_batch; }
+    activation::Kind hidden_activation() const { return hidden_kind; }
+    activation::Kind output_activation() const { return output_kind; }
+
+    // Weight l maps layer l (sizes[l] wide) to layer l + 1: sizes[l + 1] x
+    // sizes[l]. Bias l is a sizes[l + 1] x 1 column.
+    matrix::MatrixView weight(size_t l) { return layers.at(l).weight; }
+    matrix::MatrixView bias(size_t l) { return layers.at(l).bias; }
+    matrix::ConstMatrixView weight(size_t l) const {
+        return layers.at(l).weight;
+    }
+    matrix::ConstMatrixView bias(size_t l) const { return layers.at(l).bias; }
+
+    // Gradients of the last backward, summed over its batch
+    matrix::ConstMatrixView weight_gradient(size_t l) const {
+        return layers.at(l).dweight;
+    }
+    matrix::ConstMatrixView bias_gradient(size_t l) const {
+        return layers.at(l).dbias;
+    }
+
+    // Every parameter and every gradient as flat buffers in the same layout,
+    // including the zero padding between blocks
+    std::span<float> parameters() { return {parameter_data, parameter_count}; }
+    std::span<const float> parameters() const {
+        return {parameter_data, parameter_count};
+    }
+    std::span<float> gradients() { return {gradient_data, parameter_count}; }
+    std::span<const float> gradients() const {
+        return {gradient_data, parameter_count};
+    }
+
+    // Runs input (n x input_size(), n <= batch_size()) through every layer
+    // and returns the output layer, output_size() x n. The input is copied,
+    // so it need not outlive the call.
+    matrix::ConstMatrixView forward(matrix::ConstMatrixView input);
+
+    // Output of the last forward
+    matrix::ConstMatrixView output() const;
+
+    // Activated output of weight layer l in the last forward, sizes[l + 1] x
+    // samples(); the last one is output()
+    matrix::ConstMatrixView activations(size_t l) const {
+        return columns(layers.at(l).out);
+    }
+
+    // Backpropagates the last forward against target (output_size() x n, one
+    // column per sample) and stores the gradients summed over the batch. The
+    // output error is output - target, the gradient of cross-entropy for a
+    // sigmoid or softmax output. Layers are visited from the last to the
+    // first; layer_done(l), if given, is called as soon as the gradients of
+    // weight layer l are final, e.g. to start sending them while the layers
+    // below are still being computed.
+    void backward(
+        matrix::ConstMatrixView target,
+        const std::function<void(size_t)>& layer_done = {}
+    );
+
+    // Plain SGD: parameters -= learning_rate * gradients averaged over the
+    // batch of the last backward
+    void step(float learning_rate);
+
+    // Samples in the last forward
+    size_t samples() const { return batch; }
+
+    // Mixed precision: with a 16-bit format, forward multiplies 16-bit copies
+    // of the weights and of the activations each layer feeds the next, with
+    // fp32 products and sums. backward and step keep working on the fp32
+    // values, which stay the master weights; step refreshes the copies from
+    // them. Weights changed through weight() or bias() reach the copies on
+    // the next step or call to this. FP32 (the default) switches it off. The
+    // first call with a 16-bit format allocates the copies. Networks sharing
+    // parameters throw std::invalid_argument for 16-bit formats.
+    void set_storage_format(precision::Format format);
+    precision::Format storage_format() const { return storage; }
+
+  private:
+    // Views into the arena for one weight layer
+    struct Layer {
+        matrix::MatrixView weight;
+        matrix::MatrixView bias;
+        matrix::MatrixView dweight;
+        matrix::MatrixView dbias;
+        // Pre-activation, activated output and error of the layer this one
+        // feeds, sizes[l + 1] x batch_size
+        matrix::MatrixView pre;
+        matrix::MatrixView out;
+        matrix::MatrixView delta;
+        activation::Kind kind;
+        // 16-bit copies of weight and out in mixed precision, with the
+        // same row strides
+        uint16_t* weight16 = nullptr;
+        uint16_t* out16 = nullptr;
+    };
+
+    // Allocates and zeroes the arena and lays out the layers in it. With
+    // parameters, the weight and bias views point into that block of
+    // parameter_count floats instead, and the arena holds no parameters.
+    void allocate(float* parameters);
+
+    // Forward pass of layer l on the 16-bit copies
+    void forward16(size_t l);
+
+    // Columns of a per-layer buffer used by the last forward
+    matrix::MatrixView columns(matrix::MatrixView m) const {
+        return m.block(0, 0, m.N, batch);
+    }
+
+    // Samples of the last forward in the input copy
+    matrix::ConstMatrixView inputs() const {
+        return input.block(0, 0, batch, input.M);
+    }
+
+    std::vector<size_t> layer_sizes;
+    size_t max_batch;
+    activation::Kind hidden_kind;
+    activation::Kind output_kind;
+    size_t parameter_count = 0;
+    memory::Buffer arena;
+    // The parameter block of the arena, or of the network shared with, and
+    // the gradient block of the arena
+    float* parameter_data = nullptr;
+    float* gradient_data = nullptr;
+    bool shared = false;
+    std::vector<Layer> layers;
+
+    precision::Format storage = precision::Format::FP32;
+    memory::Buffer arena16;
+
+    // Copy of the last forward's input, batch_size x sizes[0]
+    matrix::MatrixView input{nullptr, 0, 0};
+    size_t batch = 0;
+};
+
+}  // namespace network
+
+#endif  // NETWORK_HPP
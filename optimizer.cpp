@@ -0,0 +1,199 @@
+#include "optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+
+#include "simd.hpp"
+
+namespace optimizer {
+
+Kind parse(const std::string& name) {
+    for (Kind kind :
+         {Kind::SGD, Kind::Momentum, Kind::Nesterov, Kind::RMSProp, Kind::Adam,
+          Kind::AdamW}) {
+        if (name == optimizer::name(kind)) {
+            return kind;
+        }
+    }
+    throw std::invalid_argument("Unknown optimizer: " + name);
+}
+
+const char* name(Kind kind) {
+    switch (kind) {
+        case Kind::SGD:
+            return "sgd";
+        case Kind::Momentum:
+            return "momentum";
+        case Kind::Nesterov:
+            return "nesterov";
+        case Kind::RMSProp:
+            return "rmsprop";
+        case Kind::Adam:
+            return "adam";
+        case Kind::AdamW:
+            return "adamw";
+    }
+    return "unknown";
+}
+
+size_t state_count(Kind kind) {
+    switch (kind) {
+        case Kind::SGD:
+            return 0;
+        case Kind::Momentum:
+        case Kind::Nesterov:
+        case Kind::RMSProp:
+            return 1;
+        case Kind::Adam:
+        case Kind::AdamW:
+            return 2;
+    }
+    return 0;
+}
+
+Optimizer::Optimizer(network::Network& net, Settings settings)
+    : net(&net),
+      config(settings),
+      parameter_count(net.parameters().size()) {
+    size_t total = state_count(config.kind) * parameter_count;
+    moments = memory::make_buffer(total);
+    std::fill_n(moments.get(), total, 0.0f);
+}
+
+void Optimizer::step(float learning_rate, size_t samples) {
+    update(0, parameter_count, learning_rate, samples);
+    advance();
+    if (net->storage_format() != precision::Format::FP32) {
+        net->set_storage_format(net->storage_format());
+    }
+}
+
+void Optimizer::update(
+    size_t first, size_t count, float learning_rate, size_t samples
+) {
+    if (first > parameter_count || count > parameter_count - first) {
+        throw std::out_of_range("Update range exceeds the parameters");
+    }
+    if (samples == 0) {
+        throw std::invalid_argument("Gradients must be summed over samples");
+    }
+    float* w = net->parameters().data() + first;
+    const float* g = net->gradients().data() + first;
+    if (config.kind == Kind::SGD) {
+        // The update of Network::step, bit for bit
+        float alpha = -learning_rate / static_cast<float>(samples);
+        simd::axpy(w, g, alpha, w, count);
+        return;
+    }
+
+    simd::Update u;
+    u.grad_scale = 1.0f / static_cast<float>(samples);
+    u.learning_rate = learning_rate;
+    // RMSProp keeps only the second moment, in the first buffer
+    float* first_moment = moments.get() + first;
+    float* second_moment = first_moment;
+    switch (config.kind) {
+        case Kind::Momentum:
+            u.beta1 = config.momentum;
+            simd::momentum_update(w, first_moment, nullptr, g, u, count);
+            break;
+        case Kind::Nesterov:
+            u.beta1 = config.momentum;
+            simd::nesterov_update(w, first_moment, nullptr, g, u, count);
+            break;
+        case Kind::RMSProp:
+            u.beta2 = config.beta2;
+            u.epsilon = config.epsilon;
+            simd::rmsprop_update(w, nullptr, second_moment, g, u, count);
+            break;
+        case Kind::Adam:
+        case Kind::AdamW: {
+            // Bias correction of step t, folded into the step size and
+            // epsilon as in section 2 of the Adam paper
+            double t = static_cast<double>(step_count + 1);
+            double correction1 = 1.0 - std::pow(config.beta1, t);
+            double correction2 = std::sqrt(1.0 - std::pow(config.beta2, t));
+            u.learning_rate = static_cast<float>(
+                learning_rate * correction2 / correction1
+            );
+            u.epsilon = static_cast<float>(config.epsilon * correction2);
+            u.beta1 = config.beta1;
+            u.beta2 = config.beta2;
+            if (config.kind == Kind::AdamW) {
+                u.decay = learning_rate * config.weight_decay;
+            }
+            second_moment = first_moment + parameter_count;
+            simd::adam_update(w, first_moment, second_moment, g, u, count);
+            break;
+        }
+        case Kind::SGD:
+            break;
+    }
+}
+
+std::vector<std::span<const float>> Optimizer::state() const {
+    std::vector<std::span<const float>> buffers;
+    for (size_t i = 0; i < state_count(config.kind); ++i) {
+        buffers.emplace_back(
+            moments.get() + i * parameter_count, parameter_count
+        );
+    }
+    return buffers;
+}
+
+std::span<float> Optimizer::state(size_t i) {
+    if (i >= state_count(config.kind)) {
+        throw std::out_of_range("No such optimizer buffer");
+    }
+    return {moments.get() + i * parameter_count, parameter_count};
+}
+
+Decay parse_decay(const std::string& name) {
+    for (Decay decay : {Decay::Constant, Decay::Step, Decay::Cosine}) {
+        if (name == optimizer::name(decay)) {
+            return decay;
+        }
+    }
+    throw std::invalid_argument("Unknown learning rate schedule: " + name);
+}
+
+const char* name(Decay decay) {
+    switch (decay) {
+        case Decay::Constant:
+            return "constant";
+        case Decay::Step:
+            return "step";
+        case Decay::Cosine:
+            return "cosine";
+    }
+    return "unknown";
+}
+
+float Schedule::rate(float base, uint64_t step) const {
+    if (step < warmup) {
+        return base * static_cast<float>(step + 1) / static_cast<float>(warmup);
+    }
+    uint64_t s = step - warmup;
+    if (period == 0) {
+        return base;
+    }
+    switch (decay) {
+        case Decay::Constant:
+            return base;
+        case Decay::Step:
+            return base * std::pow(gamma, static_cast<float>(s / period));
+        case Decay::Cosine: {
+            if (s >= period) {
+                return 0.0f;
+            }
+            double phase = std::numbers::pi * static_cast<double>(s) /
+                           static_cast<double>(period);
+            return static_cast<float>(base * 0.5 * (1.0 + std::cos(phase)));
+        }
+    }
+    return base;
+}
+
+}  // namespace optimizer
@@ -0,0 +1,121 @@
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "memory.hpp"
+#include "network.hpp"
+
+namespace optimizer {
+
+// Update rules. SGD steps along the averaged gradient like Network::step;
+// Momentum and Nesterov keep a velocity per parameter, RMSProp a running
+// mean of squared gradients and Adam and AdamW both. AdamW decays the
+// weights directly instead of through the gradient.
+enum class Kind { SGD, Momentum, Nesterov, RMSProp, Adam, AdamW };
+
+// Parses sgd, momentum, nesterov, rmsprop, adam or adamw.
+// Throws std::invalid_argument for any other name.
+Kind parse(const std::string& name);
+
+const char* name(Kind kind);
+
+// Buffers of one value per parameter the rule keeps between steps
+size_t state_count(Kind kind);
+
+// Hyperparameters, with the usual defaults. Each rule reads only its own.
+struct Settings {
+    Kind kind = Kind::SGD;
+    // Velocity decay of Momentum and Nesterov
+    float momentum = 0.9f;
+    // Decay of Adam's first moment
+    float beta1 = 0.9f;
+    // Decay of the squared gradients of RMSProp and Adam
+    float beta2 = 0.999f;
+    float epsilon = 1e-8f;
+    // Fraction of every weight AdamW removes per step, per unit of learning
+    // rate
+    float weight_decay = 0.01f;
+};
+
+// Trains the parameters of a network from its gradients.
+//
+// The state buffers are allocated and zeroed by the constructor, in the
+// layout of Network::parameters(), so that checkpoint::save stores them
+// next to the weights. Every rule is one fused kernel of simd.hpp: a single
+// pass reads each gradient once and writes the weight and its state in
+// place, instead of one elementwise sweep per term.
+class Optimizer {
+  public:
+    // net must outlive the optimizer
+    explicit Optimizer(network::Network& net, Settings settings = {});
+
+    Optimizer(Optimizer&&) noexcept = default;
+    Optimizer& operator=(Optimizer&&) noexcept = default;
+    Optimizer(const Optimizer&) = delete;
+    Optimizer& operator=(const Optimizer&) = delete;
+
+    Kind kind() const { return config.kind; }
+    const Settings& settings() const { return config; }
+
+    // Steps taken so far, which Adam's bias correction depends on
+    uint64_t steps() const { return step_count; }
+    void set_steps(uint64_t steps) { step_count = steps; }
+
+    // One update of every parameter from the network's gradients(), summed
+    // over samples samples as after Network::backward. Refreshes the 16-bit
+    // copies of the weights of mixed precision. SGD reproduces Network::step
+    // exactly.
+    void step(float learning_rate, size_t samples);
+
+    // The update of step() restricted to parameters [first, first + count),
+    // for callers that update the parameters in chunks of their own, e.g.
+    // while all-reducing the gradients. Once every parameter is updated,
+    // advance() ends the step; the 16-bit copies are left to the caller.
+    void update(
+        size_t first, size_t count, float learning_rate, size_t samples
+    );
+    void advance() { ++step_count; }
+
+    // The state buffers, state_count(kind()) of them
+    std::vector<std::span<const float>> state() const;
+    std::span<float> state(size_t i);
+
+  private:
+    network::Network* net;
+    Settings config;
+    size_t parameter_count;
+    uint64_t step_count = 0;
+    memory::Buffer moments;
+};
+
+// Shapes of the learning rate over a run
+enum class Decay { Constant, Step, Cosine };
+
+// Parses constant, step or cosine.
+// Throws std::invalid_argument for any other name.
+Decay parse_decay(const std::string& name);
+
+const char* name(Decay decay);
+
+// Learning rate as a function of the step: a linear warmup over the first
+// warmup steps, step s taking (s + 1) / warmup of the base rate so that the
+// first one already moves the weights, then the base rate shaped by decay.
+// Step multiplies it by gamma every period steps; Cosine anneals it to 0
+// over period steps and stays there.
+struct Schedule {
+    Decay decay = Decay::Constant;
+    uint64_t warmup = 0;
+    uint64_t period = 0;
+    float gamma = 0.1f;
+
+    float rate(float base, uint64_t step) const;
+};
+
+}  // namespace optimizer
+
+#endif  // OPTIMIZER_HPP
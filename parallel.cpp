@@ -0,0 +1,218 @@
+#include "parallel.hpp"
+
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace parallel {
+
+namespace {
+
+// Set while a thread runs tasks, so nested parallel_for calls stay serial.
+thread_local bool inside_pool = false;
+
+uint64_t pack(uint64_t begin, uint64_t end) { return begin | (end << 32); }
+
+size_t default_threads() {
+    const char* env = std::getenv("NNPP_THREADS");
+    if (env != nullptr) {
+        size_t threads = std::strtoul(env, nullptr, 10);
+        if (threads > 0) {
+            return threads;
+        }
+    }
+    size_t hardware = std::thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 1;
+}
+
+std::unique_ptr<ThreadPool>& global_pool() {
+    static std::unique_ptr<ThreadPool> instance;
+    return instance;
+}
+
+std::mutex global_mutex;
+
+}  // namespace
+
+ThreadPool::ThreadPool(size_t threads)
+    : ranges(new Range[threads > 0 ? threads : 1]) {
+    if (threads == 0) {
+        throw std::invalid_argument("Thread pool needs at least one thread");
+    }
+    workers.reserve(threads - 1);
+    for (size_t id = 1; id < threads; ++id) {
+        workers.emplace_back([this, id] { worker_loop(id); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallel_for(
+    size_t count, const std::function<void(size_t)>& fn
+) {
+    if (count == 0) {
+        return;
+    }
+    if (workers.empty() || count == 1 || inside_pool) {
+        for (size_t i = 0; i < count; ++i) {
+            fn(i);
+        }
+        return;
+    }
+    if (count > std::numeric_limits<uint32_t>::max()) {
+        throw std::invalid_argument("Too many tasks for one parallel_for");
+    }
+
+    std::lock_guard<std::mutex> submit_lock(submit);
+
+    size_t threads = size();
+    for (size_t id = 0; id < threads; ++id) {
+        ranges[id].bounds.store(
+            pack(count * id / threads, count * (id + 1) / threads),
+            std::memory_order_relaxed
+        );
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = &fn;
+        error = nullptr;
+        pending = workers.size();
+        ++generation;
+    }
+    wake.notify_all();
+
+    inside_pool = true;
+    run(0);
+    inside_pool = false;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pending == 0; });
+    task = nullptr;
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::worker_loop(size_t id) {
+    inside_pool = true;
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+        run(id);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0) {
+                done.notify_one();
+            }
+        }
+    }
+}
+
+// Drains this thread's own share, then steals from the others until every
+// share is empty.
+void ThreadPool::run(size_t id) {
+    size_t threads = size();
+    size_t index;
+    auto execute = [&] {
+        try {
+            (*task)(index);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    };
+    while (take_front(id, index)) {
+        execute();
+    }
+    for (size_t offset = 1; offset < threads; ++offset) {
+        size_t victim = (id + offset) % threads;
+        while (steal_back(victim, index)) {
+            execute();
+        }
+    }
+}
+
+bool ThreadPool::take_front(size_t id, size_t& index) {
+    auto& bounds = ranges[id].bounds;
+    uint64_t current = bounds.load(std::memory_order_acquire);
+    while (true) {
+        uint64_t begin = current & 0xffffffff;
+        uint64_t end = current >> 32;
+        if (begin >= end) {
+            return false;
+        }
+        if (bounds.compare_exchange_weak(
+                current, pack(begin + 1, end), std::memory_order_acq_rel
+            )) {
+            index = begin;
+            return true;
+        }
+    }
+}
+
+bool ThreadPool::steal_back(size_t victim, size_t& index) {
+    auto& bounds = ranges[victim].bounds;
+    uint64_t current = bounds.load(std::memory_order_acquire);
+    while (true) {
+        uint64_t begin = current & 0xffffffff;
+        uint64_t end = current >> 32;
+        if (begin >= end) {
+            return false;
+        }
+        if (bounds.compare_exchange_weak(
+                current, pack(begin, end - 1), std::memory_order_acq_rel
+            )) {
+            index = end - 1;
+            return true;
+        }
+    }
+}
+
+ThreadPool& pool() {
+    std::lock_guard<std::mutex> lock(global_mutex);
+    auto& instance = global_pool();
+    if (!instance) {
+        instance = std::make_unique<ThreadPool>(default_threads());
+    }
+    return *instance;
+}
+
+void set_num_threads(size_t threads) {
+    std::lock_guard<std::mutex> lock(global_mutex);
+    auto& instance = global_pool();
+    if (threads == 0) {
+        threads = default_threads();
+    }
+    if (instance && instance->size() == threads) {
+        return;
+    }
+    instance.reset();
+    instance = std::make_unique<ThreadPool>(threads);
+}
+
+size_t num_threads() { return pool().size(); }
+
+void parallel_for(size_t count, const std::function<void(size_t)>& task) {
+    pool().parallel_for(count, task);
+}
+
+}  // namespace parallel
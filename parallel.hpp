@@ -0,0 +1,83 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+// Persistent pool of worker threads with work stealing.
+//
+// parallel_for splits the index range evenly over the threads. Each thread
+// drains its own share from the front and, once empty, steals single indices
+// from the back of the others. Threads sleep between calls, so the pool is
+// meant to be created once and reused.
+class ThreadPool {
+  public:
+    // threads counts every thread running tasks, including the caller of
+    // parallel_for, so 1 means no extra threads.
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers.size() + 1; }
+
+    // Runs task(i) for every i in [0, count) and returns once all are done.
+    // The first exception thrown by a task is rethrown here. Calls made from
+    // inside a task run serially on that thread.
+    void parallel_for(size_t count, const std::function<void(size_t)>& task);
+
+  private:
+    // Remaining [begin, end) of one thread's share, packed into one word so
+    // the owner and thieves can claim indices with a single CAS.
+    struct alignas(64) Range {
+        std::atomic<uint64_t> bounds{0};
+    };
+
+    void worker_loop(size_t id);
+    void run(size_t id);
+    bool take_front(size_t id, size_t& index);
+    bool steal_back(size_t victim, size_t& index);
+
+    std::vector<std::thread> workers;
+    std::unique_ptr<Range[]> ranges;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    size_t pending = 0;
+    bool stopping = false;
+    const std::function<void(size_t)>* task = nullptr;
+    std::exception_ptr error;
+
+    // Serializes parallel_for calls from different outside threads.
+    std::mutex submit;
+};
+
+// Process-wide pool used by the GEMM kernels. Created on first use with
+// NNPP_THREADS threads if set, otherwise one per hardware thread.
+ThreadPool& pool();
+
+// Replaces the process-wide pool. 0 picks the default thread count. Must not
+// be called while the pool is running tasks.
+void set_num_threads(size_t threads);
+
+size_t num_threads();
+
+// Shorthand for pool().parallel_for(count, task).
+void parallel_for(size_t count, const std::function<void(size_t)>& task);
+
+}  // namespace parallel
+
+#endif  // PARALLEL_HPP
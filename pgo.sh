@@ -0,0 +1,22 @@
+#! /usr/bin/env bash
+# Builds nn++ with profile-guided optimization: an instrumented build trains
+# on MNIST once (run download.sh first), then the release build is compiled
+# with the recorded profile into build/pgo-use.
+set -eux
+
+dir="$(cd "$(dirname ${BASH_SOURCE[0]})"; pwd)"
+cd "$dir"
+
+rm -rf "$dir/pgo"
+
+cmake --preset pgo-generate
+cmake --build --preset pgo-generate
+"$dir/build/pgo-generate/nn++" "$@"
+
+# Clang writes raw profiles that have to be merged first
+if compgen -G "$dir/pgo/*.profraw" > /dev/null; then
+    llvm-profdata merge -o "$dir/pgo/default.profdata" "$dir"/pgo/*.profraw
+fi
+
+cmake --preset pgo-use
+cmake --build --preset pgo-use
@@ -0,0 +1,132 @@
+#include "pipeline.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace pipeline {
+
+BatchLoader::BatchLoader(const mnist::Dataset& dataset, Options options)
+    : data(dataset),
+      opts(options),
+      order(dataset.size()),
+      generator(options.seed) {
+    if (opts.batch_size == 0) {
+        throw std::invalid_argument("Batch size must be positive");
+    }
+    if (data.size() == 0) {
+        throw std::invalid_argument("Cannot load batches of an empty dataset");
+    }
+    if (opts.classes == 0) {
+        throw std::invalid_argument("Targets need at least one class");
+    }
+
+    slots.resize(opts.prefetch + 1);
+    for (auto& slot : slots) {
+        slot.input = memory::make_buffer(opts.batch_size * data.pixels());
+        slot.target = memory::make_buffer(opts.classes * opts.batch_size);
+        slot.labels.resize(opts.batch_size);
+    }
+    std::iota(order.begin(), order.end(), 0u);
+
+    producer = std::thread([this] { produce(); });
+}
+
+BatchLoader::~BatchLoader() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    freed.notify_one();
+    producer.join();
+}
+
+const Batch& BatchLoader::next() {
+    std::unique_lock lock(mutex);
+    // The batch handed out last time is done with; its slot can be refilled
+    released = consumed;
+    freed.notify_one();
+    filled.wait(lock, [&] { return produced > consumed || error; });
+    if (produced <= consumed) {
+        std::rethrow_exception(error);
+    }
+    return slots[consumed++ % slots.size()].batch;
+}
+
+void BatchLoader::produce() {
+    size_t epoch = opts.start / data.size();
+    size_t offset = opts.start % data.size();
+    try {
+        // Replays the shuffles of the epochs skipped, or started, so the
+        // order is the one an uninterrupted stream would have
+        for (size_t e = 0; opts.shuffle && e < epoch + (offset > 0); ++e) {
+            std::shuffle(order.begin(), order.end(), generator);
+        }
+        while (true) {
+            {
+                std::unique_lock lock(mutex);
+                freed.wait(lock, [&] {
+                    return stopping || produced < released + slots.size();
+                });
+                if (stopping) {
+                    return;
+                }
+            }
+
+            if (offset == 0 && opts.shuffle) {
+                std::shuffle(order.begin(), order.end(), generator);
+            }
+            fill(slots[produced % slots.size()], epoch, offset);
+            offset += std::min(opts.batch_size, data.size() - offset);
+            if (offset == data.size()) {
+                epoch++;
+                offset = 0;
+            }
+
+            {
+                std::lock_guard lock(mutex);
+                produced++;
+            }
+            filled.notify_one();
+        }
+    } catch (...) {
+        {
+            std::lock_guard lock(mutex);
+            error = std::current_exception();
+        }
+        filled.notify_one();
+    }
+}
+
+void BatchLoader::fill(Slot& slot, size_t epoch, size_t offset) {
+    size_t n = std::min(opts.batch_size, data.size() - offset);
+    size_t pixels = data.pixels();
+    float* input = slot.input.get();
+    float* target = slot.target.get();
+
+    // One-hot targets are classes x n, so a short batch is still contiguous
+    std::fill(target, target + opts.classes * n, 0.0f);
+    for (size_t s = 0; s < n; ++s) {
+        uint32_t sample = order[offset + s];
+        auto pixels_of = data.sample(sample);
+        std::copy(pixels_of.begin(), pixels_of.end(), input + s * pixels);
+
+        uint8_t label = data.label(sample);
+        if (label >= opts.classes) {
+            throw std::out_of_range("Label exceeds the number of classes");
+        }
+        slot.labels[s] = label;
+        target[label * n + s] = 1.0f;
+    }
+
+    slot.batch = Batch{
+        {input, n, pixels},
+        {target, opts.classes, n},
+        {slot.labels.data(), n},
+        epoch,
+        offset,
+        n,
+    };
+}
+
+}  // namespace pipeline
@@ -0,0 +1,117 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <random>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "matrix.hpp"
+#include "memory.hpp"
+#include "mnist.hpp"
+
+namespace pipeline {
+
+// Mini-batch ready for training. Views stay valid until the next call to
+// BatchLoader::next.
+struct Batch {
+    // Samples, one per row: size x pixels
+    matrix::ConstMatrixView input{nullptr, 0, 0};
+    // One-hot labels, one column per sample: classes x size
+    matrix::ConstMatrixView target{nullptr, 0, 0};
+    std::span<const uint8_t> labels;
+    // Pass over the dataset the batch belongs to, and the position of its
+    // first sample in that pass
+    size_t epoch = 0;
+    size_t offset = 0;
+    size_t size = 0;
+};
+
+struct Options {
+    size_t batch_size = 1;
+    // Batches prepared ahead of the one being trained on
+    size_t prefetch = 2;
+    size_t classes = 10;
+    // Visit the samples in a new random order every epoch. The order only
+    // depends on seed.
+    bool shuffle = true;
+    uint32_t seed = 0;
+    // Samples to skip, e.g. those a resumed run was trained on: the stream
+    // continues where a loader with the same options would be after handing
+    // them out
+    size_t start = 0;
+};
+
+// Endless stream of mini-batches over a dataset, prepared on a background
+// thread.
+//
+// The loader owns a ring of prefetch + 1 slots, each holding a contiguous
+// batch of samples and its one-hot targets. While the trainer computes on
+// the slot handed out by next, the producer shuffles the sample order at
+// every epoch boundary, gathers the following batches into the free slots
+// and encodes their labels, so input preparation overlaps with the GEMMs.
+// Every buffer is allocated by the constructor.
+//
+// An epoch ends with a short batch when batch_size does not divide the
+// dataset.
+class BatchLoader {
+  public:
+    // The dataset must outlive the loader.
+    BatchLoader(const mnist::Dataset& dataset, Options options);
+    ~BatchLoader();
+
+    BatchLoader(const BatchLoader&) = delete;
+    BatchLoader& operator=(const BatchLoader&) = delete;
+
+    // Waits for the next batch and hands the previous one back to the
+    // producer. Rethrows any error of the producer.
+    const Batch& next();
+
+    size_t batch_size() const { return opts.batch_size; }
+    size_t batches_per_epoch() const {
+        return (data.size() + opts.batch_size - 1) / opts.batch_size;
+    }
+
+  private:
+    struct Slot {
+        memory::Buffer input;
+        memory::Buffer target;
+        std::vector<uint8_t> labels;
+        Batch batch;
+    };
+
+    void produce();
+    void fill(Slot& slot, size_t epoch, size_t offset);
+
+    const mnist::Dataset& data;
+    Options opts;
+    std::vector<Slot> slots;
+
+    // Sample order of the epoch being produced, and the generator that
+    // shuffles it
+    std::vector<uint32_t> order;
+    std::mt19937 generator;
+
+    // Batches filled, handed out and handed back so far; slot
+    // i % slots.size() holds batch i. The batch last handed out is handed
+    // back by the following call to next.
+    std::mutex mutex;
+    std::condition_variable filled;
+    std::condition_variable freed;
+    size_t produced = 0;
+    size_t consumed = 0;
+    size_t released = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+
+    std::thread producer;
+};
+
+}  // namespace pipeline
+
+#endif  // PIPELINE_HPP
@@ -0,0 +1,58 @@
+#include "precision.hpp"
+
+#include <stdexcept>
+
+#include "simd.hpp"
+
+namespace precision {
+
+Format parse(const std::string& name) {
+    for (Format format : {Format::FP32, Format::BF16, Format::FP16}) {
+        if (name == precision::name(format)) {
+            return format;
+        }
+    }
+    throw std::invalid_argument("Unknown precision: " + name);
+}
+
+const char* name(Format format) {
+    switch (format) {
+        case Format::FP32:
+            return "fp32";
+        case Format::BF16:
+            return "bf16";
+        case Format::FP16:
+            return "fp16";
+    }
+    return "unknown";
+}
+
+void encode(Format format, const float* x, uint16_t* out, size_t n) {
+    switch (format) {
+        case Format::BF16:
+            simd::to_bf16(x, out, n);
+            return;
+        case Format::FP16:
+            simd::to_fp16(x, out, n);
+            return;
+        case Format::FP32:
+            break;
+    }
+    throw std::invalid_argument("encode needs a 16-bit format");
+}
+
+void decode(Format format, const uint16_t* x, float* out, size_t n) {
+    switch (format) {
+        case Format::BF16:
+            simd::from_bf16(x, out, n);
+            return;
+        case Format::FP16:
+            simd::from_fp16(x, out, n);
+            return;
+        case Format::FP32:
+            break;
+    }
+    throw std::invalid_argument("decode needs a 16-bit format");
+}
+
+}  // namespace precision
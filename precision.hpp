@@ -0,0 +1,84 @@
+#ifndef PRECISION_HPP
+#define PRECISION_HPP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace precision {
+
+// Storage formats of values that are computed on in fp32. The 16-bit
+// formats halve the bytes moved per value: bf16 keeps the fp32 exponent
+// range with an 8-bit significand, fp16 (IEEE binary16) an 11-bit
+// significand with a range of about 6e-8 to 65504.
+enum class Format { FP32, BF16, FP16 };
+
+// Parses "fp32", "bf16" or "fp16". Throws std::invalid_argument otherwise.
+Format parse(const std::string& name);
+
+const char* name(Format format);
+
+// Bytes per stored value
+inline size_t bytes(Format format) {
+    return format == Format::FP32 ? 4 : 2;
+}
+
+// Scalar conversions. Narrowing rounds to nearest even and keeps infinities
+// and NaNs; fp16 overflows to infinity and underflows through subnormals.
+
+inline float from_bf16(uint16_t h) {
+    return std::bit_cast<float>(static_cast<uint32_t>(h) << 16);
+}
+
+inline uint16_t to_bf16(float x) {
+    uint32_t bits = std::bit_cast<uint32_t>(x);
+    if ((bits & 0x7fffffff) > 0x7f800000) {
+        // Quiet NaN, whatever payload the low bits held
+        return static_cast<uint16_t>((bits >> 16) | 0x40);
+    }
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return static_cast<uint16_t>(bits >> 16);
+}
+
+// Shifts the exponent and significand into place and rebiases the exponent
+// with one multiplication, which also turns fp16 subnormals into normal
+// floats.
+inline float from_fp16(uint16_t h) {
+    uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    uint32_t rest = h & 0x7fff;
+    float value = std::bit_cast<float>(rest << 13) * 0x1.0p+112f;
+    uint32_t bits = rest >= 0x7c00 ? (rest << 13) | 0x7f800000
+                                   : std::bit_cast<uint32_t>(value);
+    return std::bit_cast<float>(bits | sign);
+}
+
+// Lets the fp32 adder do the rounding: adding a power of two aligned with
+// the fp16 ulp of x leaves exactly the rounded significand in the low bits.
+inline uint16_t to_fp16(float x) {
+    uint32_t bits = std::bit_cast<uint32_t>(x);
+    uint32_t twice = bits + bits;
+    uint32_t sign = bits & 0x80000000;
+    // Scaling up then down saturates values beyond fp16 range to infinity
+    float base = (std::bit_cast<float>(bits & 0x7fffffff) * 0x1.0p+112f) *
+                 0x1.0p-110f;
+    uint32_t bias = twice & 0xff000000;
+    if (bias < 0x71000000) {
+        bias = 0x71000000;
+    }
+    base = std::bit_cast<float>((bias >> 1) + 0x07800000) + base;
+    uint32_t rounded = std::bit_cast<uint32_t>(base);
+    uint32_t magnitude = ((rounded >> 13) & 0x7c00) + (rounded & 0x0fff);
+    return static_cast<uint16_t>(
+        (sign >> 16) | (twice > 0xff000000 ? 0x7e00 : magnitude)
+    );
+}
+
+// Converts n values between fp32 and a 16-bit format with the vectorized
+// kernels of simd.hpp. Throws std::invalid_argument for FP32.
+void encode(Format format, const float* x, uint16_t* out, size_t n);
+void decode(Format format, const uint16_t* x, float* out, size_t n);
+
+}  // namespace precision
+
+#endif  // PRECISION_HPP
@@ -0,0 +1,264 @@
+#include "quantize.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "parallel.hpp"
+#include "simd.hpp"
+
+namespace quantize {
+
+using matrix::ConstMatrixView;
+
+namespace {
+
+// Rows of every buffer start on a cache line
+size_t padded(size_t bytes) {
+    constexpr size_t A = memory::ALIGNMENT;
+    return (bytes + A - 1) / A * A;
+}
+
+// Multiply-adds below which a batch runs on the calling thread, and samples
+// per task above it
+constexpr size_t PARALLEL_THRESHOLD = 64 * 64 * 64;
+constexpr size_t CHUNK = 16;
+
+void encode(const float* x, uint8_t* out, size_t n, Params params) {
+    float zero = static_cast<float>(params.zero_point);
+    simd::to_u7(x, 1.0f / params.scale, zero, out, n);
+}
+
+// Softmax of one sample, the output rows holding one sample each
+void softmax_row(float* y, size_t n) {
+    float max = *std::max_element(y, y + n);
+    for (size_t i = 0; i < n; ++i) {
+        y[i] -= max;
+    }
+    simd::exp(y, y, n);
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        sum += y[i];
+    }
+    simd::scale(y, 1.0f / sum, y, n);
+}
+
+}  // namespace
+
+Params choose_params(float min, float max) {
+    if (!std::isfinite(min) || !std::isfinite(max) || min > max) {
+        throw std::invalid_argument("Quantization range must be finite and ordered");
+    }
+    min = std::min(min, 0.0f);
+    max = std::max(max, 0.0f);
+    if (max == min) {
+        return Params{};
+    }
+    Params params;
+    params.scale = (max - min) / static_cast<float>(ACTIVATION_MAX);
+    params.zero_point = std::clamp(
+        static_cast<int32_t>(std::lround(-min / params.scale)),
+        0,
+        ACTIVATION_MAX
+    );
+    return params;
+}
+
+uint8_t quantize(float x, Params params) {
+    uint8_t q;
+    encode(&x, &q, 1, params);
+    return q;
+}
+
+Calibration calibrate(network::Network& net, ConstMatrixView samples) {
+    if (samples.N == 0 || samples.M != net.input_size()) {
+        throw std::invalid_argument("Calibration needs samples of input_size() values per row");
+    }
+    Calibration calibration;
+    calibration.min.assign(net.depth(), INFINITY);
+    calibration.max.assign(net.depth(), -INFINITY);
+    auto observe = [&](size_t l, ConstMatrixView values) {
+        for (size_t i = 0; i < values.N; ++i) {
+            const float* row = values.row(i);
+            auto [lo, hi] = std::minmax_element(row, row + values.M);
+            calibration.min[l] = std::min(calibration.min[l], *lo);
+            calibration.max[l] = std::max(calibration.max[l], *hi);
+        }
+    };
+
+    for (size_t first = 0; first < samples.N; first += net.batch_size()) {
+        auto batch = samples.rows(
+            first, std::min(net.batch_size(), samples.N - first)
+        );
+        observe(0, batch);
+        net.forward(batch);
+        for (size_t l = 1; l < net.depth(); ++l) {
+            observe(l, net.activations(l - 1));
+        }
+    }
+    return calibration;
+}
+
+Model::Model(
+    const network::Network& net,
+    const Calibration& calibration,
+    size_t batch_size
+)
+    : max_batch(batch_size) {
+    if (max_batch == 0) {
+        throw std::invalid_argument("Batch size must be positive");
+    }
+    if (calibration.min.size() != net.depth() ||
+        calibration.max.size() != net.depth()) {
+        throw std::invalid_argument("Calibration must hold one range per layer");
+    }
+
+    // Weight codes, scales and biases of every layer, then its input codes,
+    // then the sums, values and output shared by the layers
+    size_t bytes = 0;
+    for (size_t l = 0; l < net.depth(); ++l) {
+        auto weight = net.weight(l);
+        Layer layer{};
+        layer.in = weight.M;
+        layer.out = weight.N;
+        layer.input = choose_params(calibration.min[l], calibration.max[l]);
+        layer.kind = l + 1 == net.depth() ? net.output_activation()
+                                          : net.hidden_activation();
+        layer.weight_ld = padded(layer.in);
+        layer.codes_ld = padded(layer.in);
+        bytes += layer.out * layer.weight_ld +
+                 2 * padded(layer.out * sizeof(float)) +
+                 max_batch * layer.codes_ld;
+        widest = std::max(widest, layer.out);
+        layers.push_back(layer);
+    }
+    size_t wide = padded(widest * sizeof(float));
+    widest = wide / sizeof(float);
+    size_t shared = 2 * max_batch * wide +
+                    padded(max_batch * output_size() * sizeof(float));
+    arena = memory::make_buffer((bytes + shared) / sizeof(float));
+    std::memset(arena.get(), 0, bytes + shared);
+
+    auto* next = reinterpret_cast<uint8_t*>(arena.get());
+    for (size_t l = 0; l < layers.size(); ++l) {
+        auto& layer = layers[l];
+        layer.weight = reinterpret_cast<int8_t*>(next);
+        next += layer.out * layer.weight_ld;
+        layer.scale = reinterpret_cast<float*>(next);
+        next += padded(layer.out * sizeof(float));
+        layer.bias = reinterpret_cast<float*>(next);
+        next += padded(layer.out * sizeof(float));
+        layer.codes = next;
+        next += max_batch * layer.codes_ld;
+
+        // Symmetric codes per row: the largest weight maps to WEIGHT_MAX
+        auto weight = net.weight(l);
+        auto bias = net.bias(l);
+        for (size_t j = 0; j < layer.out; ++j) {
+            const float* row = weight.row(j);
+            float max = 0.0f;
+            for (size_t p = 0; p < layer.in; ++p) {
+                max = std::max(max, std::fabs(row[p]));
+            }
+            float scale = max > 0.0f ? max / WEIGHT_MAX : 1.0f;
+            int8_t* codes = layer.weight + j * layer.weight_ld;
+            int32_t sum = 0;
+            for (size_t p = 0; p < layer.in; ++p) {
+                codes[p] = static_cast<int8_t>(std::lround(row[p] / scale));
+                sum += codes[p];
+            }
+            layer.scale[j] = layer.input.scale * scale;
+            float correction = static_cast<float>(layer.input.zero_point * sum);
+            layer.bias[j] = bias(j, 0) - layer.scale[j] * correction;
+        }
+    }
+    sums = reinterpret_cast<int32_t*>(next);
+    next += max_batch * wide;
+    values = reinterpret_cast<float*>(next);
+    next += max_batch * wide;
+    output = reinterpret_cast<float*>(next);
+}
+
+size_t Model::parameter_bytes() const {
+    size_t bytes = 0;
+    for (const auto& layer : layers) {
+        bytes += layer.out * layer.in + 2 * layer.out * sizeof(float);
+    }
+    return bytes;
+}
+
+ConstMatrixView Model::forward(ConstMatrixView x) {
+    if (x.M != input_size()) {
+        throw std::invalid_argument("Input must hold one sample of input_size() values per row");
+    }
+    if (x.N == 0 || x.N > max_batch) {
+        throw std::invalid_argument("Batch must hold between 1 and batch_size() samples");
+    }
+    input = x;
+
+    size_t work = 0;
+    for (const auto& layer : layers) {
+        work += layer.in * layer.out;
+    }
+    size_t chunks = (x.N + CHUNK - 1) / CHUNK;
+    if (parallel::num_threads() > 1 && chunks > 1 &&
+        x.N * work >= PARALLEL_THRESHOLD) {
+        parallel::parallel_for(chunks, [&](size_t c) {
+            run(c * CHUNK, std::min(x.N, (c + 1) * CHUNK));
+        });
+    } else {
+        run(0, x.N);
+    }
+    return ConstMatrixView(output, x.N, output_size());
+}
+
+void Model::run(size_t begin, size_t end) {
+    auto& first = layers.front();
+    for (size_t s = begin; s < end; ++s) {
+        encode(
+            input.row(s),
+            first.codes + s * first.codes_ld,
+            first.in,
+            first.input
+        );
+    }
+
+    for (size_t l = 0; l < layers.size(); ++l) {
+        const auto& layer = layers[l];
+        bool last = l + 1 == layers.size();
+        simd::gemm_u8s8(
+            end - begin,
+            layer.out,
+            layer.in,
+            layer.codes + begin * layer.codes_ld,
+            layer.codes_ld,
+            layer.weight,
+            layer.weight_ld,
+            sums + begin * widest,
+            widest
+        );
+        auto func = activation::kernel(layer.kind);
+        for (size_t s = begin; s < end; ++s) {
+            const int32_t* sum = sums + s * widest;
+            float* y = last ? output + s * layer.out : values + s * widest;
+            for (size_t j = 0; j < layer.out; ++j) {
+                y[j] = layer.scale[j] * static_cast<float>(sum[j]) +
+                       layer.bias[j];
+            }
+            if (layer.kind == activation::Kind::Softmax) {
+                softmax_row(y, layer.out);
+            } else {
+                func(y, y, layer.out);
+            }
+            if (!last) {
+                const auto& above = layers[l + 1];
+                encode(
+                    y, above.codes + s * above.codes_ld, layer.out, above.input
+                );
+            }
+        }
+    }
+}
+
+}  // namespace quantize
@@ -0,0 +1,136 @@
+#ifndef QUANTIZE_HPP
+#define QUANTIZE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "activation.hpp"
+#include "matrix.hpp"
+#include "memory.hpp"
+#include "network.hpp"
+
+namespace quantize {
+
+// Post-training int8 quantization of a trained network::Network.
+//
+// Weights become signed codes in [-WEIGHT_MAX, WEIGHT_MAX] with one scale
+// per output row. Activations become unsigned codes in [0, ACTIVATION_MAX]
+// with a scale and zero point per layer, fitted to the ranges observed on
+// calibration samples. Activation codes use 7 bits so that simd::gemm_u8s8
+// cannot saturate and gives the same sums on every instruction set.
+constexpr int32_t WEIGHT_MAX = 127;
+constexpr int32_t ACTIVATION_MAX = 127;
+
+// Affine code of real values: x is about scale * (q - zero_point)
+struct Params {
+    float scale = 1.0f;
+    int32_t zero_point = 0;
+};
+
+// Params whose codes span [min, max]. The range is widened to include 0,
+// which then has an exact code. Throws std::invalid_argument if min > max
+// or either is not finite.
+Params choose_params(float min, float max);
+
+// Code of x, rounded to nearest and clamped to [0, ACTIVATION_MAX]
+uint8_t quantize(float x, Params params);
+
+inline float dequantize(uint8_t q, Params params) {
+    int32_t shifted = static_cast<int32_t>(q) - params.zero_point;
+    return params.scale * static_cast<float>(shifted);
+}
+
+// Ranges of the values every weight layer reads: entry 0 is the input of
+// the network, entry l the output of hidden layer l - 1
+struct Calibration {
+    std::vector<float> min;
+    std::vector<float> max;
+};
+
+// Runs samples (one per row, net.input_size() wide) through net in batches
+// of net.batch_size() and records the range of the input and of every
+// hidden layer. Throws std::invalid_argument for an empty or misshaped set.
+Calibration calibrate(network::Network& net, matrix::ConstMatrixView samples);
+
+// Int8 copy of a network for inference.
+//
+// Each layer multiplies the activation codes of a sample with the weight
+// codes in int32 through simd::gemm_u8s8, then scales the sums back to
+// fp32, adds the bias, applies the activation and encodes the result for
+// the next layer. The zero point of the input is folded into the bias, so
+// the inner loop is the bare integer product. Samples are independent, so
+// large batches are split over the thread pool, each thread taking its
+// samples through every layer. Like Network, everything is allocated by
+// the constructor and forward does not allocate.
+class Model {
+  public:
+    // Quantizes the weights of net, with the activation ranges of
+    // calibration. Batches may hold up to batch_size samples.
+    Model(
+        const network::Network& net,
+        const Calibration& calibration,
+        size_t batch_size
+    );
+
+    Model(Model&&) noexcept = default;
+    Model& operator=(Model&&) noexcept = default;
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    size_t depth() const { return layers.size(); }
+    size_t input_size() const { return layers.front().in; }
+    size_t output_size() const { return layers.back().out; }
+    size_t batch_size() const { return max_batch; }
+
+    // Bytes of the weight codes, their scales and the biases, against
+    // 4 bytes per weight and bias in the fp32 network
+    size_t parameter_bytes() const;
+
+    // Code parameters of the values layer l reads
+    Params input_params(size_t l) const { return layers.at(l).input; }
+
+    // Runs input (n x input_size(), n <= batch_size()) through every layer
+    // and returns the fp32 output. Unlike Network::forward, the output holds
+    // one sample per row: n x output_size().
+    matrix::ConstMatrixView forward(matrix::ConstMatrixView input);
+
+  private:
+    // One weight layer; buffers hold one sample per row of max_batch
+    struct Layer {
+        size_t in;
+        size_t out;
+        Params input;
+        activation::Kind kind;
+        // out x in weight codes, rows weight_ld bytes apart
+        int8_t* weight;
+        size_t weight_ld;
+        // Per output: input scale times weight scale, and the bias with the
+        // zero point term folded in
+        float* scale;
+        float* bias;
+        // Input codes, rows codes_ld bytes apart
+        uint8_t* codes;
+        size_t codes_ld;
+    };
+
+    // Runs samples [begin, end) of the current input through every layer
+    void run(size_t begin, size_t end);
+
+    size_t max_batch;
+    std::vector<Layer> layers;
+    memory::Buffer arena;
+    // Integer sums and fp32 values of a layer, max_batch rows of widest
+    // elements, enough for the widest layer
+    int32_t* sums = nullptr;
+    float* values = nullptr;
+    size_t widest = 0;
+    // The last layer's fp32 output, max_batch x output_size()
+    float* output = nullptr;
+
+    matrix::ConstMatrixView input{nullptr, 0, 0};
+};
+
+}  // namespace quantize
+
+#endif  // QUANTIZE_HPP
@@ -8,6 +8,7 @@ mkShell.override { stdenv = clangStdenv; } {
     clang-tools
     unzip
     gtest
+    gbenchmark
     backward-cpp
     libbfd
     bazelisk
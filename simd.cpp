@@ -0,0 +1,534 @@
+#include "simd.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+#include "precision.hpp"
+#include "simd_kernels.hpp"
+
+namespace simd {
+
+namespace {
+
+// sqrt(8 / pi) and sqrt(8 / pi) * 0.044715, see gelu in simd_impl.hpp
+constexpr float GELU_C1 = 1.5957691216057308f;
+constexpr float GELU_C2 = 0.0713548162726009f;
+
+}  // namespace
+
+float sigmoid(float x) {
+    // Evaluated on exp(-|x|) so it cannot overflow for large |x|.
+    float e = std::exp(-std::fabs(x));
+    float r = 1.0f / (1.0f + e);
+    return x >= 0.0f ? r : e * r;
+}
+
+float sigmoid_derivative(float x) {
+    float e = std::exp(-std::fabs(x));
+    float r = 1.0f / (1.0f + e);
+    return e * r * r;
+}
+
+float gelu(float x) {
+    if (x < -20.0f) {
+        return 0.0f;
+    }
+    return x * sigmoid(x * (GELU_C1 + GELU_C2 * x * x));
+}
+
+namespace {
+
+// Portable fallback for CPUs without any of the vector levels.
+
+void add_n(const float* a, const float* b, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = a[i] + b[i];
+    }
+}
+
+void sub_n(const float* a, const float* b, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = a[i] - b[i];
+    }
+}
+
+void mul_n(const float* a, const float* b, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = a[i] * b[i];
+    }
+}
+
+void axpy_n(const float* a, const float* b, float alpha, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = a[i] + alpha * b[i];
+    }
+}
+
+void scale_n(const float* x, float s, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = x[i] * s;
+    }
+}
+
+void sigmoid_n(const float* x, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = sigmoid(x[i]);
+    }
+}
+
+void sigmoid_derivative_n(const float* x, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = sigmoid_derivative(x[i]);
+    }
+}
+
+void mul_sigmoid_derivative_n(
+    const float* g, const float* x, float* out, size_t n
+) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = g[i] * sigmoid_derivative(x[i]);
+    }
+}
+
+void exp_n(const float* x, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = std::exp(x[i]);
+    }
+}
+
+void tanh_n(const float* x, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = std::tanh(x[i]);
+    }
+}
+
+void relu_n(const float* x, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = x[i] > 0.0f ? x[i] : 0.0f;
+    }
+}
+
+void leaky_relu_n(const float* x, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = x[i] > 0.0f ? x[i] : LEAKY_RELU_SLOPE * x[i];
+    }
+}
+
+void gelu_n(const float* x, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = gelu(x[i]);
+    }
+}
+
+void sigmoid_backward_n(const float* g, const float* y, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = g[i] * y[i] * (1.0f - y[i]);
+    }
+}
+
+void tanh_backward_n(const float* g, const float* y, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = g[i] * (1.0f - y[i] * y[i]);
+    }
+}
+
+void relu_backward_n(const float* g, const float* y, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = y[i] > 0.0f ? g[i] : 0.0f;
+    }
+}
+
+void leaky_relu_backward_n(
+    const float* g, const float* y, float* out, size_t n
+) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = y[i] > 0.0f ? g[i] : LEAKY_RELU_SLOPE * g[i];
+    }
+}
+
+// See gelu_derivative in simd_impl.hpp
+void gelu_backward_n(
+    const float* g, const float* x, const float* y, float* out, size_t n
+) {
+    for (size_t i = 0; i < n; ++i) {
+        float s = std::fabs(x[i]) < 1e-3f ? 0.5f + 0.25f * GELU_C1 * x[i]
+                                           : y[i] / x[i];
+        float d = s + x[i] * s * (1.0f - s) *
+                          (GELU_C1 + 3.0f * GELU_C2 * x[i] * x[i]);
+        out[i] = g[i] * d;
+    }
+}
+
+void to_bf16_n(const float* x, uint16_t* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = precision::to_bf16(x[i]);
+    }
+}
+
+void from_bf16_n(const uint16_t* x, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = precision::from_bf16(x[i]);
+    }
+}
+
+void to_fp16_n(const float* x, uint16_t* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = precision::to_fp16(x[i]);
+    }
+}
+
+void from_fp16_n(const uint16_t* x, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = precision::from_fp16(x[i]);
+    }
+}
+
+void to_u7_n(
+    const float* x, float inverse, float zero, uint8_t* out, size_t n
+) {
+    for (size_t i = 0; i < n; ++i) {
+        float v = x[i] * inverse + zero;
+        v = v > 0.0f ? v : 0.0f;
+        v = v < 127.0f ? v : 127.0f;
+        out[i] = static_cast<uint8_t>(v + 0.5f);
+    }
+}
+
+void momentum_update_n(
+    float* w, float* m, float*, const float* g, const Update& u, size_t n
+) {
+    float keep = 1.0f - u.decay;
+    for (size_t i = 0; i < n; ++i) {
+        float grad = g[i] * u.grad_scale;
+        m[i] = u.beta1 * m[i] + grad;
+        w[i] = w[i] * keep - u.learning_rate * m[i];
+    }
+}
+
+void nesterov_update_n(
+    float* w, float* m, float*, const float* g, const Update& u, size_t n
+) {
+    float keep = 1.0f - u.decay;
+    for (size_t i = 0; i < n; ++i) {
+        float grad = g[i] * u.grad_scale;
+        m[i] = u.beta1 * m[i] + grad;
+        w[i] = w[i] * keep - u.learning_rate * (grad + u.beta1 * m[i]);
+    }
+}
+
+void rmsprop_update_n(
+    float* w, float*, float* v, const float* g, const Update& u, size_t n
+) {
+    float keep = 1.0f - u.decay;
+    for (size_t i = 0; i < n; ++i) {
+        float grad = g[i] * u.grad_scale;
+        v[i] = u.beta2 * v[i] + (1.0f - u.beta2) * grad * grad;
+        w[i] = w[i] * keep -
+               u.learning_rate * grad / (std::sqrt(v[i]) + u.epsilon);
+    }
+}
+
+void adam_update_n(
+    float* w, float* m, float* v, const float* g, const Update& u, size_t n
+) {
+    float keep = 1.0f - u.decay;
+    for (size_t i = 0; i < n; ++i) {
+        float grad = g[i] * u.grad_scale;
+        m[i] = u.beta1 * m[i] + (1.0f - u.beta1) * grad;
+        v[i] = u.beta2 * v[i] + (1.0f - u.beta2) * grad * grad;
+        w[i] = w[i] * keep -
+               u.learning_rate * m[i] / (std::sqrt(v[i]) + u.epsilon);
+    }
+}
+
+void gemm_u8s8_n(
+    size_t m,
+    size_t n,
+    size_t k,
+    const uint8_t* A,
+    size_t lda,
+    const int8_t* B,
+    size_t ldb,
+    int32_t* C,
+    size_t ldc
+) {
+    for (size_t i = 0; i < m; ++i) {
+        const uint8_t* a = A + i * lda;
+        for (size_t j = 0; j < n; ++j) {
+            const int8_t* b = B + j * ldb;
+            int32_t sum = 0;
+            for (size_t p = 0; p < k; ++p) {
+                sum += static_cast<int32_t>(a[p]) * b[p];
+            }
+            C[i * ldc + j] = sum;
+        }
+    }
+}
+
+const Kernels scalar_kernels = {
+    add_n,
+    sub_n,
+    mul_n,
+    axpy_n,
+    scale_n,
+    sigmoid_n,
+    sigmoid_derivative_n,
+    mul_sigmoid_derivative_n,
+    exp_n,
+    tanh_n,
+    relu_n,
+    leaky_relu_n,
+    gelu_n,
+    sigmoid_backward_n,
+    tanh_backward_n,
+    relu_backward_n,
+    leaky_relu_backward_n,
+    gelu_backward_n,
+    to_bf16_n,
+    from_bf16_n,
+    to_fp16_n,
+    from_fp16_n,
+    to_u7_n,
+    momentum_update_n,
+    nesterov_update_n,
+    rmsprop_update_n,
+    adam_update_n,
+    gemm_u8s8_n,
+};
+
+bool supported(Isa isa) {
+#if defined(__x86_64__) || defined(__i386__)
+    switch (isa) {
+        case Isa::Scalar:
+            return true;
+        case Isa::SSE42:
+            return __builtin_cpu_supports("sse4.2");
+        case Isa::AVX2:
+            return __builtin_cpu_supports("avx2") &&
+                   __builtin_cpu_supports("fma");
+        case Isa::AVX512:
+            return __builtin_cpu_supports("avx512f");
+    }
+    return false;
+#else
+    return isa == Isa::Scalar;
+#endif
+}
+
+const Kernels* table(Isa isa) {
+#if defined(__x86_64__) || defined(__i386__)
+    switch (isa) {
+        case Isa::Scalar:
+            return &scalar_kernels;
+        case Isa::SSE42:
+            return &sse42_kernels;
+        case Isa::AVX2:
+            return &avx2_kernels;
+        case Isa::AVX512:
+            return &avx512_kernels;
+    }
+#endif
+    return &scalar_kernels;
+}
+
+Isa initial_isa() {
+    const char* env = std::getenv("NNPP_SIMD");
+    if (env != nullptr) {
+        std::string name(env);
+        for (Isa isa : {Isa::Scalar, Isa::SSE42, Isa::AVX2, Isa::AVX512}) {
+            if (name == isa_name(isa) && supported(isa)) {
+                return isa;
+            }
+        }
+    }
+    return detected_isa();
+}
+
+struct Dispatch {
+    std::atomic<Isa> isa;
+    std::atomic<const Kernels*> kernels;
+
+    Dispatch() : isa(initial_isa()), kernels(table(isa.load())) {}
+};
+
+Dispatch& dispatch() {
+    static Dispatch d;
+    return d;
+}
+
+const Kernels& active() {
+    return *dispatch().kernels.load(std::memory_order_relaxed);
+}
+
+}  // namespace
+
+Isa detected_isa() {
+    for (Isa isa : {Isa::AVX512, Isa::AVX2, Isa::SSE42}) {
+        if (supported(isa)) {
+            return isa;
+        }
+    }
+    return Isa::Scalar;
+}
+
+Isa active_isa() { return dispatch().isa.load(); }
+
+void set_isa(Isa isa) {
+    if (!supported(isa)) {
+        throw std::invalid_argument(
+            std::string("SIMD level not supported by this CPU: ") +
+            isa_name(isa)
+        );
+    }
+    dispatch().isa.store(isa);
+    dispatch().kernels.store(table(isa));
+}
+
+const char* isa_name(Isa isa) {
+    switch (isa) {
+        case Isa::Scalar:
+            return "scalar";
+        case Isa::SSE42:
+            return "sse4.2";
+        case Isa::AVX2:
+            return "avx2";
+        case Isa::AVX512:
+            return "avx512";
+    }
+    return "unknown";
+}
+
+void add(const float* a, const float* b, float* out, size_t n) {
+    active().add(a, b, out, n);
+}
+
+void sub(const float* a, const float* b, float* out, size_t n) {
+    active().sub(a, b, out, n);
+}
+
+void mul(const float* a, const float* b, float* out, size_t n) {
+    active().mul(a, b, out, n);
+}
+
+void axpy(const float* a, const float* b, float alpha, float* out, size_t n) {
+    active().axpy(a, b, alpha, out, n);
+}
+
+void scale(const float* x, float s, float* out, size_t n) {
+    active().scale(x, s, out, n);
+}
+
+void sigmoid(const float* x, float* out, size_t n) {
+    active().sigmoid(x, out, n);
+}
+
+void sigmoid_derivative(const float* x, float* out, size_t n) {
+    active().sigmoid_derivative(x, out, n);
+}
+
+void mul_sigmoid_derivative(
+    const float* g, const float* x, float* out, size_t n
+) {
+    active().mul_sigmoid_derivative(g, x, out, n);
+}
+
+void exp(const float* x, float* out, size_t n) { active().exp(x, out, n); }
+
+void tanh(const float* x, float* out, size_t n) { active().tanh(x, out, n); }
+
+void relu(const float* x, float* out, size_t n) { active().relu(x, out, n); }
+
+void leaky_relu(const float* x, float* out, size_t n) {
+    active().leaky_relu(x, out, n);
+}
+
+void gelu(const float* x, float* out, size_t n) { active().gelu(x, out, n); }
+
+void sigmoid_backward(const float* g, const float* y, float* out, size_t n) {
+    active().sigmoid_backward(g, y, out, n);
+}
+
+void tanh_backward(const float* g, const float* y, float* out, size_t n) {
+    active().tanh_backward(g, y, out, n);
+}
+
+void relu_backward(const float* g, const float* y, float* out, size_t n) {
+    active().relu_backward(g, y, out, n);
+}
+
+void leaky_relu_backward(
+    const float* g, const float* y, float* out, size_t n
+) {
+    active().leaky_relu_backward(g, y, out, n);
+}
+
+void gelu_backward(
+    const float* g, const float* x, const float* y, float* out, size_t n
+) {
+    active().gelu_backward(g, x, y, out, n);
+}
+
+void to_bf16(const float* x, uint16_t* out, size_t n) {
+    active().to_bf16(x, out, n);
+}
+
+void from_bf16(const uint16_t* x, float* out, size_t n) {
+    active().from_bf16(x, out, n);
+}
+
+void to_fp16(const float* x, uint16_t* out, size_t n) {
+    active().to_fp16(x, out, n);
+}
+
+void from_fp16(const uint16_t* x, float* out, size_t n) {
+    active().from_fp16(x, out, n);
+}
+
+void to_u7(
+    const float* x, float inverse, float zero, uint8_t* out, size_t n
+) {
+    active().to_u7(x, inverse, zero, out, n);
+}
+
+void momentum_update(
+    float* w, float* m, float* v, const float* g, const Update& u, size_t n
+) {
+    active().momentum_update(w, m, v, g, u, n);
+}
+
+void nesterov_update(
+    float* w, float* m, float* v, const float* g, const Update& u, size_t n
+) {
+    active().nesterov_update(w, m, v, g, u, n);
+}
+
+void rmsprop_update(
+    float* w, float* m, float* v, const float* g, const Update& u, size_t n
+) {
+    active().rmsprop_update(w, m, v, g, u, n);
+}
+
+void adam_update(
+    float* w, float* m, float* v, const float* g, const Update& u, size_t n
+) {
+    active().adam_update(w, m, v, g, u, n);
+}
+
+void gemm_u8s8(
+    size_t m,
+    size_t n,
+    size_t k,
+    const uint8_t* A,
+    size_t lda,
+    const int8_t* B,
+    size_t ldb,
+    int32_t* C,
+    size_t ldc
+) {
+    active().gemm_u8s8(m, n, k, A, lda, B, ldb, C, ldc);
+}
+
+}  // namespace simd
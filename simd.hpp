@@ -0,0 +1,225 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace simd {
+
+// Instruction set levels with a dedicated kernel implementation.
+enum class Isa { Scalar, SSE42, AVX2, AVX512 };
+
+// Best level supported by this CPU, detected through CPUID.
+Isa detected_isa();
+
+// Level the kernels currently dispatch to. Defaults to detected_isa(), or to
+// the NNPP_SIMD environment variable (scalar, sse4.2, avx2, avx512) if set.
+Isa active_isa();
+
+// Forces the kernels onto a level, e.g. to compare paths in tests.
+// Throws std::invalid_argument if the CPU does not support it.
+void set_isa(Isa isa);
+
+const char* isa_name(Isa isa);
+
+// Elementwise kernels over n floats. out may alias any input.
+
+// out = a + b
+void add(const float* a, const float* b, float* out, size_t n);
+// out = a - b
+void sub(const float* a, const float* b, float* out, size_t n);
+// out = a * b
+void mul(const float* a, const float* b, float* out, size_t n);
+// out = a + alpha * b
+void axpy(const float* a, const float* b, float alpha, float* out, size_t n);
+// out = x * s
+void scale(const float* x, float s, float* out, size_t n);
+// out = 1 / (1 + exp(-x))
+void sigmoid(const float* x, float* out, size_t n);
+// out = sigmoid(x) * (1 - sigmoid(x))
+void sigmoid_derivative(const float* x, float* out, size_t n);
+// out = g * sigmoid_derivative(x)
+void mul_sigmoid_derivative(
+    const float* g, const float* x, float* out, size_t n
+);
+
+// Slope of leaky_relu for negative inputs
+constexpr float LEAKY_RELU_SLOPE = 0.01f;
+
+// out = exp(x), within a few ulp of std::exp; clamped to the float range
+void exp(const float* x, float* out, size_t n);
+// out = tanh(x), within 1e-6 of std::tanh
+void tanh(const float* x, float* out, size_t n);
+// out = max(x, 0)
+void relu(const float* x, float* out, size_t n);
+// out = x > 0 ? x : LEAKY_RELU_SLOPE * x
+void leaky_relu(const float* x, float* out, size_t n);
+// out = x * sigmoid(sqrt(8 / pi) * (x + 0.044715 * x^3)), the tanh
+// approximation of GELU, within 5e-4 of x * Phi(x)
+void gelu(const float* x, float* out, size_t n);
+
+// Backward kernels: out = g * f'(x), computed from the output y = f(x) that
+// the forward pass already stored, so they make no transcendental calls.
+
+// out = g * y * (1 - y)
+void sigmoid_backward(const float* g, const float* y, float* out, size_t n);
+// out = g * (1 - y^2)
+void tanh_backward(const float* g, const float* y, float* out, size_t n);
+// out = y > 0 ? g : 0
+void relu_backward(const float* g, const float* y, float* out, size_t n);
+// out = y > 0 ? g : LEAKY_RELU_SLOPE * g
+void leaky_relu_backward(
+    const float* g, const float* y, float* out, size_t n
+);
+// out = g * gelu'(x). GELU cannot be inverted, so this also reads the input;
+// the sigmoid factor is recovered as y / x.
+void gelu_backward(
+    const float* g, const float* x, const float* y, float* out, size_t n
+);
+
+// Conversions between fp32 and 16-bit storage formats, rounding like the
+// scalar conversions of precision.hpp and bitwise identical to them.
+void to_bf16(const float* x, uint16_t* out, size_t n);
+void from_bf16(const uint16_t* x, float* out, size_t n);
+void to_fp16(const float* x, uint16_t* out, size_t n);
+void from_fp16(const uint16_t* x, float* out, size_t n);
+
+// out = x * inverse + zero rounded to the nearest integer and clamped to
+// [0, 127], the 7-bit codes of quantized activations. NaN gives 0.
+void to_u7(const float* x, float inverse, float zero, uint8_t* out, size_t n);
+
+// Integer product for quantized inference: C[i][j] = sum_p A[i][p] * B[j][p]
+// for an m x k A of unsigned values and an n x k B of signed ones, both
+// row-major with row strides lda and ldb, into the m x n int32 C. Values of
+// A must not exceed 127: vpmaddubsw sums pairs of products in 16 bits, and
+// 7-bit inputs keep those sums from saturating, so every level returns the
+// same results. On the AVX-512 level, CPUs with AVX512-VNNI use vpdpbusd.
+void gemm_u8s8(
+    size_t m,
+    size_t n,
+    size_t k,
+    const uint8_t* A,
+    size_t lda,
+    const int8_t* B,
+    size_t ldb,
+    int32_t* C,
+    size_t ldc
+);
+
+// Coefficients of one fused optimizer update. Gradients are multiplied by
+// grad_scale first, e.g. 1 / n for sums over n samples, and the weights are
+// shrunk by the fraction decay (decoupled weight decay) before the step.
+struct Update {
+    float grad_scale = 1.0f;
+    float learning_rate = 0.0f;
+    // Decay of the first moment (velocity) and of the second moment
+    float beta1 = 0.0f;
+    float beta2 = 0.0f;
+    float epsilon = 0.0f;
+    float decay = 0.0f;
+};
+
+// Optimizer updates of n weights w from their gradients g, each one pass that
+// updates w and its state in place; m holds the first moment (or velocity)
+// and v the second, and a rule that keeps only one of them takes nullptr for
+// the other. With g' = g * grad_scale and w' = w * (1 - decay):
+
+// m = beta1 * m + g'; w = w' - learning_rate * m
+void momentum_update(
+    float* w, float* m, float* v, const float* g, const Update& u, size_t n
+);
+// m = beta1 * m + g'; w = w' - learning_rate * (g' + beta1 * m)
+void nesterov_update(
+    float* w, float* m, float* v, const float* g, const Update& u, size_t n
+);
+// v = beta2 * v + (1 - beta2) * g'^2;
+// w = w' - learning_rate * g' / (sqrt(v) + epsilon)
+void rmsprop_update(
+    float* w, float* m, float* v, const float* g, const Update& u, size_t n
+);
+// m = beta1 * m + (1 - beta1) * g'; v = beta2 * v + (1 - beta2) * g'^2;
+// w = w' - learning_rate * m / (sqrt(v) + epsilon), with Adam's bias
+// correction folded into learning_rate and epsilon by the caller
+void adam_update(
+    float* w, float* m, float* v, const float* g, const Update& u, size_t n
+);
+
+// Scalar versions, matching the kernels up to rounding.
+float sigmoid(float x);
+float sigmoid_derivative(float x);
+float gelu(float x);
+
+// Function objects for Matrix::apply and Matrix::elementwise_into. Besides
+// the per-element call they expose a call over whole buffers, which Matrix
+// picks up to run the vectorized kernel instead of a scalar loop.
+
+struct Sigmoid {
+    float operator()(float x) const { return sigmoid(x); }
+    void operator()(const float* x, float* out, size_t n) const {
+        sigmoid(x, out, n);
+    }
+};
+
+struct SigmoidDerivative {
+    float operator()(float x) const { return sigmoid_derivative(x); }
+    void operator()(const float* x, float* out, size_t n) const {
+        sigmoid_derivative(x, out, n);
+    }
+};
+
+struct Scale {
+    float s;
+    float operator()(float x) const { return x * s; }
+    void operator()(const float* x, float* out, size_t n) const {
+        scale(x, s, out, n);
+    }
+};
+
+struct Add {
+    float operator()(float a, float b) const { return a + b; }
+    void operator()(const float* a, const float* b, float* out, size_t n)
+        const {
+        add(a, b, out, n);
+    }
+};
+
+struct Sub {
+    float operator()(float a, float b) const { return a - b; }
+    void operator()(const float* a, const float* b, float* out, size_t n)
+        const {
+        sub(a, b, out, n);
+    }
+};
+
+struct Mul {
+    float operator()(float a, float b) const { return a * b; }
+    void operator()(const float* a, const float* b, float* out, size_t n)
+        const {
+        mul(a, b, out, n);
+    }
+};
+
+// a + alpha * b, e.g. an SGD step with alpha = -learning_rate
+struct Axpy {
+    float alpha;
+    float operator()(float a, float b) const { return a + alpha * b; }
+    void operator()(const float* a, const float* b, float* out, size_t n)
+        const {
+        axpy(a, b, alpha, out, n);
+    }
+};
+
+// g * sigmoid_derivative(x), the backpropagated error through a sigmoid
+struct MulSigmoidDerivative {
+    float operator()(float g, float x) const {
+        return g * sigmoid_derivative(x);
+    }
+    void operator()(const float* g, const float* x, float* out, size_t n)
+        const {
+        mul_sigmoid_derivative(g, x, out, n);
+    }
+};
+
+}  // namespace simd
+
+#endif  // SIMD_HPP
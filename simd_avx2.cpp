@@ -0,0 +1,9 @@
+// Elementwise kernels for AVX2 and FMA, see simd_impl.hpp.
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define SIMD_WIDTH 8
+#define SIMD_TABLE avx2_kernels
+#include "simd_impl.hpp"
+
+#endif
@@ -0,0 +1,9 @@
+// Elementwise kernels for AVX-512F, see simd_impl.hpp.
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define SIMD_WIDTH 16
+#define SIMD_TABLE avx512_kernels
+#include "simd_impl.hpp"
+
+#endif
@@ -0,0 +1,717 @@
+// Generic elementwise kernels written against GCC vector extensions.
+//
+// Included once per ISA level by simd_<isa>.cpp after defining SIMD_WIDTH
+// (floats per register) and SIMD_TABLE (name of the Kernels table to
+// define). Each includer is compiled with its own -m flags, so the same code
+// is lowered to SSE, AVX2 or AVX-512 instructions.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "precision.hpp"
+#include "simd.hpp"
+#include "simd_kernels.hpp"
+
+namespace simd {
+
+namespace {
+
+constexpr size_t W = SIMD_WIDTH;
+
+// Declared with 4-byte alignment so that dereferences are unaligned loads.
+typedef float vf __attribute__((vector_size(W * 4), aligned(4)));
+typedef int32_t vi __attribute__((vector_size(W * 4), aligned(4)));
+typedef uint32_t vu __attribute__((vector_size(W * 4), aligned(4)));
+typedef uint16_t vh __attribute__((vector_size(W * 2), aligned(2)));
+typedef uint8_t vb __attribute__((vector_size(W), aligned(1)));
+
+inline vf load(const float* p) { return *reinterpret_cast<const vf*>(p); }
+
+inline void store(float* p, vf v) { *reinterpret_cast<vf*>(p) = v; }
+
+inline vf splat(float x) { return vf{} + x; }
+
+// Lanes of a where mask is set, lanes of b elsewhere.
+inline vf select(vi mask, vf a, vf b) {
+    return reinterpret_cast<vf>(
+        (mask & reinterpret_cast<vi>(a)) | (~mask & reinterpret_cast<vi>(b))
+    );
+}
+
+inline vf abs(vf x) {
+    return reinterpret_cast<vf>(reinterpret_cast<vi>(x) & 0x7fffffff);
+}
+
+inline vf sqrt(vf x) {
+#if SIMD_WIDTH == 16 && defined(__AVX512F__)
+    // The masked form, as GCC warns about the undefined passthrough of
+    // _mm512_sqrt_ps
+    auto r = _mm512_maskz_sqrt_ps(0xffff, reinterpret_cast<__m512>(x));
+    return reinterpret_cast<vf>(r);
+#elif SIMD_WIDTH == 8 && defined(__AVX__)
+    return reinterpret_cast<vf>(_mm256_sqrt_ps(reinterpret_cast<__m256>(x)));
+#elif SIMD_WIDTH == 4 && defined(__SSE__)
+    return reinterpret_cast<vf>(_mm_sqrt_ps(reinterpret_cast<__m128>(x)));
+#else
+    for (size_t i = 0; i < W; ++i) {
+        x[i] = __builtin_sqrtf(x[i]);
+    }
+    return x;
+#endif
+}
+
+// Cephes-style expf: range reduction to [-ln2/2, ln2/2], a degree 5
+// polynomial and scaling by 2^n through the exponent bits. Relative error is
+// within a few ulp over the clamped range.
+inline vf exp(vf x) {
+    x = select(x > 88.3762626647949f, splat(88.3762626647949f), x);
+    x = select(x < -87.3365447505531f, splat(-87.3365447505531f), x);
+
+    // n = floor(x * log2(e) + 0.5)
+    vf fx = x * 1.44269504088896341f + 0.5f;
+    vf n = __builtin_convertvector(__builtin_convertvector(fx, vi), vf);
+    n = select(n > fx, n - 1.0f, n);
+
+    x = x - n * 0.693359375f;
+    x = x - n * -2.12194440e-4f;
+
+    vf y = splat(1.9875691500e-4f);
+    y = y * x + 1.3981999507e-3f;
+    y = y * x + 8.3334519073e-3f;
+    y = y * x + 4.1665795894e-2f;
+    y = y * x + 1.6666665459e-1f;
+    y = y * x + 5.0000001201e-1f;
+    y = y * x * x + x + 1.0f;
+
+    vi bits = (__builtin_convertvector(n, vi) + 127) << 23;
+    return y * reinterpret_cast<vf>(bits);
+}
+
+// Evaluated on exp(-|x|) so it cannot overflow for large |x|.
+inline vf sigmoid(vf x) {
+    vf e = exp(-abs(x));
+    vf r = 1.0f / (1.0f + e);
+    return select(x >= 0.0f, r, e * r);
+}
+
+inline vf sigmoid_derivative(vf x) {
+    vf e = exp(-abs(x));
+    vf r = 1.0f / (1.0f + e);
+    return e * r * r;
+}
+
+// Cephes-style tanhf: an odd polynomial near zero, where 1 - exp(-2|x|)
+// would cancel, and (1 - e) / (1 + e) on exp(-2|x|) elsewhere, which cannot
+// overflow.
+inline vf tanh(vf x) {
+    vf z = x * x;
+    vf p = splat(-5.70498872745e-3f);
+    p = p * z + 2.06390887954e-2f;
+    p = p * z - 5.37397155531e-2f;
+    p = p * z + 1.33314422036e-1f;
+    p = p * z - 3.33332819422e-1f;
+    vf small = p * z * x + x;
+
+    vf e = exp(-2.0f * abs(x));
+    vf large = (1.0f - e) / (1.0f + e);
+    large = select(x < 0.0f, -large, large);
+    return select(abs(x) < 0.625f, small, large);
+}
+
+// GELU constants: sqrt(8 / pi) and sqrt(8 / pi) * 0.044715
+constexpr float GELU_C1 = 1.5957691216057308f;
+constexpr float GELU_C2 = 0.0713548162726009f;
+
+// x * sigmoid(2u) equals 0.5 * x * (1 + tanh(u)) and stays finite. Far
+// below zero the result is flushed to 0 so that -inf does not give NaN.
+inline vf gelu(vf x) {
+    vf r = x * sigmoid(x * (GELU_C1 + GELU_C2 * x * x));
+    return select(x < -20.0f, splat(0.0f), r);
+}
+
+// With s = y / x = sigmoid(v) and v = x * (C1 + C2 x^2),
+// gelu'(x) = s + x * s * (1 - s) * (C1 + 3 C2 x^2). Near zero y / x loses
+// precision, so s is taken from the first terms of its series instead.
+inline vf gelu_derivative(vf x, vf y) {
+    vf s = select(
+        abs(x) < 1e-3f, 0.5f + (0.25f * GELU_C1) * x, y / x
+    );
+    return s + x * s * (1.0f - s) * (GELU_C1 + (3.0f * GELU_C2) * x * x);
+}
+
+// Runs op over full registers, then over the zero-padded remainder so that
+// the tail gets the same rounding as the body.
+template <typename Op>
+inline void unary(const float* x, float* out, size_t n, Op op) {
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        store(out + i, op(load(x + i)));
+    }
+    if (i < n) {
+        float buf[W] = {};
+        std::memcpy(buf, x + i, (n - i) * sizeof(float));
+        vf r = op(load(buf));
+        std::memcpy(out + i, &r, (n - i) * sizeof(float));
+    }
+}
+
+template <typename Op>
+inline void binary(const float* a, const float* b, float* out, size_t n, Op op) {
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        store(out + i, op(load(a + i), load(b + i)));
+    }
+    if (i < n) {
+        float buf_a[W] = {};
+        float buf_b[W] = {};
+        std::memcpy(buf_a, a + i, (n - i) * sizeof(float));
+        std::memcpy(buf_b, b + i, (n - i) * sizeof(float));
+        vf r = op(load(buf_a), load(buf_b));
+        std::memcpy(out + i, &r, (n - i) * sizeof(float));
+    }
+}
+
+void add_n(const float* a, const float* b, float* out, size_t n) {
+    binary(a, b, out, n, [](vf x, vf y) { return x + y; });
+}
+
+void sub_n(const float* a, const float* b, float* out, size_t n) {
+    binary(a, b, out, n, [](vf x, vf y) { return x - y; });
+}
+
+void mul_n(const float* a, const float* b, float* out, size_t n) {
+    binary(a, b, out, n, [](vf x, vf y) { return x * y; });
+}
+
+void axpy_n(const float* a, const float* b, float alpha, float* out, size_t n) {
+    binary(a, b, out, n, [alpha](vf x, vf y) { return x + alpha * y; });
+}
+
+void scale_n(const float* x, float s, float* out, size_t n) {
+    unary(x, out, n, [s](vf v) { return v * s; });
+}
+
+void sigmoid_n(const float* x, float* out, size_t n) {
+    unary(x, out, n, [](vf v) { return sigmoid(v); });
+}
+
+void sigmoid_derivative_n(const float* x, float* out, size_t n) {
+    unary(x, out, n, [](vf v) { return sigmoid_derivative(v); });
+}
+
+void mul_sigmoid_derivative_n(
+    const float* g, const float* x, float* out, size_t n
+) {
+    binary(g, x, out, n, [](vf a, vf v) { return a * sigmoid_derivative(v); });
+}
+
+template <typename Op>
+inline void ternary(
+    const float* a, const float* b, const float* c, float* out, size_t n, Op op
+) {
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        store(out + i, op(load(a + i), load(b + i), load(c + i)));
+    }
+    if (i < n) {
+        float buf_a[W] = {};
+        float buf_b[W] = {};
+        float buf_c[W] = {};
+        std::memcpy(buf_a, a + i, (n - i) * sizeof(float));
+        std::memcpy(buf_b, b + i, (n - i) * sizeof(float));
+        std::memcpy(buf_c, c + i, (n - i) * sizeof(float));
+        vf r = op(load(buf_a), load(buf_b), load(buf_c));
+        std::memcpy(out + i, &r, (n - i) * sizeof(float));
+    }
+}
+
+void exp_n(const float* x, float* out, size_t n) {
+    unary(x, out, n, [](vf v) { return exp(v); });
+}
+
+void tanh_n(const float* x, float* out, size_t n) {
+    unary(x, out, n, [](vf v) { return tanh(v); });
+}
+
+void relu_n(const float* x, float* out, size_t n) {
+    unary(x, out, n, [](vf v) { return select(v > 0.0f, v, splat(0.0f)); });
+}
+
+void leaky_relu_n(const float* x, float* out, size_t n) {
+    unary(x, out, n, [](vf v) {
+        return select(v > 0.0f, v, LEAKY_RELU_SLOPE * v);
+    });
+}
+
+void gelu_n(const float* x, float* out, size_t n) {
+    unary(x, out, n, [](vf v) { return gelu(v); });
+}
+
+void sigmoid_backward_n(const float* g, const float* y, float* out, size_t n) {
+    binary(g, y, out, n, [](vf a, vf v) { return a * v * (1.0f - v); });
+}
+
+void tanh_backward_n(const float* g, const float* y, float* out, size_t n) {
+    binary(g, y, out, n, [](vf a, vf v) { return a * (1.0f - v * v); });
+}
+
+void relu_backward_n(const float* g, const float* y, float* out, size_t n) {
+    binary(g, y, out, n, [](vf a, vf v) {
+        return select(v > 0.0f, a, splat(0.0f));
+    });
+}
+
+void leaky_relu_backward_n(
+    const float* g, const float* y, float* out, size_t n
+) {
+    binary(g, y, out, n, [](vf a, vf v) {
+        return select(v > 0.0f, a, LEAKY_RELU_SLOPE * a);
+    });
+}
+
+void gelu_backward_n(
+    const float* g, const float* x, const float* y, float* out, size_t n
+) {
+    ternary(g, x, y, out, n, [](vf a, vf u, vf v) {
+        return a * gelu_derivative(u, v);
+    });
+}
+
+// The conversions below are the scalar ones of precision.hpp written on
+// whole registers; the tails use the scalar ones directly.
+
+inline vu select(vi mask, vu a, vu b) { return (mask & a) | (~mask & b); }
+
+inline vu bits_of(vf x) { return reinterpret_cast<vu>(x); }
+
+inline vf float_of(vu x) { return reinterpret_cast<vf>(x); }
+
+void to_bf16_n(const float* x, uint16_t* out, size_t n) {
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        vu bits = bits_of(load(x + i));
+        vu rounded = (bits + 0x7fff + ((bits >> 16) & 1)) >> 16;
+        vu nan = (bits >> 16) | 0x40;
+        vu h = select((bits & 0x7fffffff) > 0x7f800000, nan, rounded);
+        *reinterpret_cast<vh*>(out + i) = __builtin_convertvector(h, vh);
+    }
+    for (; i < n; ++i) {
+        out[i] = precision::to_bf16(x[i]);
+    }
+}
+
+void from_bf16_n(const uint16_t* x, float* out, size_t n) {
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        vh h = *reinterpret_cast<const vh*>(x + i);
+        store(out + i, float_of(__builtin_convertvector(h, vu) << 16));
+    }
+    for (; i < n; ++i) {
+        out[i] = precision::from_bf16(x[i]);
+    }
+}
+
+void to_fp16_n(const float* x, uint16_t* out, size_t n) {
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        vu bits = bits_of(load(x + i));
+        vu twice = bits + bits;
+        vu sign = bits & 0x80000000;
+        vf base = (float_of(bits & 0x7fffffff) * 0x1.0p+112f) * 0x1.0p-110f;
+        vu bias = twice & 0xff000000;
+        bias = select(bias < 0x71000000, vu{} + 0x71000000, bias);
+        base = float_of((bias >> 1) + 0x07800000) + base;
+        vu rounded = bits_of(base);
+        vu magnitude = ((rounded >> 13) & 0x7c00) + (rounded & 0x0fff);
+        vu h = (sign >> 16) |
+               select(twice > 0xff000000, vu{} + 0x7e00, magnitude);
+        *reinterpret_cast<vh*>(out + i) = __builtin_convertvector(h, vh);
+    }
+    for (; i < n; ++i) {
+        out[i] = precision::to_fp16(x[i]);
+    }
+}
+
+void from_fp16_n(const uint16_t* x, float* out, size_t n) {
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        vu h = __builtin_convertvector(*reinterpret_cast<const vh*>(x + i), vu);
+        vu sign = (h & 0x8000) << 16;
+        vu rest = h & 0x7fff;
+        vf value = float_of(rest << 13) * 0x1.0p+112f;
+        vu bits = select(rest >= 0x7c00, (rest << 13) | 0x7f800000, bits_of(value));
+        store(out + i, float_of(bits | sign));
+    }
+    for (; i < n; ++i) {
+        out[i] = precision::from_fp16(x[i]);
+    }
+}
+
+void to_u7_n(
+    const float* x, float inverse, float zero, uint8_t* out, size_t n
+) {
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        vf v = load(x + i) * inverse + zero;
+        v = select(v > 0.0f, v, splat(0.0f));
+        v = select(v < 127.0f, v, splat(127.0f));
+        vi q = __builtin_convertvector(v + 0.5f, vi);
+        *reinterpret_cast<vb*>(out + i) = __builtin_convertvector(q, vb);
+    }
+    for (; i < n; ++i) {
+        float v = x[i] * inverse + zero;
+        v = v > 0.0f ? v : 0.0f;
+        v = v < 127.0f ? v : 127.0f;
+        out[i] = static_cast<uint8_t>(v + 0.5f);
+    }
+}
+
+// Runs op on one register of the weights, of the state buffers m and v and of
+// the gradients at a time, updating the first three in place; a null m or v
+// is neither read nor written. The remainder goes through zero-padded
+// buffers like unary.
+template <typename Op>
+inline void update(
+    float* w, float* m, float* v, const float* g, size_t n, Op op
+) {
+    auto apply = [&](float* pw, float* pm, float* pv, const float* pg) {
+        vf x = load(pw);
+        vf a = pm != nullptr ? load(pm) : vf{};
+        vf b = pv != nullptr ? load(pv) : vf{};
+        op(x, a, b, load(pg));
+        store(pw, x);
+        if (pm != nullptr) {
+            store(pm, a);
+        }
+        if (pv != nullptr) {
+            store(pv, b);
+        }
+    };
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        apply(
+            w + i,
+            m != nullptr ? m + i : nullptr,
+            v != nullptr ? v + i : nullptr,
+            g + i
+        );
+    }
+    if (i < n) {
+        size_t bytes = (n - i) * sizeof(float);
+        float buf_w[W] = {};
+        float buf_m[W] = {};
+        float buf_v[W] = {};
+        float buf_g[W] = {};
+        std::memcpy(buf_w, w + i, bytes);
+        std::memcpy(buf_g, g + i, bytes);
+        if (m != nullptr) {
+            std::memcpy(buf_m, m + i, bytes);
+        }
+        if (v != nullptr) {
+            std::memcpy(buf_v, v + i, bytes);
+        }
+        apply(
+            buf_w,
+            m != nullptr ? buf_m : nullptr,
+            v != nullptr ? buf_v : nullptr,
+            buf_g
+        );
+        std::memcpy(w + i, buf_w, bytes);
+        if (m != nullptr) {
+            std::memcpy(m + i, buf_m, bytes);
+        }
+        if (v != nullptr) {
+            std::memcpy(v + i, buf_v, bytes);
+        }
+    }
+}
+
+void momentum_update_n(
+    float* w, float* m, float*, const float* g, const Update& u, size_t n
+) {
+    float keep = 1.0f - u.decay;
+    update(w, m, nullptr, g, n, [&](vf& x, vf& a, vf&, vf grad) {
+        grad *= u.grad_scale;
+        a = u.beta1 * a + grad;
+        x = x * keep - u.learning_rate * a;
+    });
+}
+
+void nesterov_update_n(
+    float* w, float* m, float*, const float* g, const Update& u, size_t n
+) {
+    float keep = 1.0f - u.decay;
+    update(w, m, nullptr, g, n, [&](vf& x, vf& a, vf&, vf grad) {
+        grad *= u.grad_scale;
+        a = u.beta1 * a + grad;
+        x = x * keep - u.learning_rate * (grad + u.beta1 * a);
+    });
+}
+
+void rmsprop_update_n(
+    float* w, float*, float* v, const float* g, const Update& u, size_t n
+) {
+    float keep = 1.0f - u.decay;
+    update(w, nullptr, v, g, n, [&](vf& x, vf&, vf& b, vf grad) {
+        grad *= u.grad_scale;
+        b = u.beta2 * b + (1.0f - u.beta2) * grad * grad;
+        x = x * keep - u.learning_rate * grad / (sqrt(b) + u.epsilon);
+    });
+}
+
+void adam_update_n(
+    float* w, float* m, float* v, const float* g, const Update& u, size_t n
+) {
+    float keep = 1.0f - u.decay;
+    update(w, m, v, g, n, [&](vf& x, vf& a, vf& b, vf grad) {
+        grad *= u.grad_scale;
+        a = u.beta1 * a + (1.0f - u.beta1) * grad;
+        b = u.beta2 * b + (1.0f - u.beta2) * grad * grad;
+        x = x * keep - u.learning_rate * a / (sqrt(b) + u.epsilon);
+    });
+}
+
+// Integer kernel of gemm_u8s8. Each row of A is multiplied with four rows
+// of B at a time, so every load of A feeds four sums; past the last row of
+// B the final one is repeated and its sums dropped.
+
+#if defined(__SSSE3__)
+
+#if defined(__AVX2__)
+typedef __m256i vq;
+
+inline vq qzero() { return _mm256_setzero_si256(); }
+
+inline vq qload(const void* p) {
+    return _mm256_loadu_si256(static_cast<const vq*>(p));
+}
+
+// vpmaddubsw sums pairs of u8 * s8 products into 16 bits, vpmaddwd by ones
+// widens pairs of those into the int32 sums
+inline vq qdot(vq sum, vq a, vq b) {
+    vq pairs = _mm256_maddubs_epi16(a, b);
+    vq ones = _mm256_set1_epi16(1);
+    return _mm256_add_epi32(sum, _mm256_madd_epi16(pairs, ones));
+}
+
+// Halves folded into one 128-bit register with the same total
+inline __m128i qfold(vq v) {
+    return _mm_add_epi32(
+        _mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)
+    );
+}
+#else
+typedef __m128i vq;
+
+inline vq qzero() { return _mm_setzero_si128(); }
+
+inline vq qload(const void* p) {
+    return _mm_loadu_si128(static_cast<const vq*>(p));
+}
+
+inline vq qdot(vq sum, vq a, vq b) {
+    vq pairs = _mm_maddubs_epi16(a, b);
+    return _mm_add_epi32(sum, _mm_madd_epi16(pairs, _mm_set1_epi16(1)));
+}
+
+inline __m128i qfold(vq v) { return v; }
+#endif
+
+// Totals of four registers of int32 sums, in the lanes of one
+inline __m128i reduce4(__m128i s0, __m128i s1, __m128i s2, __m128i s3) {
+    return _mm_hadd_epi32(_mm_hadd_epi32(s0, s1), _mm_hadd_epi32(s2, s3));
+}
+
+void gemm_u8s8_maddubs(
+    size_t m,
+    size_t n,
+    size_t k,
+    const uint8_t* A,
+    size_t lda,
+    const int8_t* B,
+    size_t ldb,
+    int32_t* C,
+    size_t ldc
+) {
+    constexpr size_t Q = sizeof(vq);
+    for (size_t i = 0; i < m; ++i) {
+        const uint8_t* a = A + i * lda;
+        for (size_t j = 0; j < n; j += 4) {
+            const int8_t* b[4];
+            vq sum[4];
+            for (size_t r = 0; r < 4; ++r) {
+                b[r] = B + std::min(j + r, n - 1) * ldb;
+                sum[r] = qzero();
+            }
+            size_t p = 0;
+            for (; p + Q <= k; p += Q) {
+                vq x = qload(a + p);
+                for (size_t r = 0; r < 4; ++r) {
+                    sum[r] = qdot(sum[r], x, qload(b[r] + p));
+                }
+            }
+            alignas(16) int32_t totals[4];
+            __m128i folded = reduce4(
+                qfold(sum[0]), qfold(sum[1]), qfold(sum[2]), qfold(sum[3])
+            );
+            _mm_store_si128(reinterpret_cast<__m128i*>(totals), folded);
+            for (size_t r = 0; r < 4 && j + r < n; ++r) {
+                int32_t total = totals[r];
+                for (size_t q = p; q < k; ++q) {
+                    total += static_cast<int32_t>(a[q]) * b[r][q];
+                }
+                C[i * ldc + j + r] = total;
+            }
+        }
+    }
+}
+
+#endif
+
+#if SIMD_WIDTH == 16 && (defined(__x86_64__) || defined(__i386__))
+
+// AVX512-VNNI: vpdpbusd adds four u8 * s8 products straight into each int32
+// lane, and masked loads take the tail of every row. Only this file is built
+// for AVX-512, and only with -mavx512f, so the CPU is checked at run time.
+typedef int32_t v16si __attribute__((vector_size(64)));
+typedef int32_t v4si __attribute__((vector_size(16)));
+
+__attribute__((target("avx512bw,avx512vnni"))) void gemm_u8s8_vnni(
+    size_t m,
+    size_t n,
+    size_t k,
+    const uint8_t* A,
+    size_t lda,
+    const int8_t* B,
+    size_t ldb,
+    int32_t* C,
+    size_t ldc
+) {
+    __mmask64 tail = _cvtu64_mask64(k % 64 == 0 ? 0 : (1ull << (k % 64)) - 1);
+    for (size_t i = 0; i < m; ++i) {
+        const uint8_t* a = A + i * lda;
+        for (size_t j = 0; j < n; j += 4) {
+            const int8_t* b[4];
+            __m512i sum[4];
+            for (size_t r = 0; r < 4; ++r) {
+                b[r] = B + std::min(j + r, n - 1) * ldb;
+                sum[r] = _mm512_setzero_si512();
+            }
+            size_t p = 0;
+            for (; p + 64 <= k; p += 64) {
+                __m512i x = _mm512_loadu_si512(a + p);
+                for (size_t r = 0; r < 4; ++r) {
+                    sum[r] = _mm512_dpbusd_epi32(
+                        sum[r], x, _mm512_loadu_si512(b[r] + p)
+                    );
+                }
+            }
+            if (p < k) {
+                __m512i x = _mm512_maskz_loadu_epi8(tail, a + p);
+                for (size_t r = 0; r < 4; ++r) {
+                    sum[r] = _mm512_dpbusd_epi32(
+                        sum[r], x, _mm512_maskz_loadu_epi8(tail, b[r] + p)
+                    );
+                }
+            }
+            // Each register folded to 128 bits, then four at once
+            __m128i low[4];
+            for (size_t r = 0; r < 4; ++r) {
+                auto v = reinterpret_cast<v16si>(sum[r]);
+                v4si q = __builtin_shufflevector(v, v, 0, 1, 2, 3) +
+                         __builtin_shufflevector(v, v, 4, 5, 6, 7) +
+                         __builtin_shufflevector(v, v, 8, 9, 10, 11) +
+                         __builtin_shufflevector(v, v, 12, 13, 14, 15);
+                low[r] = reinterpret_cast<__m128i>(q);
+            }
+            __m128i totals = reduce4(low[0], low[1], low[2], low[3]);
+            if (j + 4 <= n) {
+                _mm_storeu_si128(
+                    reinterpret_cast<__m128i*>(C + i * ldc + j), totals
+                );
+                continue;
+            }
+            alignas(16) int32_t lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), totals);
+            for (size_t r = 0; j + r < n; ++r) {
+                C[i * ldc + j + r] = lanes[r];
+            }
+        }
+    }
+}
+
+#endif
+
+void gemm_u8s8_n(
+    size_t m,
+    size_t n,
+    size_t k,
+    const uint8_t* A,
+    size_t lda,
+    const int8_t* B,
+    size_t ldb,
+    int32_t* C,
+    size_t ldc
+) {
+#if SIMD_WIDTH == 16 && (defined(__x86_64__) || defined(__i386__))
+    static const bool vnni = __builtin_cpu_supports("avx512bw") &&
+                             __builtin_cpu_supports("avx512vnni");
+    if (vnni) {
+        gemm_u8s8_vnni(m, n, k, A, lda, B, ldb, C, ldc);
+        return;
+    }
+#endif
+#if defined(__SSSE3__)
+    gemm_u8s8_maddubs(m, n, k, A, lda, B, ldb, C, ldc);
+#else
+    for (size_t i = 0; i < m; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            int32_t sum = 0;
+            for (size_t p = 0; p < k; ++p) {
+                sum += static_cast<int32_t>(A[i * lda + p]) * B[j * ldb + p];
+            }
+            C[i * ldc + j] = sum;
+        }
+    }
+#endif
+}
+
+}  // namespace
+
+extern const Kernels SIMD_TABLE = {
+    add_n,
+    sub_n,
+    mul_n,
+    axpy_n,
+    scale_n,
+    sigmoid_n,
+    sigmoid_derivative_n,
+    mul_sigmoid_derivative_n,
+    exp_n,
+    tanh_n,
+    relu_n,
+    leaky_relu_n,
+    gelu_n,
+    sigmoid_backward_n,
+    tanh_backward_n,
+    relu_backward_n,
+    leaky_relu_backward_n,
+    gelu_backward_n,
+    to_bf16_n,
+    from_bf16_n,
+    to_fp16_n,
+    from_fp16_n,
+    to_u7_n,
+    momentum_update_n,
+    nesterov_update_n,
+    rmsprop_update_n,
+    adam_update_n,
+    gemm_u8s8_n,
+};
+
+}  // namespace simd
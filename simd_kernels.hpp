@@ -0,0 +1,77 @@
+#ifndef SIMD_KERNELS_HPP
+#define SIMD_KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "simd.hpp"
+
+// Internal to simd.cpp and the per-ISA translation units.
+
+namespace simd {
+
+// One implementation of every elementwise kernel for a given ISA level.
+struct Kernels {
+    void (*add)(const float*, const float*, float*, size_t);
+    void (*sub)(const float*, const float*, float*, size_t);
+    void (*mul)(const float*, const float*, float*, size_t);
+    void (*axpy)(const float*, const float*, float, float*, size_t);
+    void (*scale)(const float*, float, float*, size_t);
+    void (*sigmoid)(const float*, float*, size_t);
+    void (*sigmoid_derivative)(const float*, float*, size_t);
+    void (*mul_sigmoid_derivative)(
+        const float*, const float*, float*, size_t
+    );
+    void (*exp)(const float*, float*, size_t);
+    void (*tanh)(const float*, float*, size_t);
+    void (*relu)(const float*, float*, size_t);
+    void (*leaky_relu)(const float*, float*, size_t);
+    void (*gelu)(const float*, float*, size_t);
+    void (*sigmoid_backward)(const float*, const float*, float*, size_t);
+    void (*tanh_backward)(const float*, const float*, float*, size_t);
+    void (*relu_backward)(const float*, const float*, float*, size_t);
+    void (*leaky_relu_backward)(const float*, const float*, float*, size_t);
+    void (*gelu_backward)(
+        const float*, const float*, const float*, float*, size_t
+    );
+    void (*to_bf16)(const float*, uint16_t*, size_t);
+    void (*from_bf16)(const uint16_t*, float*, size_t);
+    void (*to_fp16)(const float*, uint16_t*, size_t);
+    void (*from_fp16)(const uint16_t*, float*, size_t);
+    void (*to_u7)(const float*, float, float, uint8_t*, size_t);
+    void (*momentum_update)(
+        float*, float*, float*, const float*, const Update&, size_t
+    );
+    void (*nesterov_update)(
+        float*, float*, float*, const float*, const Update&, size_t
+    );
+    void (*rmsprop_update)(
+        float*, float*, float*, const float*, const Update&, size_t
+    );
+    void (*adam_update)(
+        float*, float*, float*, const float*, const Update&, size_t
+    );
+    void (*gemm_u8s8)(
+        size_t,
+        size_t,
+        size_t,
+        const uint8_t*,
+        size_t,
+        const int8_t*,
+        size_t,
+        int32_t*,
+        size_t
+    );
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+// Defined in simd_sse42.cpp, simd_avx2.cpp and simd_avx512.cpp, each
+// compiled with the matching -m flags.
+extern const Kernels sse42_kernels;
+extern const Kernels avx2_kernels;
+extern const Kernels avx512_kernels;
+#endif
+
+}  // namespace simd
+
+#endif  // SIMD_KERNELS_HPP
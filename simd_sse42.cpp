@@ -0,0 +1,9 @@
+// Elementwise kernels for SSE4.2, see simd_impl.hpp.
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define SIMD_WIDTH 4
+#define SIMD_TABLE sse42_kernels
+#include "simd_impl.hpp"
+
+#endif
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <stdexcept>
+
+#include "activation.hpp"
+#include "matrix.hpp"
+#include "simd.hpp"
+#include "support.hpp"
+
+using namespace activation;
+using matrix::Matrix;
+using support::random_matrix;
+
+TEST(ActivationTest, ParseRoundTrips) {
+    for (Kind kind :
+         {Kind::Sigmoid, Kind::Tanh, Kind::ReLU, Kind::LeakyReLU, Kind::GELU,
+          Kind::Softmax}) {
+        EXPECT_EQ(parse(name(kind)), kind);
+    }
+    EXPECT_THROW(parse("swish"), std::invalid_argument);
+    EXPECT_EQ(kernel(Kind::Softmax), nullptr);
+    EXPECT_EQ(backward_kernel(Kind::GELU), nullptr);
+}
+
+// Columns are samples: each sums to one and matches exp(x) / sum(exp(x)) in
+// double precision, also past the 64-column chunks and for huge logits
+TEST(ActivationTest, SoftmaxNormalizesColumns) {
+    Matrix x = random_matrix(10, 70, 1, -20.0f, 20.0f);
+    x(3, 5) = 1000.0f;
+    x(4, 5) = -1000.0f;
+    Matrix y(10, 70);
+    softmax(x, y);
+    for (size_t j = 0; j < 70; ++j) {
+        double peak = -INFINITY;
+        for (size_t i = 0; i < 10; ++i) {
+            peak = std::max(peak, static_cast<double>(x(i, j)));
+        }
+        double sum = 0.0;
+        for (size_t i = 0; i < 10; ++i) {
+            sum += std::exp(x(i, j) - peak);
+        }
+        float total = 0.0f;
+        for (size_t i = 0; i < 10; ++i) {
+            ASSERT_FALSE(std::isnan(y(i, j)));
+            ASSERT_NEAR(y(i, j), std::exp(x(i, j) - peak) / sum, 1e-6);
+            total += y(i, j);
+        }
+        ASSERT_NEAR(total, 1.0f, 1e-5f);
+    }
+    EXPECT_FLOAT_EQ(y(3, 5), 1.0f);
+
+    // In place on a strided block
+    Matrix big = random_matrix(12, 9, 2, -3.0f, 3.0f);
+    auto block = big.view().block(1, 2, 10, 5);
+    Matrix expected(10, 5);
+    Matrix copy(10, 5, [&](size_t i, size_t j) { return block(i, j); });
+    softmax(copy, expected);
+    softmax(block, block);
+    for (size_t i = 0; i < 10; ++i) {
+        for (size_t j = 0; j < 5; ++j) {
+            EXPECT_FLOAT_EQ(block(i, j), expected(i, j));
+        }
+    }
+}
+
+// backward must agree with a central difference of forward for every kind
+TEST(ActivationTest, BackwardMatchesFiniteDifference) {
+    const size_t n = 6, m = 5;
+    for (Kind kind :
+         {Kind::Sigmoid, Kind::Tanh, Kind::LeakyReLU, Kind::GELU,
+          Kind::Softmax}) {
+        Matrix x = random_matrix(n, m, 3, -3.0f, 3.0f);
+        Matrix g = random_matrix(n, m, 4);
+        Matrix y(n, m), out(n, m);
+        forward(kind, x, y);
+        backward(kind, g, x, y, out);
+
+        // dL/dx_ij with L = sum(g * f(x))
+        const float h = 1e-2f;
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j < m; ++j) {
+                Matrix plus = x.cloned(), minus = x.cloned();
+                plus(i, j) += h;
+                minus(i, j) -= h;
+                Matrix yp(n, m), ym(n, m);
+                forward(kind, plus, yp);
+                forward(kind, minus, ym);
+                double numeric = 0.0;
+                for (size_t a = 0; a < n; ++a) {
+                    for (size_t b = 0; b < m; ++b) {
+                        numeric += g(a, b) * (yp(a, b) - ym(a, b));
+                    }
+                }
+                numeric /= 2.0 * h;
+                ASSERT_NEAR(out(i, j), numeric, 2e-3)
+                    << name(kind) << " at " << i << ", " << j;
+            }
+        }
+    }
+}
+
+// The fused combine kernels compute the same thing as backward
+TEST(ActivationTest, BackwardKernelMatchesBackward) {
+    for (Kind kind :
+         {Kind::Sigmoid, Kind::Tanh, Kind::ReLU, Kind::LeakyReLU}) {
+        Matrix x = random_matrix(7, 9, 5, -4.0f, 4.0f);
+        Matrix g = random_matrix(7, 9, 6);
+        Matrix y(7, 9), expected(7, 9), actual(7, 9);
+        forward(kind, x, y);
+        backward(kind, g, x, y, expected);
+        backward_kernel(kind)(
+            g.view().data, y.view().data, actual.view().data, 7 * 9
+        );
+        for (size_t i = 0; i < 7; ++i) {
+            for (size_t j = 0; j < 9; ++j) {
+                EXPECT_FLOAT_EQ(actual(i, j), expected(i, j)) << name(kind);
+            }
+        }
+    }
+}
+
+TEST(ActivationTest, DimensionMismatchError) {
+    Matrix x(3, 4), y(4, 3);
+    EXPECT_THROW(forward(Kind::ReLU, x, y), std::invalid_argument);
+    EXPECT_THROW(softmax(x, y), std::invalid_argument);
+}
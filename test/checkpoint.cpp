@@ -0,0 +1,271 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "checkpoint.hpp"
+#include "matrix.hpp"
+#include "memory.hpp"
+#include "network.hpp"
+#include "optimizer.hpp"
+#include "support.hpp"
+
+using matrix::Matrix;
+using network::Network;
+using support::random_matrix;
+using support::temp_path;
+
+static Network trained_network() {
+    Network net(
+        {12, 7, 5, 3}, 4, activation::Kind::Tanh, activation::Kind::Softmax, 2
+    );
+    Matrix input = random_matrix(4, 12, 1);
+    Matrix target(3, 4);
+    for (size_t b = 0; b < 4; ++b) {
+        target(b % 3, b) = 1.0f;
+    }
+    for (int step = 0; step < 3; ++step) {
+        net.forward(input);
+        net.backward(target);
+        net.step(0.1f);
+    }
+    return net;
+}
+
+TEST(CheckpointTest, RoundTrip) {
+    auto net = trained_network();
+    std::vector<float> momentum(net.parameters().size(), 0.25f);
+    std::span<const float> state[] = {momentum};
+    auto path = temp_path("nnpp_checkpoint_round_trip.bin");
+    checkpoint::save(path, net, {1234, 0.05f}, state);
+
+    checkpoint::Checkpoint saved(path);
+    EXPECT_EQ(saved.version(), checkpoint::VERSION);
+    EXPECT_EQ(saved.sizes(), net.sizes());
+    EXPECT_EQ(saved.depth(), 3u);
+    EXPECT_EQ(saved.hidden_activation(), activation::Kind::Tanh);
+    EXPECT_EQ(saved.output_activation(), activation::Kind::Softmax);
+    EXPECT_EQ(saved.progress().samples, 1234u);
+    EXPECT_EQ(saved.progress().learning_rate, 0.05f);
+    ASSERT_EQ(saved.state_count(), 1u);
+    EXPECT_EQ(saved.state(0)[7], 0.25f);
+    EXPECT_THROW(saved.state(1), std::out_of_range);
+
+    // Views into the mapping, aligned like the network's own blocks
+    for (size_t l = 0; l < net.depth(); ++l) {
+        auto weight = saved.weight(l);
+        auto address = reinterpret_cast<uintptr_t>(weight.data);
+        EXPECT_EQ(address % memory::ALIGNMENT, 0u);
+        ASSERT_EQ(weight.N, net.weight(l).N);
+        ASSERT_EQ(weight.M, net.weight(l).M);
+        for (size_t i = 0; i < weight.N; ++i) {
+            EXPECT_EQ(saved.bias(l)(i, 0), net.bias(l)(i, 0));
+            for (size_t j = 0; j < weight.M; ++j) {
+                EXPECT_EQ(weight(i, j), net.weight(l)(i, j));
+            }
+        }
+    }
+
+    // A restored network computes exactly what the saved one does
+    Matrix input = random_matrix(4, 12, 5);
+    auto expected = net.forward(input);
+    auto restored = saved.network(4);
+    auto output = restored.forward(input);
+    for (size_t i = 0; i < output.N; ++i) {
+        for (size_t j = 0; j < output.M; ++j) {
+            EXPECT_EQ(output(i, j), expected(i, j));
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+// Continuing from a checkpoint follows the run that was never interrupted
+TEST(CheckpointTest, ResumedTrainingMatches) {
+    Matrix input = random_matrix(4, 12, 1);
+    Matrix target(3, 4);
+    for (size_t b = 0; b < 4; ++b) {
+        target(b % 3, b) = 1.0f;
+    }
+    auto train = [&](Network& net, int steps) {
+        for (int step = 0; step < steps; ++step) {
+            net.forward(input);
+            net.backward(target);
+            net.step(0.1f);
+        }
+    };
+
+    Network straight({12, 8, 3}, 4);
+    train(straight, 10);
+
+    auto path = temp_path("nnpp_checkpoint_resume.bin");
+    Network first({12, 8, 3}, 4);
+    train(first, 4);
+    checkpoint::save(path, first);
+    Network resumed(
+        {12, 8, 3}, 4, activation::Kind::Sigmoid, activation::Kind::Sigmoid, 9
+    );
+    checkpoint::Checkpoint(path).restore(resumed);
+    train(resumed, 6);
+
+    auto a = straight.parameters();
+    auto b = resumed.parameters();
+    ASSERT_EQ(a.size(), b.size());
+    for (size_t i = 0; i < a.size(); ++i) {
+        ASSERT_EQ(a[i], b[i]) << i;
+    }
+
+    // Saving over an existing checkpoint replaces it
+    checkpoint::save(path, resumed, {40, 0.1f});
+    EXPECT_EQ(checkpoint::Checkpoint(path).progress().samples, 40u);
+    EXPECT_FALSE(std::filesystem::exists(path + ".tmp"));
+    std::filesystem::remove(path);
+}
+
+TEST(CheckpointTest, RejectsMismatches) {
+    auto net = trained_network();
+    auto path = temp_path("nnpp_checkpoint_mismatch.bin");
+    checkpoint::save(path, net);
+    checkpoint::Checkpoint saved(path);
+
+    Network other(
+        {12, 7, 3}, 4, activation::Kind::Tanh, activation::Kind::Softmax
+    );
+    EXPECT_THROW(saved.restore(other), std::invalid_argument);
+    Network activations({12, 7, 5, 3}, 4);
+    EXPECT_THROW(saved.restore(activations), std::invalid_argument);
+
+    std::vector<float> short_state(3);
+    std::span<const float> state[] = {short_state};
+    EXPECT_THROW(
+        checkpoint::save(path, net, {}, state), std::invalid_argument
+    );
+    std::filesystem::remove(path);
+}
+
+// Reads path, lets edit change the bytes and writes them to a new file
+static std::string corrupted(
+    const std::string& path,
+    const std::function<void(std::vector<char>&)>& edit
+) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(in)), {});
+    edit(bytes);
+    auto out_path = path + ".corrupt";
+    std::ofstream out(out_path, std::ios::binary);
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    return out_path;
+}
+
+TEST(CheckpointTest, RejectsInvalidFiles) {
+    auto net = trained_network();
+    auto path = temp_path("nnpp_checkpoint_invalid.bin");
+    checkpoint::save(path, net);
+
+    EXPECT_THROW(
+        checkpoint::Checkpoint(path + ".missing"), std::runtime_error
+    );
+    auto edits = std::vector<std::function<void(std::vector<char>&)>>{
+        [](auto& b) { b[0] = 'X'; },                        // magic
+        [](auto& b) { std::swap(b[12], b[15]); },           // byte order
+        [](auto& b) { b[8] = 3; },                          // version
+        [](auto& b) { b[20] = 9; },                         // hidden activation
+        [](auto& b) { b[52] = 6; },                         // optimizer
+        [](auto& b) { b.pop_back(); },                      // truncated
+        [](auto& b) { b.insert(b.end(), 64, 0); },          // trailing bytes
+        [](auto& b) { std::memset(b.data() + 64, 0, 8); },  // zero layer size
+        [](auto& b) { std::memset(b.data() + 64, 0xff, 8); },  // huge layer
+        [](auto& b) { b.resize(32); },                      // no header
+    };
+    for (size_t i = 0; i < edits.size(); ++i) {
+        auto bad = corrupted(path, edits[i]);
+        EXPECT_THROW(checkpoint::Checkpoint{bad}, std::runtime_error) << i;
+        std::filesystem::remove(bad);
+    }
+    std::filesystem::remove(path);
+}
+
+// Adam resumed with its moments and step count follows the straight run
+TEST(CheckpointTest, ResumedOptimizerMatches) {
+    Matrix input = random_matrix(4, 12, 3);
+    Matrix target(3, 4);
+    for (size_t b = 0; b < 4; ++b) {
+        target(b % 3, b) = 1.0f;
+    }
+    optimizer::Settings settings;
+    settings.kind = optimizer::Kind::AdamW;
+    auto train = [&](Network& net, optimizer::Optimizer& adam, int steps) {
+        for (int step = 0; step < steps; ++step) {
+            net.forward(input);
+            net.backward(target);
+            adam.step(0.01f, 4);
+        }
+    };
+
+    Network straight({12, 8, 3}, 4);
+    optimizer::Optimizer straight_adam(straight, settings);
+    train(straight, straight_adam, 10);
+
+    auto path = temp_path("nnpp_checkpoint_optimizer.bin");
+    Network first({12, 8, 3}, 4);
+    optimizer::Optimizer first_adam(first, settings);
+    train(first, first_adam, 4);
+    checkpoint::save(
+        path,
+        first,
+        {16, 0.01f, first_adam.kind(), first_adam.steps()},
+        first_adam.state()
+    );
+
+    checkpoint::Checkpoint saved(path);
+    EXPECT_EQ(saved.progress().optimizer, optimizer::Kind::AdamW);
+    EXPECT_EQ(saved.progress().steps, 4u);
+    Network resumed({12, 8, 3}, 4);
+    optimizer::Optimizer resumed_adam(resumed, settings);
+    saved.restore(resumed);
+    saved.restore(resumed_adam);
+    EXPECT_EQ(resumed_adam.steps(), 4u);
+    train(resumed, resumed_adam, 6);
+
+    auto a = straight.parameters();
+    auto b = resumed.parameters();
+    for (size_t i = 0; i < a.size(); ++i) {
+        ASSERT_EQ(a[i], b[i]) << i;
+    }
+
+    // Another rule cannot take over the moments
+    optimizer::Optimizer momentum(resumed, {optimizer::Kind::Momentum});
+    EXPECT_THROW(saved.restore(momentum), std::invalid_argument);
+    std::filesystem::remove(path);
+}
+
+// Version 1 files, without optimizer fields, read as plain SGD
+TEST(CheckpointTest, ReadsVersionOne) {
+    auto net = trained_network();
+    auto path = temp_path("nnpp_checkpoint_version_one.bin");
+    checkpoint::save(path, net, {7, 0.5f, optimizer::Kind::Adam, 3});
+    std::vector<char> bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    bytes[8] = 1;
+    std::memset(bytes.data() + 52, 0, 12);
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    checkpoint::Checkpoint saved(path);
+    EXPECT_EQ(saved.version(), 1u);
+    EXPECT_EQ(saved.progress().samples, 7u);
+    EXPECT_EQ(saved.progress().optimizer, optimizer::Kind::SGD);
+    EXPECT_EQ(saved.progress().steps, 0u);
+    std::filesystem::remove(path);
+}
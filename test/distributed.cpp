@@ -0,0 +1,190 @@
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "distributed.hpp"
+#include "matrix.hpp"
+#include "network.hpp"
+#include "support.hpp"
+
+using matrix::Matrix;
+using support::make_network;
+using support::one_hot;
+using support::temp_path;
+using support::random_matrix;
+
+// Runs rank(r) for r < size, each in a process of its own, and returns
+// whether all of them returned true. The ranks do all the work: the thread
+// pool does not survive fork, so this process must never start it.
+static bool run_ranks(size_t size, const std::function<bool(size_t)>& rank) {
+    std::vector<pid_t> children;
+    for (size_t r = 0; r < size; ++r) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            bool ok = false;
+            try {
+                ok = rank(r);
+            } catch (...) {
+            }
+            _exit(ok ? 0 : 1);
+        }
+        children.push_back(pid);
+    }
+    bool ok = true;
+    for (pid_t pid : children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    return ok;
+}
+
+static void write_floats(const std::string& path, std::span<const float> data) {
+    std::ofstream out(path, std::ios::binary);
+    out.write(
+        reinterpret_cast<const char*>(data.data()),
+        static_cast<std::streamsize>(data.size_bytes())
+    );
+}
+
+static std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), {}};
+}
+
+static std::vector<float> random_values(size_t n, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> values(n);
+    for (auto& v : values) {
+        v = dist(gen);
+    }
+    return values;
+}
+
+// Lengths shorter than the ring leave some chunks empty
+TEST(DistributedTest, AllReduceSumsOverEveryRank) {
+    for (size_t size = 1; size <= 4; ++size) {
+        for (size_t n : {1, 3, 1000, 4099}) {
+            auto path = temp_path("sum");
+            bool ok = run_ranks(size, [&](size_t r) {
+                distributed::Ring ring(path, r, size, 10.0);
+                std::vector<float> data(n);
+                for (size_t i = 0; i < n; ++i) {
+                    data[i] = static_cast<float>((r + 1) * i);
+                }
+                ring.all_reduce(data);
+                // Small integers, so every order of the additions is exact
+                float ranks = static_cast<float>(size * (size + 1) / 2);
+                for (size_t i = 0; i < n; ++i) {
+                    if (data[i] != ranks * static_cast<float>(i)) {
+                        return false;
+                    }
+                }
+                return true;
+            });
+            EXPECT_TRUE(ok) << size << " ranks, " << n << " values";
+        }
+    }
+}
+
+TEST(DistributedTest, AllReduceIsBitwiseIdenticalOnEveryRank) {
+    const size_t size = 3;
+    auto path = temp_path("bits");
+    bool ok = run_ranks(size, [&](size_t r) {
+        distributed::Ring ring(path, r, size, 10.0);
+        auto data = random_values(777, static_cast<unsigned>(r));
+        ring.all_reduce(data);
+        ring.all_reduce(data);
+        write_floats(path + ".out" + std::to_string(r), data);
+        return true;
+    });
+    ASSERT_TRUE(ok);
+    auto first = read_file(path + ".out0");
+    EXPECT_EQ(first.size(), 777 * sizeof(float));
+    for (size_t r = 1; r < size; ++r) {
+        EXPECT_EQ(read_file(path + ".out" + std::to_string(r)), first);
+    }
+    for (size_t r = 0; r < size; ++r) {
+        unlink((path + ".out" + std::to_string(r)).c_str());
+    }
+}
+
+// Two ranks on halves of each batch train like one network on the whole
+TEST(DistributedTest, TrainerFollowsTheCombinedBatch) {
+    const size_t size = 2;
+    const size_t n = 5;
+    const int steps = 4;
+    auto path = temp_path("trainer");
+    bool ok = run_ranks(size, [&](size_t r) {
+        distributed::Ring ring(path, r, size, 10.0);
+        auto net = make_network(n);
+        distributed::Trainer trainer(net, ring);
+        Matrix target = one_hot(4, n, r * n);
+        for (int step = 0; step < steps; ++step) {
+            Matrix batch = random_matrix(size * n, 12, step);
+            matrix::ConstMatrixView input = batch;
+            auto output = trainer.step(input.rows(r * n, n), target, 0.3f);
+            if (output.N != 4 || output.M != n) {
+                return false;
+            }
+        }
+        write_floats(path + ".out" + std::to_string(r), net.parameters());
+        if (r != 0) {
+            return true;
+        }
+
+        auto reference = make_network(size * n);
+        Matrix target_all = one_hot(4, size * n);
+        for (int step = 0; step < steps; ++step) {
+            reference.forward(random_matrix(size * n, 12, step));
+            reference.backward(target_all);
+            reference.step(0.3f);
+        }
+        auto a = net.parameters();
+        auto b = reference.parameters();
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (std::fabs(a[i] - b[i]) > 1e-5f) {
+                return false;
+            }
+        }
+        return true;
+    });
+    ASSERT_TRUE(ok);
+    EXPECT_EQ(read_file(path + ".out0"), read_file(path + ".out1"));
+    unlink((path + ".out0").c_str());
+    unlink((path + ".out1").c_str());
+}
+
+TEST(DistributedTest, RingTimesOutWithoutPeers) {
+    auto path = temp_path("alone");
+    EXPECT_TRUE(run_ranks(1, [&](size_t) {
+        try {
+            distributed::Ring ring(path, 0, 2, 0.2);
+        } catch (const std::runtime_error&) {
+            // The listener is gone again
+            return access((path + ".0").c_str(), F_OK) != 0;
+        }
+        return false;
+    }));
+}
+
+TEST(DistributedTest, RejectsInvalidRanks) {
+    EXPECT_THROW(distributed::Ring("unused", 2, 2), std::invalid_argument);
+    EXPECT_THROW(distributed::Ring("unused", 0, 0), std::invalid_argument);
+    // A ring of one needs no sockets
+    distributed::Ring single("unused", 0, 1);
+    std::vector<float> data{1.0f, 2.0f};
+    single.all_reduce(data);
+    EXPECT_EQ(data, (std::vector<float>{1.0f, 2.0f}));
+}
@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "checkpoint.hpp"
+#include "inference.hpp"
+#include "matrix.hpp"
+#include "memory.hpp"
+#include "mnist.hpp"
+#include "network.hpp"
+#include "support.hpp"
+
+using matrix::Matrix;
+using network::Network;
+using support::random_matrix;
+using support::temp_path;
+using support::write_idx;
+
+// Network with weights spread wide enough to give distinct predictions
+static Network spread_network(size_t batch_size) {
+    Network net(
+        {12, 9, 4},
+        batch_size,
+        activation::Kind::Tanh,
+        activation::Kind::Softmax,
+        3
+    );
+    for (float& p : net.parameters()) {
+        p *= 20.0f;
+    }
+    return net;
+}
+
+TEST(InferenceTest, MatchesNetworkForward) {
+    auto net = spread_network(8);
+    inference::Engine engine(net, 8);
+    EXPECT_EQ(engine.depth(), 2u);
+    EXPECT_EQ(engine.input_size(), 12u);
+    EXPECT_EQ(engine.output_size(), 4u);
+
+    for (size_t n : {1, 5, 8}) {
+        Matrix input =
+            random_matrix(n, 12, static_cast<unsigned>(n), 0.0f, 1.0f);
+        auto expected = net.forward(input);
+        auto output = engine.forward(input);
+        ASSERT_EQ(output.N, 4u);
+        ASSERT_EQ(output.M, n);
+        for (size_t i = 0; i < output.N; ++i) {
+            for (size_t j = 0; j < output.M; ++j) {
+                EXPECT_EQ(output(i, j), expected(i, j)) << n;
+            }
+        }
+    }
+}
+
+// The weights stay in the mapping; only the activations are allocated
+TEST(InferenceTest, ReadsCheckpointInPlace) {
+    auto before_network = memory::heap_stats().live_bytes;
+    auto net = spread_network(4);
+    auto network_bytes = memory::heap_stats().live_bytes - before_network;
+
+    auto path = temp_path("nnpp_inference_checkpoint.bin");
+    checkpoint::save(path, net);
+    checkpoint::Checkpoint saved(path);
+    auto before_engine = memory::heap_stats().live_bytes;
+    inference::Engine engine(saved, 4);
+    auto engine_bytes = memory::heap_stats().live_bytes - before_engine;
+
+    EXPECT_EQ(engine_bytes, engine.buffer_bytes());
+    EXPECT_LT(3 * engine_bytes, network_bytes);
+
+    Matrix input = random_matrix(4, 12, 7, 0.0f, 1.0f);
+    auto expected = net.forward(input);
+    auto output = engine.forward(input);
+    for (size_t i = 0; i < output.N; ++i) {
+        for (size_t j = 0; j < output.M; ++j) {
+            EXPECT_EQ(output(i, j), expected(i, j));
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(InferenceTest, EvaluateCountsCorrectPredictions) {
+    constexpr size_t COUNT = 11;
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<int> pixel(0, 255);
+    std::vector<uint8_t> pixels(COUNT * 12);
+    for (auto& p : pixels) {
+        p = static_cast<uint8_t>(pixel(gen));
+    }
+
+    // Labels are the network's own predictions, except for every third
+    // sample, whose label is shifted to another class
+    auto net = spread_network(COUNT);
+    Matrix input(COUNT, 12);
+    for (size_t i = 0; i < COUNT; ++i) {
+        for (size_t j = 0; j < 12; ++j) {
+            input(i, j) = static_cast<float>(pixels[i * 12 + j]) / 255.0f;
+        }
+    }
+    auto expected = net.forward(input);
+    std::vector<uint8_t> labels(COUNT);
+    size_t correct = 0;
+    for (size_t s = 0; s < COUNT; ++s) {
+        uint8_t best = 0;
+        for (uint8_t i = 1; i < 4; ++i) {
+            if (expected(i, s) > expected(best, s)) {
+                best = i;
+            }
+        }
+        bool wrong = s % 3 == 0;
+        labels[s] = wrong ? static_cast<uint8_t>((best + 1) % 4) : best;
+        correct += !wrong;
+    }
+
+    auto images =
+        write_idx("nnpp_inference_images.idx", {COUNT, 3, 4}, pixels);
+    auto labels_path =
+        write_idx("nnpp_inference_labels.idx", {COUNT}, labels);
+    mnist::MappedDataset dataset(images, labels_path);
+
+    inference::Engine engine(net, 4);
+    auto report = inference::evaluate(engine, dataset);
+    EXPECT_EQ(report.samples, COUNT);
+    EXPECT_EQ(report.correct, correct);
+    EXPECT_DOUBLE_EQ(
+        report.accuracy(),
+        static_cast<double>(correct) / static_cast<double>(COUNT)
+    );
+    // Batches of 4, 4 and 3
+    EXPECT_EQ(report.latencies.size(), 3u);
+    EXPECT_GT(report.seconds, 0.0);
+    EXPECT_GT(report.images_per_second(), 0.0);
+
+    double loss = 0.0;
+    for (size_t s = 0; s < COUNT; ++s) {
+        for (size_t i = 0; i < 4; ++i) {
+            double diff = expected(i, s) - (i == labels[s] ? 1.0 : 0.0);
+            loss += diff * diff;
+        }
+    }
+    EXPECT_NEAR(report.loss, loss / COUNT, 1e-6);
+
+    // Samples 5 to 10, of which 6 and 9 are mislabelled
+    auto part = inference::evaluate(engine, dataset, 5, 6);
+    EXPECT_EQ(part.samples, 6u);
+    EXPECT_EQ(part.correct, 4u);
+    EXPECT_EQ(part.latencies.size(), 2u);
+    EXPECT_THROW(
+        inference::evaluate(engine, dataset, 5, 7), std::out_of_range
+    );
+
+    std::filesystem::remove(images);
+    std::filesystem::remove(labels_path);
+}
+
+TEST(InferenceTest, LatencyPercentiles) {
+    inference::Report report;
+    EXPECT_EQ(report.latency_percentile(0.5), 0.0);
+    report.latencies.resize(100);
+    // 100, 99, ..., 1
+    std::iota(report.latencies.rbegin(), report.latencies.rend(), 1.0);
+    EXPECT_EQ(report.latency_percentile(0.5), 50.0);
+    EXPECT_EQ(report.latency_percentile(0.99), 99.0);
+    EXPECT_EQ(report.latency_percentile(1.0), 100.0);
+    EXPECT_EQ(report.latency_percentile(0.0), 1.0);
+}
+
+TEST(InferenceTest, RejectsInvalidBatches) {
+    auto net = spread_network(4);
+    EXPECT_THROW(inference::Engine(net, 0), std::invalid_argument);
+
+    inference::Engine engine(net, 4);
+    Matrix wide(2, 13);
+    EXPECT_THROW(engine.forward(wide), std::invalid_argument);
+    Matrix many(5, 12);
+    EXPECT_THROW(engine.forward(many), std::invalid_argument);
+
+    // Images of 4 pixels
+    auto images = write_idx(
+        "nnpp_inference_small.idx", {2, 2, 2}, {0, 1, 2, 3, 4, 5, 6, 7}
+    );
+    auto labels = write_idx("nnpp_inference_small_labels.idx", {2}, {0, 1});
+    mnist::MappedDataset dataset(images, labels);
+    EXPECT_THROW(engine.forward(dataset, 0, 2), std::invalid_argument);
+    std::filesystem::remove(images);
+    std::filesystem::remove(labels);
+}
@@ -1,7 +1,18 @@
 #include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "gemm.hpp"
 #include "matrix.hpp"
+#include "parallel.hpp"
+#include "precision.hpp"
+#include "support.hpp"
 
 using namespace matrix;
+using support::random_matrix;
 
 // Test basic matrix multiplication with simple 2x2 matrices
 TEST(MatrixTest, BasicMultiplication2x2) {
@@ -519,3 +530,412 @@ TEST(MatrixTest, LargeMatrixTransposeMultiplyInto) {
     EXPECT_EQ(result.N, 50);
     EXPECT_EQ(result.M, 30);
 }
+
+// Reference i-j-k product used to check the blocked kernel
+static Matrix naive_multiply(Matrix& A, Matrix& B) {
+    Matrix result(A.N, B.M);
+    for (size_t i = 0; i < A.N; ++i) {
+        for (size_t j = 0; j < B.M; ++j) {
+            double sum = 0.0;
+            for (size_t k = 0; k < A.M; ++k) {
+                sum += static_cast<double>(A(i, k)) * B(k, j);
+            }
+            result(i, j) = static_cast<float>(sum);
+        }
+    }
+    return result;
+}
+
+static Matrix transposed(Matrix& A) {
+    return Matrix(A.M, A.N, [&](size_t i, size_t j) { return A(j, i); });
+}
+
+static void expect_matrix_near(Matrix& actual, Matrix& expected, size_t k) {
+    ASSERT_EQ(actual.N, expected.N);
+    ASSERT_EQ(actual.M, expected.M);
+    // Summation order differs from the reference, so allow rounding error
+    // proportional to the reduction length.
+    float tolerance = 1e-5f * static_cast<float>(k) + 1e-5f;
+    for (size_t i = 0; i < actual.N; ++i) {
+        for (size_t j = 0; j < actual.M; ++j) {
+            ASSERT_NEAR(actual(i, j), expected(i, j), tolerance)
+                << "at (" << i << ", " << j << ")";
+        }
+    }
+}
+
+// Test the blocked kernel against the reference on shapes that exercise
+// partial register tiles and several cache blocks
+TEST(MatrixTest, BlockedMultiplicationMatchesReference) {
+    std::mt19937 gen(42);
+    const size_t shapes[][3] = {
+        {7, 5, 3},
+        {33, 17, 65},
+        {128, 1, 784},
+        {1, 128, 784},
+        {64, 64, 64},
+        {127, 129, 300},
+        {250, 70, 513},
+        {16, 784, 32},
+    };
+    for (const auto& shape : shapes) {
+        size_t n = shape[0], m = shape[1], k = shape[2];
+        Matrix A = random_matrix(n, k, gen);
+        Matrix B = random_matrix(k, m, gen);
+        Matrix result(n, m, 123.0f);  // Must be overwritten, not added to
+
+        A.multiply_into(B, result);
+
+        Matrix expected = naive_multiply(A, B);
+        expect_matrix_near(result, expected, k);
+    }
+}
+
+// Test both transposed variants against the reference on explicitly
+// transposed copies
+TEST(MatrixTest, BlockedTransposedVariantsMatchReference) {
+    std::mt19937 gen(7);
+    const size_t shapes[][3] = {
+        {10, 1, 16},
+        {16, 784, 1},
+        {5, 9, 3},
+        {127, 129, 300},
+        {64, 250, 513},
+        {784, 16, 32},
+    };
+    for (const auto& shape : shapes) {
+        size_t n = shape[0], m = shape[1], k = shape[2];
+
+        // A * B^T with A: n x k, B: m x k
+        Matrix A = random_matrix(n, k, gen);
+        Matrix B = random_matrix(m, k, gen);
+        Matrix result(n, m, 123.0f);
+        A.multiply_transpose_into(B, result);
+        Matrix Bt = transposed(B);
+        Matrix expected = naive_multiply(A, Bt);
+        expect_matrix_near(result, expected, k);
+
+        // A^T * B with A: k x n, B: k x m
+        Matrix C = random_matrix(k, n, gen);
+        Matrix D = random_matrix(k, m, gen);
+        Matrix result_t(n, m, 123.0f);
+        C.transpose_multiply_into(D, result_t);
+        Matrix Ct = transposed(C);
+        Matrix expected_t = naive_multiply(Ct, D);
+        expect_matrix_near(result_t, expected_t, k);
+    }
+}
+
+// Test broadcasting a column vector over a batch of columns
+TEST(MatrixTest, BroadcastSumInto) {
+    Matrix A(2, 3, [](size_t i, size_t j) {
+        return static_cast<float>(i * 3 + j);
+    });
+    Matrix b(2, 1);
+    b(0, 0) = 10.0f;
+    b(1, 0) = 20.0f;
+
+    A.broadcast_sum_into(b);
+
+    // A = [[10, 11, 12], [23, 24, 25]]
+    EXPECT_FLOAT_EQ(A(0, 0), 10.0f);
+    EXPECT_FLOAT_EQ(A(0, 2), 12.0f);
+    EXPECT_FLOAT_EQ(A(1, 0), 23.0f);
+    EXPECT_FLOAT_EQ(A(1, 2), 25.0f);
+
+    Matrix wrong(3, 1);
+    EXPECT_THROW(A.broadcast_sum_into(wrong), std::invalid_argument);
+}
+
+// Test summing rows and writing columns, the batch bias gradient and input
+TEST(MatrixTest, RowSumAndSetColumn) {
+    Matrix A(2, 3, [](size_t i, size_t j) {
+        return static_cast<float>(i * 3 + j);
+    });
+    Matrix sums(2, 1);
+
+    A.row_sum_into(sums);
+
+    // Rows [0, 1, 2] and [3, 4, 5]
+    EXPECT_FLOAT_EQ(sums(0, 0), 3.0f);
+    EXPECT_FLOAT_EQ(sums(1, 0), 12.0f);
+
+    A.set_column(1, sums);
+    EXPECT_FLOAT_EQ(A(0, 1), 3.0f);
+    EXPECT_FLOAT_EQ(A(1, 1), 12.0f);
+    EXPECT_FLOAT_EQ(A(0, 0), 0.0f);
+    EXPECT_FLOAT_EQ(A(1, 2), 5.0f);
+
+    EXPECT_THROW(A.set_column(3, sums), std::invalid_argument);
+    Matrix wrong(2, 2);
+    EXPECT_THROW(A.row_sum_into(wrong), std::invalid_argument);
+}
+
+// Test that threaded products are bitwise identical to single-threaded ones
+TEST(MatrixTest, ThreadedMultiplicationIsDeterministic) {
+    std::mt19937 gen(3);
+    Matrix A = random_matrix(300, 700, gen);
+    Matrix B = random_matrix(700, 200, gen);
+    Matrix Bt = random_matrix(200, 700, gen);
+    Matrix At = random_matrix(700, 300, gen);
+    Matrix x = random_matrix(700, 1, gen);
+
+    auto run = [&](size_t threads) {
+        parallel::set_num_threads(threads);
+        std::vector<Matrix> results = {
+            Matrix(300, 200), Matrix(300, 200), Matrix(300, 200), Matrix(300, 1)
+        };
+        A.multiply_into(B, results[0]);
+        A.multiply_transpose_into(Bt, results[1]);
+        At.transpose_multiply_into(B, results[2]);
+        A.multiply_into(x, results[3]);
+        return results;
+    };
+
+    auto single = run(1);
+    for (size_t threads : {2, 3, 8}) {
+        auto threaded = run(threads);
+        for (size_t r = 0; r < single.size(); ++r) {
+            for (size_t i = 0; i < single[r].N; ++i) {
+                for (size_t j = 0; j < single[r].M; ++j) {
+                    ASSERT_EQ(threaded[r](i, j), single[r](i, j))
+                        << "threads " << threads << " result " << r;
+                }
+            }
+        }
+    }
+    parallel::set_num_threads(0);
+}
+
+// Test products on blocks of larger matrices, whose rows are further apart
+// than their width
+TEST(MatrixTest, ViewMultiplicationUsesLeadingDimension) {
+    std::mt19937 gen(11);
+    Matrix big_a = random_matrix(40, 50, gen);
+    Matrix big_b = random_matrix(60, 30, gen);
+    Matrix big_c(70, 80, 5.0f);
+
+    ConstMatrixView a = big_a.view().block(3, 7, 20, 33);
+    ConstMatrixView b = big_b.view().block(10, 4, 33, 17);
+    MatrixView c = big_c.view().block(2, 9, 20, 17);
+    a.multiply_into(b, c);
+
+    Matrix A(20, 33, [&](size_t i, size_t j) { return a(i, j); });
+    Matrix B(33, 17, [&](size_t i, size_t j) { return b(i, j); });
+    Matrix C(20, 17, [&](size_t i, size_t j) { return c(i, j); });
+    Matrix expected = naive_multiply(A, B);
+    expect_matrix_near(C, expected, 33);
+
+    // Everything around the block is untouched
+    EXPECT_FLOAT_EQ(big_c(1, 9), 5.0f);
+    EXPECT_FLOAT_EQ(big_c(2, 8), 5.0f);
+    EXPECT_FLOAT_EQ(big_c(2, 26), 5.0f);
+    EXPECT_FLOAT_EQ(big_c(22, 9), 5.0f);
+
+    Matrix AtB(33, 17);
+    a.rows(0, 20).transpose_multiply_into(c, AtB);
+    Matrix At = transposed(A);
+    Matrix expected_atb = naive_multiply(At, C);
+    expect_matrix_near(AtB, expected_atb, 20);
+
+    EXPECT_THROW(MatrixView(big_c.view().data, 2, 5, 4), std::invalid_argument);
+    EXPECT_THROW(big_c.view().block(60, 0, 20, 1), std::out_of_range);
+}
+
+// Test that elementwise operations and Matrix conversions work on strided
+// views, both through the simd kernels and plain lambdas
+TEST(MatrixTest, ViewElementwiseOnStridedBlocks) {
+    Matrix A(4, 6, [](size_t i, size_t j) { return static_cast<float>(i * 6 + j); });
+    Matrix B(4, 6, 1.0f);
+    MatrixView inner = A.view().block(1, 1, 2, 4);
+    EXPECT_FALSE(inner.contiguous());
+    EXPECT_TRUE(A.view().rows(1, 2).contiguous());
+
+    inner.elementwise_into(B.view().block(0, 0, 2, 4), inner, simd::Sub{});
+    inner.apply([](float x) { return x * 2.0f; });
+    for (size_t i = 0; i < 4; ++i) {
+        for (size_t j = 0; j < 6; ++j) {
+            float original = static_cast<float>(i * 6 + j);
+            bool in_block = i >= 1 && i <= 2 && j >= 1 && j <= 4;
+            EXPECT_FLOAT_EQ(A(i, j), in_block ? (original - 1.0f) * 2.0f : original);
+        }
+    }
+
+    // A Matrix can stand in for a view anywhere
+    Matrix column(2, 1, 0.5f);
+    Matrix sums(2, 1);
+    inner.broadcast_sum_into(column);
+    inner.row_sum_into(sums);
+    EXPECT_FLOAT_EQ(sums(0, 0), (12.0f + 14.0f + 16.0f + 18.0f) + 4 * 0.5f);
+    EXPECT_FLOAT_EQ(sums(1, 0), (24.0f + 26.0f + 28.0f + 30.0f) + 4 * 0.5f);
+}
+
+// Test the fused layer products against separate product, bias and sigmoid
+// passes, on direct and blocked shapes with several epilogue strips
+TEST(MatrixTest, FusedLayerMatchesSeparatePasses) {
+    std::mt19937 gen(5);
+    const size_t shapes[][3] = {
+        {16, 1, 784}, {16, 32, 784}, {10, 5, 16}, {130, 200, 300}, {7, 0, 3},
+    };
+    for (auto [m, n, k] : shapes) {
+        Matrix A = random_matrix(m, k, gen);
+        Matrix B = random_matrix(k, n, gen);
+        Matrix Bt = transposed(B);
+        Matrix bias = random_matrix(m, 1, gen);
+
+        Matrix expected_pre(m, n);
+        A.multiply_into(B, expected_pre);
+        expected_pre.broadcast_sum_into(bias);
+        Matrix expected = expected_pre.cloned();
+        expected.apply(simd::Sigmoid{});
+
+        Matrix pre(m, n), result(m, n);
+        A.multiply_bias_activate_into(B, bias, pre, result, simd::sigmoid);
+        expect_matrix_near(pre, expected_pre, k);
+        expect_matrix_near(result, expected, k);
+
+        Matrix pre_t(m, n), result_t(m, n);
+        A.multiply_transpose_bias_activate_into(
+            Bt, bias, pre_t, result_t, simd::sigmoid
+        );
+        expect_matrix_near(pre_t, expected_pre, k);
+        expect_matrix_near(result_t, expected, k);
+    }
+
+    Matrix A(3, 4), B(4, 2), wrong_bias(2, 1), pre(3, 2), result(3, 2);
+    EXPECT_THROW(
+        A.multiply_bias_activate_into(B, wrong_bias, pre, result, simd::sigmoid),
+        std::runtime_error
+    );
+}
+
+// Test the fused backward products: the error through the activation
+// derivative, and updates accumulated straight into the result
+TEST(MatrixTest, FusedBackwardMatchesSeparatePasses) {
+    std::mt19937 gen(8);
+    const size_t shapes[][3] = {{16, 1, 10}, {16, 784, 1}, {100, 130, 270}};
+    for (auto [m, n, k] : shapes) {
+        Matrix W = random_matrix(k, m, gen);
+        Matrix delta = random_matrix(k, n, gen);
+        Matrix activation = random_matrix(m, n, gen);
+
+        Matrix expected(m, n);
+        W.transpose_multiply_into(delta, expected);
+        expected.elementwise_into(
+            activation, expected, simd::MulSigmoidDerivative{}
+        );
+        Matrix result(m, n, NAN);
+        W.transpose_multiply_elementwise_into(
+            delta, activation, result, simd::mul_sigmoid_derivative
+        );
+        expect_matrix_near(result, expected, k);
+
+        // result += alpha * A * B^T against a materialized gradient
+        Matrix A = random_matrix(m, k, gen);
+        Matrix Bt = random_matrix(n, k, gen);
+        Matrix B = transposed(Bt);
+        Matrix gradient(m, n);
+        A.multiply_into(B, gradient);
+        Matrix start = random_matrix(m, n, gen);
+        Matrix expected_update(m, n);
+        start.elementwise_into(gradient, expected_update, simd::Axpy{-0.25f});
+
+        Matrix update = start.cloned();
+        A.multiply_transpose_add_into(Bt, -0.25f, update);
+        expect_matrix_near(update, expected_update, k);
+        update = start.cloned();
+        A.multiply_add_into(B, -0.25f, update);
+        expect_matrix_near(update, expected_update, k);
+    }
+}
+
+// Test general alpha and beta, including beta == 0 ignoring garbage in C
+TEST(MatrixTest, GemmScalesByAlphaAndBeta) {
+    std::mt19937 gen(9);
+    for (size_t size : {5, 150}) {
+        Matrix A = random_matrix(size, size + 3, gen);
+        Matrix B = random_matrix(size + 3, size, gen);
+        Matrix product(size, size);
+        A.multiply_into(B, product);
+
+        Matrix C = random_matrix(size, size, gen);
+        Matrix expected(size, size, [&](size_t i, size_t j) {
+            return 2.0f * product(i, j) + 0.5f * C(i, j);
+        });
+        gemm::sgemm(
+            gemm::Transpose::No, gemm::Transpose::No, size, size, size + 3,
+            2.0f, A.view().data, A.M, B.view().data, B.M, 0.5f,
+            C.view().data, C.M
+        );
+        expect_matrix_near(C, expected, size + 3);
+
+        Matrix garbage(size, size, NAN);
+        gemm::sgemm(
+            gemm::Transpose::No, gemm::Transpose::No, size, size, size + 3,
+            1.0f, A.view().data, A.M, B.view().data, B.M, 0.0f,
+            garbage.view().data, garbage.M
+        );
+        expect_matrix_near(garbage, product, size + 3);
+    }
+}
+
+// Mixed-precision products widen the 16-bit operands exactly, so they match
+// sgemm on the widened values bit for bit, on the direct and packed paths
+TEST(MatrixTest, MixedPrecisionGemmMatchesWidenedOperands) {
+    using precision::Format;
+    std::mt19937 gen(11);
+    const size_t shapes[][3] = {{7, 5, 3}, {16, 1, 784}, {127, 129, 300}};
+    for (const auto& shape : shapes) {
+        size_t n = shape[0], m = shape[1], k = shape[2];
+        for (bool trans : {false, true}) {
+            auto tb = trans ? gemm::Transpose::Yes : gemm::Transpose::No;
+            Matrix A = random_matrix(n, k, gen);
+            Matrix B = trans ? random_matrix(m, k, gen)
+                             : random_matrix(k, m, gen);
+            for (Format fa : {Format::FP32, Format::BF16, Format::FP16}) {
+                for (Format fb : {Format::FP32, Format::BF16, Format::FP16}) {
+                    // Operands as stored, and widened back to fp32
+                    auto store = [](const Matrix& X, Format format,
+                                    std::vector<uint16_t>& bits,
+                                    Matrix& widened) {
+                        widened = X;
+                        if (format == Format::FP32) {
+                            return gemm::Operand{X.view().data, X.M, format};
+                        }
+                        bits.resize(X.N * X.M);
+                        precision::encode(
+                            format, X.view().data, bits.data(), bits.size()
+                        );
+                        precision::decode(
+                            format, bits.data(), widened.view().data, bits.size()
+                        );
+                        return gemm::Operand{bits.data(), X.M, format};
+                    };
+                    std::vector<uint16_t> a_bits, b_bits;
+                    Matrix Aw(1, 1), Bw(1, 1);
+                    auto a = store(A, fa, a_bits, Aw);
+                    auto b = store(B, fb, b_bits, Bw);
+
+                    Matrix expected(n, m);
+                    gemm::sgemm(
+                        gemm::Transpose::No, tb, n, m, k, 1.5f,
+                        Aw.view().data, k, Bw.view().data, Bw.M, 0.0f,
+                        expected.view().data, m
+                    );
+                    Matrix actual(n, m, NAN);
+                    gemm::gemm(
+                        gemm::Transpose::No, tb, n, m, k, 1.5f, a, b, 0.0f,
+                        actual.view().data, m
+                    );
+                    for (size_t i = 0; i < n; ++i) {
+                        for (size_t j = 0; j < m; ++j) {
+                            ASSERT_EQ(actual(i, j), expected(i, j))
+                                << precision::name(fa) << " x "
+                                << precision::name(fb);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "matrix.hpp"
+#include "memory.hpp"
+#include "network.hpp"
+
+using matrix::Matrix;
+
+static bool aligned(const float* p) {
+    return reinterpret_cast<uintptr_t>(p) % memory::ALIGNMENT == 0;
+}
+
+TEST(MemoryTest, HeapBuffersAreAlignedAndCounted) {
+    auto before = memory::heap_stats();
+    {
+        auto a = memory::make_buffer(3);
+        auto b = memory::make_buffer(100);
+        EXPECT_TRUE(aligned(a.get()));
+        EXPECT_TRUE(aligned(b.get()));
+
+        auto during = memory::heap_stats();
+        EXPECT_EQ(during.allocations - before.allocations, 2u);
+        // Sizes are rounded up to whole cache lines
+        EXPECT_EQ(during.bytes - before.bytes, 64u + 448u);
+        EXPECT_EQ(during.live_bytes - before.live_bytes, 64u + 448u);
+        EXPECT_GE(during.peak_bytes, during.live_bytes);
+    }
+    auto after = memory::heap_stats();
+    EXPECT_EQ(after.deallocations - before.deallocations, 2u);
+    EXPECT_EQ(after.live_bytes, before.live_bytes);
+}
+
+TEST(MemoryTest, ArenaHandsOutAlignedBlocks) {
+    memory::Arena arena(1024);
+    float* a = arena.allocate(1);
+    float* b = arena.allocate(17);
+    float* c = arena.allocate(16);
+    EXPECT_TRUE(aligned(a));
+    EXPECT_TRUE(aligned(b));
+    EXPECT_TRUE(aligned(c));
+    EXPECT_EQ(b - a, 16);
+    EXPECT_EQ(c - b, 32);
+
+    const auto& stats = arena.stats();
+    EXPECT_EQ(stats.allocations, 3u);
+    EXPECT_EQ(stats.used_bytes, 64u + 128u + 64u);
+    EXPECT_EQ(stats.capacity_bytes, 1024u);
+    EXPECT_EQ(stats.chunk_allocations, 1u);
+}
+
+TEST(MemoryTest, ResetReusesStorage) {
+    memory::Arena arena(1024);
+    float* first = arena.allocate(32);
+    arena.reset();
+    EXPECT_EQ(arena.allocate(32), first);
+
+    const auto& stats = arena.stats();
+    EXPECT_EQ(stats.allocations, 1u);
+    EXPECT_EQ(stats.total_allocations, 2u);
+    EXPECT_EQ(stats.resets, 1u);
+    EXPECT_EQ(stats.chunk_allocations, 1u);
+}
+
+// A round that outgrows the arena adds chunks, and the next reset merges
+// them so that later rounds fit in one
+TEST(MemoryTest, ResetMergesChunks) {
+    memory::Arena arena(256);
+    auto round = [&] {
+        for (int i = 0; i < 10; ++i) {
+            float* p = arena.allocate(48);
+            ASSERT_TRUE(aligned(p));
+            p[47] = 1.0f;
+        }
+    };
+    round();
+    const auto& stats = arena.stats();
+    EXPECT_GT(stats.chunk_allocations, 1u);
+    EXPECT_EQ(stats.peak_bytes, 10u * 192u);
+
+    arena.reset();
+    size_t chunks = stats.chunk_allocations;
+    size_t heap = memory::heap_stats().allocations;
+    for (int r = 0; r < 5; ++r) {
+        round();
+        arena.reset();
+    }
+    EXPECT_EQ(stats.chunk_allocations, chunks);
+    EXPECT_EQ(memory::heap_stats().allocations, heap);
+    EXPECT_GE(stats.capacity_bytes, 10u * 192u);
+}
+
+TEST(MemoryTest, EmptyArenaAllocatesLazily) {
+    memory::Arena arena;
+    EXPECT_EQ(arena.stats().chunk_allocations, 0u);
+    EXPECT_TRUE(aligned(arena.allocate(5)));
+    EXPECT_EQ(arena.stats().chunk_allocations, 1u);
+}
+
+TEST(MemoryTest, MatrixFromArena) {
+    memory::Arena arena(4096);
+    size_t heap = memory::heap_stats().allocations;
+
+    Matrix a(3, 5, arena, 2.0f);
+    EXPECT_EQ(a.source(), &arena);
+    EXPECT_TRUE(aligned(a.view().data));
+    EXPECT_EQ(a(2, 4), 2.0f);
+
+    // Clones stay in the arena, copies into an existing matrix reuse it
+    Matrix b = a.cloned();
+    Matrix c = a.clone_seeded(1.0f);
+    EXPECT_EQ(b.source(), &arena);
+    EXPECT_EQ(c.source(), &arena);
+    a.clone_into(c);
+    EXPECT_EQ(c(1, 1), 2.0f);
+    EXPECT_EQ(memory::heap_stats().allocations, heap);
+    EXPECT_EQ(arena.stats().allocations, 3u);
+
+    // Moves keep the storage
+    const float* data = b.view().data;
+    Matrix d = std::move(b);
+    EXPECT_EQ(d.view().data, data);
+    EXPECT_EQ(d.source(), &arena);
+
+    // Copies land on the heap
+    Matrix e = a;
+    EXPECT_EQ(e.source(), nullptr);
+    EXPECT_EQ(e(0, 0), 2.0f);
+    EXPECT_EQ(memory::heap_stats().allocations, heap + 1);
+}
+
+TEST(MemoryTest, HeapMatrixIsAligned) {
+    Matrix a(7, 3);
+    EXPECT_EQ(a.source(), nullptr);
+    EXPECT_TRUE(aligned(a.view().data));
+}
+
+// Once sized, a training step draws nothing from the heap
+TEST(MemoryTest, TrainingStepDoesNotTouchTheHeap) {
+    network::Network net({784, 16, 16, 10}, 8);
+    Matrix input(8, 784, 0.5f);
+    Matrix target(10, 8);
+    for (size_t b = 0; b < 8; ++b) {
+        target(b % 10, b) = 1.0f;
+    }
+    net.forward(input);
+    net.backward(target);
+    net.step(0.1f);
+
+    auto before = memory::heap_stats();
+    for (int s = 0; s < 10; ++s) {
+        net.forward(input);
+        net.backward(target);
+        net.step(0.1f);
+    }
+    auto after = memory::heap_stats();
+    EXPECT_EQ(after.allocations, before.allocations);
+    EXPECT_EQ(after.live_bytes, before.live_bytes);
+}
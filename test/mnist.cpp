@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "mnist.hpp"
+#include "support.hpp"
+
+using support::write_idx;
+
+// Two 2x3 images and their labels
+TEST(MnistTest, MappedDatasetExposesRawAndNormalizedPixels) {
+    std::vector<uint8_t> pixels = {0, 51, 102, 153, 204, 255,
+                                   255, 0, 255, 0, 255, 0};
+    auto images = write_idx("nnpp_images.idx", {2, 2, 3}, pixels);
+    auto labels = write_idx("nnpp_labels.idx", {2}, {7, 3});
+
+    mnist::MappedDataset dataset(images, labels);
+    ASSERT_EQ(dataset.size(), 2u);
+    EXPECT_EQ(dataset.rows(), 2u);
+    EXPECT_EQ(dataset.cols(), 3u);
+    EXPECT_EQ(dataset.label(0), 7);
+    EXPECT_EQ(dataset.label(1), 3);
+    EXPECT_EQ(dataset.image(1)[0], 255);
+
+    matrix::Matrix batch(6, 2);
+    dataset.image_into(1, batch, 1);
+    dataset.image_into(0, batch, 0);
+    EXPECT_FLOAT_EQ(batch(1, 0), 0.2f);
+    EXPECT_FLOAT_EQ(batch(5, 0), 1.0f);
+    EXPECT_FLOAT_EQ(batch(0, 1), 1.0f);
+    EXPECT_FLOAT_EQ(batch(1, 1), 0.0f);
+
+    std::vector<float> rows(12);
+    dataset.normalize_into(0, 2, rows.data());
+    EXPECT_FLOAT_EQ(rows[2], 0.4f);
+    EXPECT_FLOAT_EQ(rows[6], 1.0f);
+    EXPECT_THROW(dataset.normalize_into(1, 2, rows.data()), std::out_of_range);
+
+}
+
+// load_mnist stores every sample in one aligned buffer and hands out views
+TEST(MnistTest, DatasetViewsShareOneAlignedBuffer) {
+    std::vector<uint8_t> pixels = {0, 51, 102, 153, 204, 255,
+                                   255, 0, 255, 0, 255, 0};
+    auto images = write_idx("nnpp_views_images.idx", {2, 2, 3}, pixels);
+    auto labels = write_idx("nnpp_views_labels.idx", {2}, {7, 3});
+
+    // The dataset holds its own copy of the samples
+    mnist::Dataset dataset = mnist::load_mnist(images, labels);
+    std::filesystem::remove(images);
+    std::filesystem::remove(labels);
+    ASSERT_EQ(dataset.size(), 2u);
+    EXPECT_EQ(dataset.pixels(), 6u);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(dataset.data()) % 64, 0u);
+
+    auto first = dataset.sample(0);
+    auto second = dataset.sample(1);
+    EXPECT_EQ(first.data(), dataset.data());
+    EXPECT_EQ(second.data(), dataset.data() + 6);
+    EXPECT_FLOAT_EQ(first[3], 0.6f);
+    EXPECT_FLOAT_EQ(second[2], 1.0f);
+
+    auto both = dataset.batch(0, 2);
+    EXPECT_EQ(both.N, 2u);
+    EXPECT_EQ(both.M, 6u);
+    EXPECT_EQ(both.data, dataset.data());
+    EXPECT_FLOAT_EQ(both(1, 2), 1.0f);
+    EXPECT_EQ(dataset.label(1), 3);
+    EXPECT_EQ(dataset.labels(0, 2)[0], 7);
+    EXPECT_THROW(dataset.batch(1, 2), std::out_of_range);
+}
+
+// Seven 1x1 images split into three shards of two; the last one is left out
+TEST(MnistTest, ShardsSplitTheDatasetEvenly) {
+    auto images = write_idx(
+        "nnpp_shard_images.idx", {7, 1, 1}, {0, 51, 102, 153, 204, 255, 9}
+    );
+    auto labels =
+        write_idx("nnpp_shard_labels.idx", {7}, {0, 1, 2, 3, 4, 5, 6});
+
+    for (size_t shard = 0; shard < 3; ++shard) {
+        auto dataset = mnist::load_mnist_shard(images, labels, shard, 3);
+        ASSERT_EQ(dataset.size(), 2u);
+        EXPECT_EQ(dataset.label(0), 2 * shard);
+        EXPECT_EQ(dataset.label(1), 2 * shard + 1);
+        EXPECT_FLOAT_EQ(dataset.sample(1)[0], 0.2f * (2 * shard + 1));
+    }
+    EXPECT_THROW(
+        mnist::load_mnist_shard(images, labels, 3, 3), std::invalid_argument
+    );
+    EXPECT_THROW(
+        mnist::load_mnist_shard(images, labels, 0, 8), std::invalid_argument
+    );
+
+    mnist::MappedDataset source(images, labels);
+    EXPECT_THROW(mnist::Dataset(source, 6, 2), std::out_of_range);
+
+    // The first five samples in two shards, the rest held out
+    auto second = mnist::load_shard(source, 5, 1, 2);
+    ASSERT_EQ(second.size(), 2u);
+    EXPECT_EQ(second.label(0), 2);
+    EXPECT_EQ(second.label(1), 3);
+    EXPECT_THROW(mnist::load_shard(source, 8, 0, 2), std::out_of_range);
+    EXPECT_THROW(mnist::load_shard(source, 1, 0, 2), std::invalid_argument);
+}
+
+TEST(MnistTest, InvalidFilesAreRejected) {
+    auto labels = write_idx("nnpp_bad_labels.idx", {3}, {1, 2, 3});
+    // Wrong number of dimensions for an image file
+    EXPECT_THROW(mnist::IdxFile(labels, 3), std::runtime_error);
+    // Payload shorter than the header declares
+    auto truncated = write_idx("nnpp_truncated.idx", {5}, {1, 2});
+    EXPECT_THROW(mnist::IdxFile(truncated, 1), std::runtime_error);
+    // Dimensions whose product, 2^64, wraps to the empty payload
+    auto wrapped =
+        write_idx("nnpp_wrapped.idx", {1u << 22, 1u << 21, 1u << 21}, {});
+    EXPECT_THROW(mnist::IdxFile(wrapped, 3), std::runtime_error);
+    // A label that is no digit
+    auto digits = write_idx("nnpp_digits.idx", {3, 1, 1}, {9, 9, 9});
+    auto ten = write_idx("nnpp_ten_labels.idx", {3}, {1, 10, 2});
+    EXPECT_THROW(mnist::MappedDataset(digits, ten), std::runtime_error);
+    // Image and label counts disagree
+    auto images = write_idx("nnpp_bad_images.idx", {2, 1, 1}, {9, 9});
+    EXPECT_THROW(mnist::MappedDataset(images, labels), std::runtime_error);
+    EXPECT_THROW(mnist::IdxFile("/nonexistent/nnpp.idx", 1), std::runtime_error);
+}
@@ -0,0 +1,397 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "matrix.hpp"
+#include "memory.hpp"
+#include "network.hpp"
+#include "simd.hpp"
+// Counts the heap allocations of this binary
+#define NNPP_TEST_COUNT_ALLOCATIONS
+#include "support.hpp"
+
+using matrix::Matrix;
+using network::Network;
+using support::allocations;
+using support::clusters;
+using support::one_hot;
+using support::random_matrix;
+
+TEST(NetworkTest, ArenaLayout) {
+    Network net({5, 3, 2}, 4);
+    EXPECT_EQ(net.depth(), 2u);
+    EXPECT_EQ(net.weight(0).N, 3u);
+    EXPECT_EQ(net.weight(0).M, 5u);
+    EXPECT_EQ(net.bias(1).N, 2u);
+    EXPECT_EQ(net.bias(1).M, 1u);
+
+    // Blocks start on cache lines inside one parameter buffer, and the
+    // gradients mirror it
+    auto params = net.parameters();
+    for (size_t l = 0; l < net.depth(); ++l) {
+        for (const float* p : {net.weight(l).data, net.bias(l).data}) {
+            EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % 64, 0u);
+            EXPECT_GE(p, params.data());
+            EXPECT_LT(p, params.data() + params.size());
+        }
+        EXPECT_EQ(
+            net.weight_gradient(l).data - net.gradients().data(),
+            net.weight(l).data - params.data()
+        );
+    }
+    for (size_t i = 0; i < net.bias(0).N; ++i) {
+        EXPECT_EQ(net.bias(0)(i, 0), 0.0f);
+    }
+    EXPECT_NE(net.weight(0)(0, 0), 0.0f);
+}
+
+TEST(NetworkTest, InvalidShapes) {
+    EXPECT_THROW(Network({5}, 4), std::invalid_argument);
+    EXPECT_THROW(Network({5, 0, 2}, 4), std::invalid_argument);
+    EXPECT_THROW(Network({5, 2}, 0), std::invalid_argument);
+    EXPECT_THROW(
+        Network({5, 3, 2}, 4, activation::Kind::Softmax),
+        std::invalid_argument
+    );
+
+    Network net({5, 3, 2}, 4);
+    EXPECT_THROW(net.backward(one_hot(2, 4)), std::logic_error);
+    EXPECT_THROW(net.forward(Matrix(5, 5)), std::invalid_argument);
+    EXPECT_THROW(net.forward(Matrix(2, 4)), std::invalid_argument);
+    net.forward(Matrix(2, 5));
+    EXPECT_THROW(net.backward(one_hot(2, 4)), std::invalid_argument);
+}
+
+// Cross-entropy of the network output against target, summed over the batch
+static double loss(
+    Network& net, const Matrix& input, const Matrix& target, bool softmax
+) {
+    auto y = net.forward(input);
+    double sum = 0.0;
+    for (size_t i = 0; i < y.N; ++i) {
+        for (size_t b = 0; b < y.M; ++b) {
+            double t = target.view()(i, b);
+            double p = y(i, b);
+            sum -= t * std::log(p);
+            if (!softmax) {
+                sum -= (1.0 - t) * std::log(1.0 - p);
+            }
+        }
+    }
+    return sum;
+}
+
+// The stored gradients are those of cross-entropy for sigmoid and softmax
+// outputs, through every hidden activation
+TEST(NetworkTest, GradientsMatchFiniteDifferences) {
+    for (auto hidden :
+         {activation::Kind::Sigmoid, activation::Kind::Tanh,
+          activation::Kind::GELU}) {
+        for (auto output :
+             {activation::Kind::Sigmoid, activation::Kind::Softmax}) {
+            bool softmax = output == activation::Kind::Softmax;
+            Network net({6, 5, 4, 3}, 4, hidden, output, 7);
+            Matrix input = random_matrix(3, 6, 1);
+            Matrix target = one_hot(3, 3);
+
+            net.forward(input);
+            net.backward(target);
+
+            const float h = 1e-2f;
+            for (size_t l = 0; l < net.depth(); ++l) {
+                for (bool is_bias : {false, true}) {
+                    auto param = is_bias ? net.bias(l) : net.weight(l);
+                    auto grad = is_bias ? net.bias_gradient(l)
+                                        : net.weight_gradient(l);
+                    for (size_t i = 0; i < param.N; ++i) {
+                        for (size_t j = 0; j < param.M; ++j) {
+                            float saved = param(i, j);
+                            param(i, j) = saved + h;
+                            double plus = loss(net, input, target, softmax);
+                            param(i, j) = saved - h;
+                            double minus = loss(net, input, target, softmax);
+                            param(i, j) = saved;
+                            double numeric = (plus - minus) / (2 * h);
+                            ASSERT_NEAR(grad(i, j), numeric, 2e-3)
+                                << activation::name(hidden) << "/"
+                                << activation::name(output) << " layer " << l;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(NetworkTest, StepIsSgdOnAveragedGradients) {
+    Network net({6, 5, 3}, 4);
+    Matrix input = random_matrix(4, 6, 2);
+    net.forward(input);
+    net.backward(one_hot(3, 4));
+
+    auto params = net.parameters();
+    std::vector<float> before(params.begin(), params.end());
+    net.step(0.5f);
+    for (size_t i = 0; i < before.size(); ++i) {
+        EXPECT_FLOAT_EQ(
+            net.parameters()[i], before[i] - 0.5f / 4.0f * net.gradients()[i]
+        );
+    }
+}
+
+// backward reads forward's copy of the input, whatever becomes of the
+// caller's matrix in between
+TEST(NetworkTest, BackwardReadsItsOwnCopyOfTheInput) {
+    Network kept({6, 5, 3}, 4);
+    Network overwritten({6, 5, 3}, 4);
+    Matrix input = random_matrix(4, 6, 5);
+    Matrix target = one_hot(3, 4);
+    kept.forward(input);
+    kept.backward(target);
+    {
+        Matrix scratch = random_matrix(4, 6, 5);
+        overwritten.forward(scratch);
+        for (size_t b = 0; b < scratch.N; ++b) {
+            for (size_t j = 0; j < scratch.M; ++j) {
+                scratch(b, j) = std::numeric_limits<float>::quiet_NaN();
+            }
+        }
+    }
+    overwritten.backward(target);
+    for (size_t i = 0; i < kept.gradients().size(); ++i) {
+        EXPECT_EQ(kept.gradients()[i], overwritten.gradients()[i]);
+    }
+}
+
+// A batch smaller than the capacity trains exactly like a network sized for
+// it
+TEST(NetworkTest, PartialBatchMatchesExactBatch) {
+    Network big({6, 5, 3}, 8);
+    Network exact({6, 5, 3}, 3);
+    Matrix input = random_matrix(3, 6, 3);
+    Matrix target = one_hot(3, 3);
+    for (int s = 0; s < 3; ++s) {
+        big.forward(input);
+        big.backward(target);
+        big.step(0.1f);
+        exact.forward(input);
+        exact.backward(target);
+        exact.step(0.1f);
+    }
+    for (size_t i = 0; i < big.parameters().size(); ++i) {
+        EXPECT_FLOAT_EQ(big.parameters()[i], exact.parameters()[i]);
+    }
+    auto a = big.forward(input);
+    auto b = exact.forward(input);
+    for (size_t i = 0; i < a.N; ++i) {
+        for (size_t j = 0; j < a.M; ++j) {
+            EXPECT_FLOAT_EQ(a(i, j), b(i, j));
+        }
+    }
+}
+
+// A sharing network reads and updates the weights of its owner, with
+// gradients of its own
+TEST(NetworkTest, SharedParametersTrainTheOwner) {
+    Network owner({6, 5, 3}, 8, activation::Kind::Tanh);
+    Network reference({6, 5, 3}, 8, activation::Kind::Tanh);
+    Network worker(owner, 2);
+    EXPECT_EQ(worker.batch_size(), 2u);
+    EXPECT_EQ(worker.parameters().data(), owner.parameters().data());
+    EXPECT_EQ(worker.weight(1).data, owner.weight(1).data);
+    EXPECT_NE(worker.gradients().data(), owner.gradients().data());
+
+    // A sharing network allocates no parameters of its own
+    auto before = memory::heap_stats().bytes;
+    Network full({6, 5, 3}, 8, activation::Kind::Tanh);
+    auto middle = memory::heap_stats().bytes;
+    Network sharing(owner, 8);
+    auto after = memory::heap_stats().bytes;
+    EXPECT_EQ(
+        (middle - before) - (after - middle),
+        owner.parameters().size_bytes()
+    );
+
+    Matrix input = random_matrix(2, 6, 6);
+    Matrix target = one_hot(3, 2);
+    for (int s = 0; s < 3; ++s) {
+        worker.forward(input);
+        worker.backward(target);
+        worker.step(0.2f);
+        reference.forward(input);
+        reference.backward(target);
+        reference.step(0.2f);
+    }
+    for (size_t i = 0; i < owner.parameters().size(); ++i) {
+        EXPECT_EQ(owner.parameters()[i], reference.parameters()[i]);
+    }
+
+    EXPECT_THROW(
+        worker.set_storage_format(precision::Format::BF16),
+        std::invalid_argument
+    );
+    owner.set_storage_format(precision::Format::FP16);
+    EXPECT_THROW(Network(owner, 2), std::invalid_argument);
+}
+
+TEST(NetworkTest, SteadyStateDoesNotAllocate) {
+    Network net(
+        {784, 16, 16, 10}, 8, activation::Kind::GELU, activation::Kind::Softmax
+    );
+    Matrix input = random_matrix(8, 784, 4);
+    Matrix target = one_hot(10, 8);
+    // The first step sizes the GEMM packing buffers
+    net.forward(input);
+    net.backward(target);
+    net.step(0.1f);
+
+    size_t before = allocations.load();
+    for (int s = 0; s < 10; ++s) {
+        net.forward(input);
+        net.backward(target);
+        net.step(0.1f);
+    }
+    EXPECT_EQ(allocations.load(), before);
+}
+
+// 16-bit forward passes stay close to fp32 ones, and move the output by
+// about the rounding of the format
+TEST(NetworkTest, MixedPrecisionForwardTracksFp32) {
+    Matrix input = random_matrix(8, 784, 5);
+    Network reference(
+        {784, 32, 16, 10}, 8, activation::Kind::GELU, activation::Kind::Softmax, 3
+    );
+    auto expected = reference.forward(input);
+    for (auto [format, tolerance] :
+         {std::pair{precision::Format::BF16, 2e-3f},
+          std::pair{precision::Format::FP16, 3e-4f}}) {
+        Network net(
+            {784, 32, 16, 10}, 8, activation::Kind::GELU,
+            activation::Kind::Softmax, 3
+        );
+        net.set_storage_format(format);
+        EXPECT_EQ(net.storage_format(), format);
+        auto actual = net.forward(input);
+        float worst = 0.0f;
+        for (size_t i = 0; i < actual.N; ++i) {
+            for (size_t b = 0; b < actual.M; ++b) {
+                worst = std::max(worst, std::fabs(actual(i, b) - expected(i, b)));
+            }
+        }
+        EXPECT_LT(worst, tolerance) << precision::name(format);
+        EXPECT_GT(worst, 0.0f) << precision::name(format);
+
+        // Switching back runs the fp32 path again
+        net.set_storage_format(precision::Format::FP32);
+        auto back = net.forward(input);
+        EXPECT_EQ(back(0, 0), expected(0, 0));
+    }
+}
+
+// A fixed training run, pinned to the exact bits it ends with. Every build
+// type computes them alike, since no build fuses multiply-adds. The scalar
+// kernels sum in another order than the vector ones, which all agree.
+TEST(NetworkTest, TrainingResultIsPinned) {
+    for (auto isa :
+         {simd::Isa::Scalar, simd::Isa::SSE42, simd::Isa::AVX2,
+          simd::Isa::AVX512}) {
+        try {
+            simd::set_isa(isa);
+        } catch (const std::invalid_argument&) {
+            continue;
+        }
+        Network net(
+            {24, 32, 16, 3}, 64, activation::Kind::Tanh,
+            activation::Kind::Softmax, 1
+        );
+        Matrix input(64, 24);
+        Matrix target(3, 64);
+        clusters(input, target, 7);
+        for (int s = 0; s < 50; ++s) {
+            net.forward(input);
+            net.backward(target);
+            net.step(0.5f);
+        }
+        // Output biases, which every parameter update feeds into
+        std::vector<float> expected =
+            isa == simd::Isa::Scalar
+                ? std::vector<float>{-0x1.b4064ep-5f, -0x1.8b522ep-7f,
+                                     0x1.0b6d78p-4f}
+                : std::vector<float>{-0x1.b4065cp-5f, -0x1.8b5224p-7f,
+                                     0x1.0b6d7cp-4f};
+        for (size_t i = 0; i < expected.size(); ++i) {
+            EXPECT_EQ(net.bias(2)(i, 0), expected[i])
+                << simd::isa_name(isa) << " bias " << i;
+        }
+    }
+    simd::set_isa(simd::detected_isa());
+}
+
+static double accuracy(Network& net, const Matrix& input, const Matrix& target) {
+    auto y = net.forward(input);
+    size_t correct = 0;
+    for (size_t b = 0; b < y.M; ++b) {
+        size_t best = 0;
+        for (size_t c = 1; c < y.N; ++c) {
+            if (y(c, b) > y(best, b)) {
+                best = c;
+            }
+        }
+        correct += target.view()(best, b) == 1.0f;
+    }
+    return static_cast<double>(correct) / y.M;
+}
+
+// Training with 16-bit forward passes and fp32 master weights reaches the
+// accuracy of fp32 training
+TEST(NetworkTest, MixedPrecisionTrainingMatchesFp32Accuracy) {
+    Matrix input(64, 24);
+    Matrix target(3, 64);
+    Matrix test_input(256, 24);
+    Matrix test_target(3, 256);
+    clusters(test_input, test_target, 100);
+
+    std::vector<double> results;
+    for (auto format :
+         {precision::Format::FP32, precision::Format::BF16,
+          precision::Format::FP16}) {
+        Network net(
+            {24, 16, 3}, 256, activation::Kind::Tanh, activation::Kind::Softmax, 1
+        );
+        net.set_storage_format(format);
+        for (unsigned step = 0; step < 60; ++step) {
+            clusters(input, target, step);
+            net.forward(input);
+            net.backward(target);
+            net.step(0.5f);
+        }
+        results.push_back(accuracy(net, test_input, test_target));
+    }
+    EXPECT_GT(results[0], 0.9);
+    EXPECT_NEAR(results[1], results[0], 0.02);
+    EXPECT_NEAR(results[2], results[0], 0.02);
+}
+
+TEST(NetworkTest, MixedPrecisionSteadyStateDoesNotAllocate) {
+    Network net({784, 16, 16, 10}, 8);
+    net.set_storage_format(precision::Format::BF16);
+    Matrix input = random_matrix(8, 784, 4);
+    Matrix target = one_hot(10, 8);
+    net.forward(input);
+    net.backward(target);
+    net.step(0.1f);
+
+    size_t before = allocations.load();
+    for (int s = 0; s < 10; ++s) {
+        net.forward(input);
+        net.backward(target);
+        net.step(0.1f);
+    }
+    EXPECT_EQ(allocations.load(), before);
+}
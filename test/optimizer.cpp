@@ -0,0 +1,214 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include "matrix.hpp"
+#include "network.hpp"
+#include "optimizer.hpp"
+#include "support.hpp"
+
+using matrix::Matrix;
+using network::Network;
+using optimizer::Kind;
+using support::one_hot;
+using support::random_matrix;
+
+static const Kind kinds[] = {
+    Kind::SGD,
+    Kind::Momentum,
+    Kind::Nesterov,
+    Kind::RMSProp,
+    Kind::Adam,
+    Kind::AdamW,
+};
+
+static Network make_network() {
+    return Network(
+        {10, 12, 4}, 8, activation::Kind::Tanh, activation::Kind::Softmax, 3
+    );
+}
+
+// Squared error of net on its batch, after a forward pass
+static float cost(Network& net, const Matrix& input, Matrix& target) {
+    auto output = net.forward(input);
+    float sum = 0.0f;
+    for (size_t i = 0; i < output.N; ++i) {
+        for (size_t j = 0; j < output.M; ++j) {
+            float diff = output(i, j) - target(i, j);
+            sum += diff * diff;
+        }
+    }
+    return sum;
+}
+
+TEST(OptimizerTest, NamesRoundTrip) {
+    for (Kind kind : kinds) {
+        EXPECT_EQ(optimizer::parse(optimizer::name(kind)), kind);
+    }
+    EXPECT_THROW(optimizer::parse("lbfgs"), std::invalid_argument);
+    EXPECT_EQ(optimizer::state_count(Kind::SGD), 0u);
+    EXPECT_EQ(optimizer::state_count(Kind::Nesterov), 1u);
+    EXPECT_EQ(optimizer::state_count(Kind::AdamW), 2u);
+
+    for (auto decay : {optimizer::Decay::Constant, optimizer::Decay::Step,
+                       optimizer::Decay::Cosine}) {
+        EXPECT_EQ(optimizer::parse_decay(optimizer::name(decay)), decay);
+    }
+    EXPECT_THROW(optimizer::parse_decay("linear"), std::invalid_argument);
+}
+
+TEST(OptimizerTest, SgdMatchesNetworkStep) {
+    auto net = make_network();
+    auto reference = make_network();
+    optimizer::Optimizer sgd(net);
+    EXPECT_TRUE(sgd.state().empty());
+    Matrix input = random_matrix(8, 10, 1);
+    Matrix target = one_hot(4, 8);
+    for (int step = 0; step < 3; ++step) {
+        net.forward(input);
+        net.backward(target);
+        sgd.step(0.3f, 8);
+        reference.forward(input);
+        reference.backward(target);
+        reference.step(0.3f);
+    }
+    EXPECT_EQ(sgd.steps(), 3u);
+    auto a = net.parameters();
+    auto b = reference.parameters();
+    for (size_t i = 0; i < a.size(); ++i) {
+        ASSERT_EQ(a[i], b[i]) << i;
+    }
+}
+
+// Chunked updates, as the trainers make them, give the same bits as step
+TEST(OptimizerTest, UpdatesInChunksMatchStep) {
+    for (Kind kind : kinds) {
+        auto net = make_network();
+        auto chunked = make_network();
+        optimizer::Optimizer whole(net, {kind});
+        optimizer::Optimizer parts(chunked, {kind});
+        ASSERT_EQ(parts.state().size(), optimizer::state_count(kind));
+        for (auto buffer : parts.state()) {
+            for (float x : buffer) {
+                ASSERT_EQ(x, 0.0f);
+            }
+        }
+        Matrix target = one_hot(4, 8);
+        for (int step = 0; step < 3; ++step) {
+            Matrix input = random_matrix(8, 10, static_cast<unsigned>(step));
+            net.forward(input);
+            net.backward(target);
+            whole.step(0.01f, 8);
+            chunked.forward(input);
+            chunked.backward(target);
+            size_t total = chunked.parameters().size();
+            for (size_t first = 0; first < total; first += 37) {
+                size_t count = std::min<size_t>(37, total - first);
+                parts.update(first, count, 0.01f, 8);
+            }
+            parts.advance();
+        }
+        auto a = net.parameters();
+        auto b = chunked.parameters();
+        for (size_t i = 0; i < a.size(); ++i) {
+            ASSERT_EQ(a[i], b[i]) << optimizer::name(kind) << " " << i;
+        }
+    }
+}
+
+TEST(OptimizerTest, EveryRuleLowersTheCost) {
+    Matrix input = random_matrix(8, 10, 4);
+    Matrix target = one_hot(4, 8);
+    for (Kind kind : kinds) {
+        auto net = make_network();
+        optimizer::Optimizer opt(net, {kind});
+        float rate = kind == Kind::SGD || kind == Kind::Momentum ||
+                             kind == Kind::Nesterov
+                         ? 0.5f
+                         : 0.01f;
+        float before = cost(net, input, target);
+        for (int step = 0; step < 50; ++step) {
+            net.forward(input);
+            net.backward(target);
+            opt.step(rate, 8);
+        }
+        EXPECT_LT(cost(net, input, target), 0.5f * before)
+            << optimizer::name(kind);
+    }
+}
+
+// Bias correction makes Adam's first step about the learning rate in size
+// for every weight with a gradient well above epsilon
+TEST(OptimizerTest, AdamFirstStepIsBiasCorrected) {
+    auto net = make_network();
+    auto params = net.parameters();
+    std::vector<float> before(params.begin(), params.end());
+    optimizer::Optimizer adam(net, {Kind::Adam});
+    net.forward(random_matrix(8, 10, 5));
+    net.backward(one_hot(4, 8));
+    std::vector<float> gradients(
+        net.gradients().begin(), net.gradients().end()
+    );
+    adam.step(0.01f, 8);
+    auto after = net.parameters();
+    size_t checked = 0;
+    for (size_t i = 0; i < after.size(); ++i) {
+        if (std::fabs(gradients[i]) > 1e-3f) {
+            float expected = std::copysign(0.01f, gradients[i]);
+            EXPECT_NEAR(before[i] - after[i], expected, 1e-4f);
+            ++checked;
+        }
+    }
+    EXPECT_GT(checked, 0u);
+}
+
+TEST(OptimizerTest, AdamWDecaysWeightsWithoutGradients) {
+    auto net = make_network();
+    optimizer::Settings settings;
+    settings.kind = Kind::AdamW;
+    settings.weight_decay = 0.5f;
+    optimizer::Optimizer adamw(net, settings);
+    auto params = net.parameters();
+    std::vector<float> before(params.begin(), params.end());
+    // No backward: the gradients are zero, so only the decay moves weights
+    std::fill(net.gradients().begin(), net.gradients().end(), 0.0f);
+    adamw.step(0.1f, 1);
+    auto after = net.parameters();
+    for (size_t i = 0; i < after.size(); ++i) {
+        ASSERT_FLOAT_EQ(after[i], before[i] * 0.95f) << i;
+    }
+}
+
+TEST(OptimizerTest, SchedulesShapeTheRate) {
+    optimizer::Schedule constant;
+    EXPECT_EQ(constant.rate(0.1f, 0), 0.1f);
+    EXPECT_EQ(constant.rate(0.1f, 100000), 0.1f);
+
+    optimizer::Schedule step{optimizer::Decay::Step, 4, 10, 0.5f};
+    EXPECT_FLOAT_EQ(step.rate(1.0f, 0), 0.25f);
+    EXPECT_FLOAT_EQ(step.rate(1.0f, 3), 1.0f);
+    EXPECT_FLOAT_EQ(step.rate(1.0f, 13), 1.0f);
+    EXPECT_FLOAT_EQ(step.rate(1.0f, 14), 0.5f);
+    EXPECT_FLOAT_EQ(step.rate(1.0f, 34), 0.125f);
+
+    optimizer::Schedule cosine{optimizer::Decay::Cosine, 0, 100};
+    EXPECT_FLOAT_EQ(cosine.rate(2.0f, 0), 2.0f);
+    EXPECT_FLOAT_EQ(cosine.rate(2.0f, 50), 1.0f);
+    EXPECT_NEAR(cosine.rate(2.0f, 99), 0.0f, 1e-3f);
+    EXPECT_EQ(cosine.rate(2.0f, 100), 0.0f);
+    EXPECT_EQ(cosine.rate(2.0f, 1000), 0.0f);
+}
+
+TEST(OptimizerTest, RejectsInvalidUpdates) {
+    auto net = make_network();
+    optimizer::Optimizer adam(net, {Kind::Adam});
+    size_t total = net.parameters().size();
+    EXPECT_THROW(adam.step(0.1f, 0), std::invalid_argument);
+    EXPECT_THROW(adam.update(total - 1, 2, 0.1f, 1), std::out_of_range);
+    EXPECT_THROW(adam.update(total + 1, 0, 0.1f, 1), std::out_of_range);
+    EXPECT_THROW(adam.state(2), std::out_of_range);
+    EXPECT_NO_THROW(adam.update(total, 0, 0.1f, 1));
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "parallel.hpp"
+
+using namespace parallel;
+
+// Every index runs exactly once, whatever the split between threads
+TEST(ParallelTest, ParallelForCoversEveryIndexOnce) {
+    for (size_t threads : {1, 2, 4, 7}) {
+        ThreadPool pool(threads);
+        EXPECT_EQ(pool.size(), threads);
+        for (size_t count : {0, 1, 3, 64, 1001}) {
+            std::vector<std::atomic<int>> hits(count);
+            pool.parallel_for(count, [&](size_t i) { hits[i]++; });
+            for (size_t i = 0; i < count; ++i) {
+                ASSERT_EQ(hits[i].load(), 1) << threads << " " << count;
+            }
+        }
+    }
+}
+
+// The pool keeps working across many short calls
+TEST(ParallelTest, PoolIsReusedAcrossCalls) {
+    ThreadPool pool(4);
+    std::atomic<size_t> sum{0};
+    for (size_t call = 0; call < 500; ++call) {
+        pool.parallel_for(8, [&](size_t i) { sum += i; });
+    }
+    EXPECT_EQ(sum.load(), 500u * 28u);
+}
+
+TEST(ParallelTest, ExceptionsPropagateToCaller) {
+    ThreadPool pool(3);
+    EXPECT_THROW(
+        pool.parallel_for(
+            100,
+            [](size_t i) {
+                if (i == 42) {
+                    throw std::runtime_error("task failed");
+                }
+            }
+        ),
+        std::runtime_error
+    );
+    // Still usable afterwards
+    std::atomic<int> count{0};
+    pool.parallel_for(10, [&](size_t) { count++; });
+    EXPECT_EQ(count.load(), 10);
+}
+
+// A parallel_for inside a task runs serially instead of deadlocking
+TEST(ParallelTest, NestedCallsRunSerially) {
+    ThreadPool pool(4);
+    std::atomic<int> count{0};
+    pool.parallel_for(4, [&](size_t) {
+        pool.parallel_for(5, [&](size_t) { count++; });
+    });
+    EXPECT_EQ(count.load(), 20);
+}
+
+TEST(ParallelTest, GlobalThreadCountIsConfigurable) {
+    set_num_threads(3);
+    EXPECT_EQ(num_threads(), 3u);
+    set_num_threads(1);
+    EXPECT_EQ(num_threads(), 1u);
+    set_num_threads(0);
+    EXPECT_GE(num_threads(), 1u);
+}
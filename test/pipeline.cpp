@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "memory.hpp"
+#include "mnist.hpp"
+#include "pipeline.hpp"
+#include "support.hpp"
+
+using support::write_idx;
+
+// count 2x2 images whose pixels all hold the index of the image, labelled
+// index % classes. The IDX files are private to the test process and
+// removed once loaded, since the dataset copies the samples.
+static mnist::Dataset make_dataset(size_t count, uint8_t classes) {
+    std::vector<uint8_t> pixels;
+    std::vector<uint8_t> labels;
+    for (size_t i = 0; i < count; ++i) {
+        pixels.insert(pixels.end(), 4, static_cast<uint8_t>(i));
+        labels.push_back(static_cast<uint8_t>(i % classes));
+    }
+    auto images_path =
+        write_idx("nnpp_pipeline_images.idx", {uint32_t(count), 2, 2}, pixels);
+    auto labels_path =
+        write_idx("nnpp_pipeline_labels.idx", {uint32_t(count)}, labels);
+    auto dataset = mnist::load_mnist(images_path, labels_path);
+    std::filesystem::remove(images_path);
+    std::filesystem::remove(labels_path);
+    return dataset;
+}
+
+static size_t sample_of(const pipeline::Batch& batch, size_t s) {
+    return static_cast<size_t>(std::lround(batch.input(s, 0) * 255.0f));
+}
+
+// Checks that every row of batch is a whole sample with its one-hot target
+static void expect_consistent(const pipeline::Batch& batch, size_t classes) {
+    ASSERT_EQ(batch.input.N, batch.size);
+    ASSERT_EQ(batch.input.M, 4u);
+    ASSERT_EQ(batch.target.N, classes);
+    ASSERT_EQ(batch.target.M, batch.size);
+    for (size_t s = 0; s < batch.size; ++s) {
+        size_t sample = sample_of(batch, s);
+        for (size_t p = 1; p < 4; ++p) {
+            EXPECT_EQ(batch.input(s, p), batch.input(s, 0));
+        }
+        EXPECT_EQ(batch.labels[s], sample % classes);
+        for (size_t c = 0; c < classes; ++c) {
+            EXPECT_EQ(batch.target(c, s), c == sample % classes ? 1.0f : 0.0f);
+        }
+    }
+}
+
+TEST(PipelineTest, EveryEpochVisitsEverySampleOnce) {
+    auto dataset = make_dataset(10, 3);
+    pipeline::Options options;
+    options.batch_size = 4;
+    options.classes = 3;
+    pipeline::BatchLoader loader(dataset, options);
+    EXPECT_EQ(loader.batches_per_epoch(), 3u);
+
+    std::vector<size_t> first_order;
+    for (size_t epoch = 0; epoch < 3; ++epoch) {
+        std::vector<size_t> order;
+        for (size_t expected : {4u, 4u, 2u}) {
+            const auto& batch = loader.next();
+            EXPECT_EQ(batch.epoch, epoch);
+            EXPECT_EQ(batch.offset, order.size());
+            ASSERT_EQ(batch.size, expected);
+            expect_consistent(batch, 3);
+            for (size_t s = 0; s < batch.size; ++s) {
+                order.push_back(sample_of(batch, s));
+            }
+        }
+        auto sorted = order;
+        std::sort(sorted.begin(), sorted.end());
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            EXPECT_EQ(sorted[i], i);
+        }
+        if (epoch == 0) {
+            first_order = order;
+        } else {
+            EXPECT_NE(order, first_order);
+        }
+    }
+}
+
+TEST(PipelineTest, UnshuffledBatchesFollowTheDataset) {
+    auto dataset = make_dataset(7, 10);
+    pipeline::Options options;
+    options.batch_size = 3;
+    options.shuffle = false;
+    pipeline::BatchLoader loader(dataset, options);
+    for (size_t b = 0; b < 6; ++b) {
+        const auto& batch = loader.next();
+        expect_consistent(batch, 10);
+        for (size_t s = 0; s < batch.size; ++s) {
+            EXPECT_EQ(sample_of(batch, s), batch.offset + s);
+        }
+    }
+}
+
+// The order only depends on the seed, however the threads interleave
+TEST(PipelineTest, SameSeedSameBatches) {
+    auto dataset = make_dataset(50, 10);
+    auto run = [&](uint32_t seed, size_t prefetch) {
+        pipeline::Options options;
+        options.batch_size = 8;
+        options.prefetch = prefetch;
+        options.seed = seed;
+        pipeline::BatchLoader loader(dataset, options);
+        std::vector<size_t> order;
+        for (size_t b = 0; b < 3 * loader.batches_per_epoch(); ++b) {
+            const auto& batch = loader.next();
+            for (size_t s = 0; s < batch.size; ++s) {
+                order.push_back(sample_of(batch, s));
+            }
+        }
+        return order;
+    };
+    auto reference = run(1, 2);
+    EXPECT_EQ(run(1, 0), reference);
+    EXPECT_EQ(run(1, 5), reference);
+    EXPECT_NE(run(2, 2), reference);
+}
+
+// A loader started after some samples continues the stream of one that
+// handed them out
+TEST(PipelineTest, StartSkipsSamples) {
+    auto dataset = make_dataset(10, 10);
+    auto run = [&](size_t start, size_t batches) {
+        pipeline::Options options;
+        options.batch_size = 4;
+        options.seed = 3;
+        options.start = start;
+        pipeline::BatchLoader loader(dataset, options);
+        std::vector<size_t> order;
+        for (size_t b = 0; b < batches; ++b) {
+            const auto& batch = loader.next();
+            expect_consistent(batch, 10);
+            for (size_t s = 0; s < batch.size; ++s) {
+                order.push_back(sample_of(batch, s));
+            }
+        }
+        return order;
+    };
+    // 3 batches per epoch of 4, 4 and 2 samples
+    auto reference = run(0, 9);
+    auto after = [&](size_t skipped) {
+        return std::vector<size_t>(reference.begin() + skipped, reference.end());
+    };
+    EXPECT_EQ(run(8, 7), after(8));
+    EXPECT_EQ(run(10, 6), after(10));
+    EXPECT_EQ(run(24, 2), after(24));
+
+    pipeline::Options options;
+    options.batch_size = 4;
+    options.start = 14;
+    pipeline::BatchLoader loader(dataset, options);
+    const auto& batch = loader.next();
+    EXPECT_EQ(batch.epoch, 1u);
+    EXPECT_EQ(batch.offset, 4u);
+}
+
+TEST(PipelineTest, InvalidOptions) {
+    auto dataset = make_dataset(4, 10);
+    pipeline::Options options;
+    options.batch_size = 0;
+    EXPECT_THROW(pipeline::BatchLoader(dataset, options), std::invalid_argument);
+    options.batch_size = 2;
+    options.classes = 0;
+    EXPECT_THROW(pipeline::BatchLoader(dataset, options), std::invalid_argument);
+
+    // Errors of the producer surface in next
+    options.classes = 2;
+    options.shuffle = false;
+    pipeline::BatchLoader loader(dataset, options);
+    expect_consistent(loader.next(), 2);
+    EXPECT_THROW(loader.next(), std::out_of_range);
+}
+
+TEST(PipelineTest, SteadyStateDoesNotAllocate) {
+    auto dataset = make_dataset(64, 10);
+    pipeline::Options options;
+    options.batch_size = 16;
+    auto before = memory::heap_stats();
+    pipeline::BatchLoader loader(dataset, options);
+    auto constructed = memory::heap_stats();
+    EXPECT_EQ(constructed.allocations - before.allocations, 6u);
+    for (size_t b = 0; b < 40; ++b) {
+        expect_consistent(loader.next(), 10);
+    }
+    EXPECT_EQ(memory::heap_stats().allocations, constructed.allocations);
+}
@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "precision.hpp"
+#include "simd.hpp"
+
+using precision::Format;
+
+static bool is_nan16(Format format, uint16_t h) {
+    return format == Format::BF16 ? std::isnan(precision::from_bf16(h))
+                                  : (h & 0x7c00) == 0x7c00 && (h & 0x3ff) != 0;
+}
+
+static float decode(Format format, uint16_t h) {
+    return format == Format::BF16 ? precision::from_bf16(h)
+                                  : precision::from_fp16(h);
+}
+
+static uint16_t encode(Format format, float x) {
+    return format == Format::BF16 ? precision::to_bf16(x)
+                                  : precision::to_fp16(x);
+}
+
+// x converted to h is the nearest value of the format, ties going to the
+// even significand
+static void expect_nearest(Format format, float x, uint16_t h) {
+    double value = decode(format, h);
+    double error = std::fabs(static_cast<double>(x) - value);
+    if (std::isinf(value)) {
+        // Beyond the largest finite value plus half an ulp
+        uint16_t largest = static_cast<uint16_t>((h & 0x8000) | (h - 1));
+        double max = std::fabs(decode(format, largest));
+        double ulp = max - std::fabs(decode(format, largest - 1));
+        EXPECT_GE(std::fabs(x), max + ulp / 2) << x;
+        return;
+    }
+    for (int step : {-1, 1}) {
+        uint16_t neighbour = static_cast<uint16_t>(h + step);
+        if ((h & 0x7fff) == 0 && step < 0) {
+            // The neighbour below zero is the smallest value of the other sign
+            neighbour = static_cast<uint16_t>((h ^ 0x8000) + 1);
+        }
+        if (is_nan16(format, neighbour)) {
+            continue;
+        }
+        double other = std::fabs(static_cast<double>(x) - decode(format, neighbour));
+        EXPECT_LE(error, other) << x;
+        if (error == other) {
+            EXPECT_EQ(h & 1, 0) << x;
+        }
+    }
+}
+
+TEST(PrecisionTest, ParseAndName) {
+    for (Format format : {Format::FP32, Format::BF16, Format::FP16}) {
+        EXPECT_EQ(precision::parse(precision::name(format)), format);
+    }
+    EXPECT_EQ(precision::bytes(Format::FP32), 4u);
+    EXPECT_EQ(precision::bytes(Format::BF16), 2u);
+    EXPECT_THROW(precision::parse("fp8"), std::invalid_argument);
+}
+
+TEST(PrecisionTest, KnownValues) {
+    EXPECT_EQ(precision::to_bf16(1.0f), 0x3f80);
+    EXPECT_EQ(precision::to_bf16(-2.0f), 0xc000);
+    EXPECT_EQ(precision::to_bf16(std::numeric_limits<float>::max()), 0x7f80);
+    EXPECT_EQ(precision::from_bf16(0x3fc0), 1.5f);
+
+    EXPECT_EQ(precision::to_fp16(1.0f), 0x3c00);
+    EXPECT_EQ(precision::to_fp16(-2.0f), 0xc000);
+    EXPECT_EQ(precision::to_fp16(65504.0f), 0x7bff);
+    EXPECT_EQ(precision::to_fp16(65520.0f), 0x7c00);
+    EXPECT_EQ(precision::to_fp16(std::ldexp(1.0f, -24)), 0x0001);
+    EXPECT_EQ(precision::to_fp16(std::ldexp(1.0f, -26)), 0x0000);
+    EXPECT_EQ(precision::from_fp16(0x3555), 0.333251953125f);
+    EXPECT_EQ(precision::from_fp16(0x03ff), std::ldexp(1023.0f, -24));
+    EXPECT_EQ(precision::from_fp16(0xfc00), -INFINITY);
+
+    for (Format format : {Format::BF16, Format::FP16}) {
+        EXPECT_TRUE(std::isnan(decode(format, encode(format, NAN))));
+        EXPECT_EQ(decode(format, encode(format, INFINITY)), INFINITY);
+        EXPECT_EQ(decode(format, encode(format, -0.0f)), 0.0f);
+        EXPECT_TRUE(std::signbit(decode(format, encode(format, -0.0f))));
+    }
+}
+
+// Every 16-bit value survives a round trip through fp32
+TEST(PrecisionTest, EveryValueRoundTrips) {
+    for (Format format : {Format::BF16, Format::FP16}) {
+        for (uint32_t h = 0; h <= 0xffff; ++h) {
+            uint16_t bits = static_cast<uint16_t>(h);
+            if (is_nan16(format, bits)) {
+                EXPECT_TRUE(is_nan16(format, encode(format, decode(format, bits))));
+                continue;
+            }
+            ASSERT_EQ(encode(format, decode(format, bits)), bits)
+                << precision::name(format) << " " << h;
+        }
+    }
+}
+
+TEST(PrecisionTest, NarrowingRoundsToNearestEven) {
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<uint32_t> bits;
+    for (Format format : {Format::BF16, Format::FP16}) {
+        // Halfway cases between neighbouring values
+        for (uint32_t h = 0; h < 0x7bff; h += 7) {
+            uint16_t a = static_cast<uint16_t>(h);
+            float mid = static_cast<float>(
+                (static_cast<double>(decode(format, a)) +
+                 decode(format, static_cast<uint16_t>(a + 1))) /
+                2
+            );
+            expect_nearest(format, mid, encode(format, mid));
+        }
+        for (int i = 0; i < 100000; ++i) {
+            float x = std::bit_cast<float>(bits(gen));
+            if (std::isnan(x)) {
+                continue;
+            }
+            expect_nearest(format, x, encode(format, x));
+        }
+    }
+}
+
+// The vectorized kernels match the scalar conversions bit for bit on every
+// level this CPU supports
+TEST(PrecisionTest, KernelsMatchScalar) {
+    std::vector<float> values;
+    std::mt19937 gen(2);
+    std::uniform_int_distribution<uint32_t> bits;
+    for (int i = 0; i < 4099; ++i) {
+        values.push_back(std::bit_cast<float>(bits(gen)));
+    }
+    values.insert(
+        values.end(),
+        {0.0f, -0.0f, INFINITY, -INFINITY, NAN, 65504.0f, 65520.0f, 1e-8f}
+    );
+    std::vector<uint16_t> halves;
+    for (uint32_t h = 0; h <= 0xffff; ++h) {
+        halves.push_back(static_cast<uint16_t>(h));
+    }
+
+    for (auto isa :
+         {simd::Isa::Scalar, simd::Isa::SSE42, simd::Isa::AVX2,
+          simd::Isa::AVX512}) {
+        try {
+            simd::set_isa(isa);
+        } catch (const std::invalid_argument&) {
+            continue;
+        }
+        for (Format format : {Format::BF16, Format::FP16}) {
+            std::vector<uint16_t> narrowed(values.size());
+            precision::encode(format, values.data(), narrowed.data(), values.size());
+            for (size_t i = 0; i < values.size(); ++i) {
+                ASSERT_EQ(narrowed[i], encode(format, values[i]))
+                    << simd::isa_name(isa) << " " << values[i];
+            }
+
+            std::vector<float> widened(halves.size());
+            precision::decode(format, halves.data(), widened.data(), halves.size());
+            for (size_t i = 0; i < halves.size(); ++i) {
+                ASSERT_EQ(
+                    std::bit_cast<uint32_t>(widened[i]),
+                    std::bit_cast<uint32_t>(decode(format, halves[i]))
+                ) << simd::isa_name(isa) << " " << i;
+            }
+        }
+    }
+    simd::set_isa(simd::detected_isa());
+
+    uint16_t h;
+    float x = 1.0f;
+    EXPECT_THROW(precision::encode(Format::FP32, &x, &h, 1), std::invalid_argument);
+    EXPECT_THROW(precision::decode(Format::FP32, &h, &x, 1), std::invalid_argument);
+}
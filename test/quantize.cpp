@@ -0,0 +1,294 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "matrix.hpp"
+#include "network.hpp"
+#include "parallel.hpp"
+#include "quantize.hpp"
+#include "simd.hpp"
+// Counts the heap allocations of this binary
+#define NNPP_TEST_COUNT_ALLOCATIONS
+#include "support.hpp"
+
+using matrix::Matrix;
+using network::Network;
+using support::allocations;
+using support::clusters;
+using support::random_matrix;
+
+TEST(QuantizeTest, ChooseParams) {
+    // Sigmoid outputs
+    auto unit = quantize::choose_params(0.0f, 1.0f);
+    EXPECT_FLOAT_EQ(unit.scale, 1.0f / 127);
+    EXPECT_EQ(unit.zero_point, 0);
+
+    // Ranges are widened to include zero, which gets an exact code
+    for (auto [min, max] :
+         {std::pair{-1.0f, 1.0f}, {0.5f, 3.0f}, {-4.0f, -1.0f}}) {
+        auto params = quantize::choose_params(min, max);
+        uint8_t zero = quantize::quantize(0.0f, params);
+        EXPECT_EQ(quantize::dequantize(zero, params), 0.0f);
+        float low = quantize::dequantize(0, params);
+        float high = quantize::dequantize(127, params);
+        EXPECT_NEAR(low, std::min(min, 0.0f), params.scale);
+        EXPECT_NEAR(high, std::max(max, 0.0f), params.scale);
+    }
+
+    auto empty = quantize::choose_params(0.0f, 0.0f);
+    EXPECT_EQ(quantize::quantize(0.0f, empty), 0);
+    EXPECT_THROW(quantize::choose_params(1.0f, 0.0f), std::invalid_argument);
+    EXPECT_THROW(
+        quantize::choose_params(0.0f, INFINITY), std::invalid_argument
+    );
+}
+
+TEST(QuantizeTest, RoundsToNearestAndClamps) {
+    auto params = quantize::choose_params(-1.0f, 1.0f);
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for (int i = 0; i < 1000; ++i) {
+        float x = dist(gen);
+        uint8_t q = quantize::quantize(x, params);
+        float error = std::fabs(quantize::dequantize(q, params) - x);
+        EXPECT_LE(error, params.scale / 2 * 1.001f) << x;
+    }
+    EXPECT_EQ(quantize::quantize(-5.0f, params), 0);
+    EXPECT_EQ(quantize::quantize(5.0f, params), 127);
+    EXPECT_EQ(quantize::quantize(NAN, params), 0);
+}
+
+// The vectorized encoding agrees with the scalar one, up to ties that a
+// fused multiply-add rounds the other way
+TEST(QuantizeTest, CodesMatchOnEveryIsa) {
+    auto params = quantize::choose_params(-0.7f, 2.0f);
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<float> dist(-1.5f, 3.0f);
+    std::vector<float> x(1001);
+    for (auto& v : x) {
+        v = dist(gen);
+    }
+    x[0] = NAN;
+    x[1] = INFINITY;
+    x[2] = -INFINITY;
+    for (auto isa :
+         {simd::Isa::Scalar, simd::Isa::SSE42, simd::Isa::AVX2,
+          simd::Isa::AVX512}) {
+        try {
+            simd::set_isa(isa);
+        } catch (const std::invalid_argument&) {
+            continue;
+        }
+        std::vector<uint8_t> codes(x.size());
+        simd::to_u7(
+            x.data(),
+            1.0f / params.scale,
+            static_cast<float>(params.zero_point),
+            codes.data(),
+            x.size()
+        );
+        EXPECT_EQ(codes[0], 0);
+        EXPECT_EQ(codes[1], 127);
+        EXPECT_EQ(codes[2], 0);
+        for (size_t i = 3; i < x.size(); ++i) {
+            int expected = quantize::quantize(x[i], params);
+            EXPECT_NEAR(codes[i], expected, 1) << simd::isa_name(isa);
+        }
+    }
+    simd::set_isa(simd::detected_isa());
+}
+
+// Every instruction set gives the exact sums, including the largest codes,
+// whose pairs of products would saturate 16 bits with 8-bit inputs
+TEST(QuantizeTest, IntegerGemmIsExactOnEveryIsa) {
+    struct Shape {
+        size_t m, n, k;
+    };
+    std::mt19937 gen(2);
+    std::uniform_int_distribution<int> u7(0, 127);
+    std::uniform_int_distribution<int> s8(-127, 127);
+    for (auto isa :
+         {simd::Isa::Scalar, simd::Isa::SSE42, simd::Isa::AVX2,
+          simd::Isa::AVX512}) {
+        try {
+            simd::set_isa(isa);
+        } catch (const std::invalid_argument&) {
+            continue;
+        }
+        for (auto [m, n, k] :
+             {Shape{1, 1, 1}, Shape{3, 5, 7}, Shape{4, 4, 64}, Shape{2, 9, 129},
+              Shape{17, 10, 784}, Shape{5, 3, 0}}) {
+            size_t lda = k + 3;
+            size_t ldb = k + 5;
+            size_t ldc = n + 2;
+            std::vector<uint8_t> a(m * lda);
+            std::vector<int8_t> b(n * ldb);
+            for (auto& x : a) {
+                x = static_cast<uint8_t>(u7(gen));
+            }
+            for (auto& x : b) {
+                x = static_cast<int8_t>(s8(gen));
+            }
+            // Extreme codes in the first row of each
+            for (size_t p = 0; p < k; ++p) {
+                a[p] = 127;
+                b[p] = p % 3 == 0 ? 127 : -127;
+            }
+            std::vector<int32_t> c(m * ldc, -1);
+            simd::gemm_u8s8(
+                m, n, k, a.data(), lda, b.data(), ldb, c.data(), ldc
+            );
+            for (size_t i = 0; i < m; ++i) {
+                for (size_t j = 0; j < n; ++j) {
+                    int32_t expected = 0;
+                    for (size_t p = 0; p < k; ++p) {
+                        expected += a[i * lda + p] * b[j * ldb + p];
+                    }
+                    ASSERT_EQ(c[i * ldc + j], expected)
+                        << simd::isa_name(isa) << " " << m << "x" << n << "x"
+                        << k;
+                }
+                // Padding between rows of C is left alone
+                for (size_t j = n; j < ldc; ++j) {
+                    EXPECT_EQ(c[i * ldc + j], -1);
+                }
+            }
+        }
+    }
+    simd::set_isa(simd::detected_isa());
+}
+
+static Network trained(activation::Kind hidden) {
+    Network net({24, 32, 16, 3}, 64, hidden, activation::Kind::Softmax, 1);
+    Matrix input(64, 24);
+    Matrix target(3, 64);
+    for (unsigned step = 0; step < 100; ++step) {
+        clusters(input, target, step);
+        net.forward(input);
+        net.backward(target);
+        net.step(0.5f);
+    }
+    return net;
+}
+
+static size_t argmax(const float* x, size_t n, size_t stride) {
+    size_t best = 0;
+    for (size_t c = 1; c < n; ++c) {
+        if (x[c * stride] > x[best * stride]) {
+            best = c;
+        }
+    }
+    return best;
+}
+
+// The int8 model predicts what the fp32 network predicts, with close
+// probabilities, whether the hidden codes have a zero point or not
+TEST(QuantizeTest, ModelTracksNetwork) {
+    Matrix calibration_input(256, 24);
+    Matrix calibration_target(3, 256);
+    clusters(calibration_input, calibration_target, 1000);
+    Matrix input(500, 24);
+    Matrix target(3, 500);
+    clusters(input, target, 2000);
+
+    for (auto hidden :
+         {activation::Kind::Sigmoid, activation::Kind::Tanh,
+          activation::Kind::ReLU}) {
+        auto net = trained(hidden);
+        auto calibration = quantize::calibrate(net, calibration_input);
+        ASSERT_EQ(calibration.min.size(), 3u);
+        quantize::Model model(net, calibration, 500);
+        bool signed_codes = hidden == activation::Kind::Tanh;
+        EXPECT_EQ(model.input_params(1).zero_point > 0, signed_codes);
+
+        auto y = model.forward(input);
+        ASSERT_EQ(y.N, 500u);
+        ASSERT_EQ(y.M, 3u);
+        size_t agree = 0;
+        size_t correct = 0;
+        float error = 0.0f;
+        for (size_t first = 0; first < 500; first += 64) {
+            size_t n = std::min<size_t>(64, 500 - first);
+            auto reference = net.forward(input.view().rows(first, n));
+            for (size_t s = 0; s < n; ++s) {
+                size_t quantized = argmax(y.row(first + s), 3, 1);
+                agree += quantized == argmax(&reference(0, s), 3, reference.ld);
+                correct += target(quantized, first + s) == 1.0f;
+                for (size_t c = 0; c < 3; ++c) {
+                    float diff = y(first + s, c) - reference(c, s);
+                    error = std::max(error, std::fabs(diff));
+                }
+            }
+        }
+        EXPECT_GE(agree, 490u) << activation::name(hidden);
+        EXPECT_GE(correct, 450u) << activation::name(hidden);
+        EXPECT_LT(error, 0.1f) << activation::name(hidden);
+    }
+}
+
+// Splitting a batch over threads does not change a single bit
+TEST(QuantizeTest, ThreadedMatchesSerial) {
+    Network net(
+        {784, 64, 10}, 8, activation::Kind::ReLU, activation::Kind::Softmax, 3
+    );
+    Matrix input = random_matrix(200, 784, 4);
+    auto calibration = quantize::calibrate(net, input.view().rows(0, 16));
+    quantize::Model model(net, calibration, 200);
+
+    parallel::set_num_threads(1);
+    auto serial = model.forward(input);
+    std::vector<float> expected(serial.data, serial.data + 200 * 10);
+    parallel::set_num_threads(4);
+    auto threaded = model.forward(input);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQ(threaded.data[i], expected[i]) << i;
+    }
+    parallel::set_num_threads(0);
+}
+
+TEST(QuantizeTest, WeightsAreAboutFourTimesSmaller) {
+    Network net({784, 16, 16, 10}, 1);
+    Matrix input = random_matrix(4, 784, 5);
+    quantize::Model model(net, quantize::calibrate(net, input), 4);
+    size_t fp32 = 0;
+    for (size_t l = 0; l < net.depth(); ++l) {
+        size_t values = net.weight(l).N * net.weight(l).M + net.bias(l).N;
+        fp32 += values * sizeof(float);
+    }
+    EXPECT_LT(model.parameter_bytes() * 3.8, fp32);
+}
+
+TEST(QuantizeTest, InvalidShapes) {
+    Network net({8, 4, 2}, 4);
+    Matrix input = random_matrix(4, 8, 6);
+    EXPECT_THROW(quantize::calibrate(net, Matrix(4, 7)), std::invalid_argument);
+    auto calibration = quantize::calibrate(net, input);
+    EXPECT_THROW(quantize::Model(net, calibration, 0), std::invalid_argument);
+    auto short_calibration = calibration;
+    short_calibration.min.pop_back();
+    EXPECT_THROW(
+        quantize::Model(net, short_calibration, 4), std::invalid_argument
+    );
+
+    quantize::Model model(net, calibration, 4);
+    EXPECT_THROW(model.forward(Matrix(5, 8)), std::invalid_argument);
+    EXPECT_THROW(model.forward(Matrix(4, 7)), std::invalid_argument);
+}
+
+TEST(QuantizeTest, ForwardDoesNotAllocate) {
+    Network net({784, 16, 16, 10}, 8);
+    Matrix input = random_matrix(8, 784, 7);
+    quantize::Model model(net, quantize::calibrate(net, input), 8);
+    model.forward(input);
+
+    size_t before = allocations.load();
+    for (int s = 0; s < 10; ++s) {
+        model.forward(input);
+    }
+    EXPECT_EQ(allocations.load(), before);
+}
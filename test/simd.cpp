@@ -0,0 +1,320 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "matrix.hpp"
+#include "simd.hpp"
+
+using namespace simd;
+
+// Every level this CPU can run, so each dispatch path gets exercised
+static std::vector<Isa> supported_isas() {
+    std::vector<Isa> isas{};
+    for (Isa isa : {Isa::Scalar, Isa::SSE42, Isa::AVX2, Isa::AVX512}) {
+        try {
+            set_isa(isa);
+            isas.push_back(isa);
+        } catch (const std::invalid_argument&) {
+        }
+    }
+    set_isa(detected_isa());
+    return isas;
+}
+
+static std::vector<float> random_vector(size_t n, float range) {
+    std::mt19937 gen(static_cast<unsigned>(n));
+    std::uniform_real_distribution<float> dist(-range, range);
+    std::vector<float> v(n);
+    for (auto& x : v) {
+        x = dist(gen);
+    }
+    return v;
+}
+
+// Lengths covering empty input, pure tails and full registers plus a tail
+static const size_t lengths[] = {0, 1, 3, 4, 7, 8, 15, 16, 17, 33, 1000};
+
+TEST(SimdTest, DetectedIsaIsSupported) {
+    EXPECT_NO_THROW(set_isa(detected_isa()));
+    EXPECT_NO_THROW(set_isa(Isa::Scalar));
+    EXPECT_EQ(active_isa(), Isa::Scalar);
+    set_isa(detected_isa());
+}
+
+TEST(SimdTest, ArithmeticMatchesScalar) {
+    for (Isa isa : supported_isas()) {
+        set_isa(isa);
+        for (size_t n : lengths) {
+            auto a = random_vector(n, 10.0f);
+            auto b = random_vector(n + 1, 10.0f);
+            std::vector<float> out(n);
+
+            add(a.data(), b.data(), out.data(), n);
+            for (size_t i = 0; i < n; ++i) {
+                ASSERT_FLOAT_EQ(out[i], a[i] + b[i]) << isa_name(isa);
+            }
+            sub(a.data(), b.data(), out.data(), n);
+            for (size_t i = 0; i < n; ++i) {
+                ASSERT_FLOAT_EQ(out[i], a[i] - b[i]) << isa_name(isa);
+            }
+            mul(a.data(), b.data(), out.data(), n);
+            for (size_t i = 0; i < n; ++i) {
+                ASSERT_FLOAT_EQ(out[i], a[i] * b[i]) << isa_name(isa);
+            }
+            axpy(a.data(), b.data(), -0.1f, out.data(), n);
+            for (size_t i = 0; i < n; ++i) {
+                ASSERT_NEAR(out[i], a[i] - 0.1f * b[i], 1e-5f)
+                    << isa_name(isa);
+            }
+            scale(a.data(), 3.0f, out.data(), n);
+            for (size_t i = 0; i < n; ++i) {
+                ASSERT_FLOAT_EQ(out[i], a[i] * 3.0f) << isa_name(isa);
+            }
+        }
+    }
+    set_isa(detected_isa());
+}
+
+TEST(SimdTest, SigmoidMatchesReference) {
+    for (Isa isa : supported_isas()) {
+        set_isa(isa);
+        for (size_t n : lengths) {
+            auto x = random_vector(n, 20.0f);
+            auto g = random_vector(n + 2, 1.0f);
+            std::vector<float> s(n), ds(n), gds(n);
+
+            sigmoid(x.data(), s.data(), n);
+            sigmoid_derivative(x.data(), ds.data(), n);
+            mul_sigmoid_derivative(g.data(), x.data(), gds.data(), n);
+
+            for (size_t i = 0; i < n; ++i) {
+                double e = std::exp(-static_cast<double>(x[i]));
+                double ref = 1.0 / (1.0 + e);
+                double dref = ref * (1.0 - ref);
+                ASSERT_NEAR(s[i], ref, 1e-6) << isa_name(isa);
+                ASSERT_NEAR(ds[i], dref, 1e-6) << isa_name(isa);
+                ASSERT_NEAR(gds[i], g[i] * dref, 1e-6) << isa_name(isa);
+            }
+        }
+    }
+    set_isa(detected_isa());
+}
+
+// Large inputs must saturate instead of overflowing into NaN
+TEST(SimdTest, SigmoidIsStableForLargeInputs) {
+    std::vector<float> x = {-1000.0f, -100.0f, -88.0f, 0.0f, 88.0f, 100.0f,
+                            1000.0f, INFINITY, -INFINITY};
+    std::vector<float> s(x.size()), ds(x.size());
+    for (Isa isa : supported_isas()) {
+        set_isa(isa);
+        sigmoid(x.data(), s.data(), x.size());
+        sigmoid_derivative(x.data(), ds.data(), x.size());
+        for (size_t i = 0; i < x.size(); ++i) {
+            ASSERT_FALSE(std::isnan(s[i])) << isa_name(isa) << " " << x[i];
+            ASSERT_FALSE(std::isnan(ds[i])) << isa_name(isa) << " " << x[i];
+            ASSERT_GE(s[i], 0.0f);
+            ASSERT_LE(s[i], 1.0f);
+        }
+        EXPECT_NEAR(s[0], 0.0f, 1e-30f);
+        EXPECT_FLOAT_EQ(s[3], 0.5f);
+        EXPECT_FLOAT_EQ(s[6], 1.0f);
+    }
+    EXPECT_FLOAT_EQ(simd::sigmoid(1000.0f), 1.0f);
+    EXPECT_FLOAT_EQ(simd::sigmoid(-1000.0f), 0.0f);
+    set_isa(detected_isa());
+}
+
+TEST(SimdTest, ActivationsMatchReference) {
+    for (Isa isa : supported_isas()) {
+        set_isa(isa);
+        for (size_t n : lengths) {
+            auto x = random_vector(n, 10.0f);
+            std::vector<float> e(n), t(n), r(n), l(n), gl(n);
+
+            simd::exp(x.data(), e.data(), n);
+            simd::tanh(x.data(), t.data(), n);
+            relu(x.data(), r.data(), n);
+            leaky_relu(x.data(), l.data(), n);
+            gelu(x.data(), gl.data(), n);
+
+            for (size_t i = 0; i < n; ++i) {
+                double v = x[i];
+                ASSERT_NEAR(e[i], std::exp(v), 4e-7 * std::exp(v))
+                    << isa_name(isa);
+                ASSERT_NEAR(t[i], std::tanh(v), 1e-6) << isa_name(isa);
+                ASSERT_EQ(r[i], x[i] > 0.0f ? x[i] : 0.0f);
+                ASSERT_FLOAT_EQ(l[i], x[i] > 0.0f ? x[i] : 0.01f * x[i]);
+                // Exact GELU; the tanh approximation stays within its bound
+                double ref = 0.5 * v * (1.0 + std::erf(v / std::sqrt(2.0)));
+                ASSERT_NEAR(gl[i], ref, 5e-4) << isa_name(isa);
+            }
+        }
+    }
+    set_isa(detected_isa());
+}
+
+// The backward kernels only see the forward output, yet must match the
+// derivative computed from the input
+TEST(SimdTest, BackwardFromOutputMatchesDerivative) {
+    for (Isa isa : supported_isas()) {
+        set_isa(isa);
+        for (size_t n : lengths) {
+            auto x = random_vector(n, 6.0f);
+            auto g = random_vector(n + 3, 1.0f);
+            std::vector<float> y(n), out(n);
+
+            sigmoid(x.data(), y.data(), n);
+            sigmoid_backward(g.data(), y.data(), out.data(), n);
+            for (size_t i = 0; i < n; ++i) {
+                ASSERT_NEAR(out[i], g[i] * sigmoid_derivative(x[i]), 1e-6)
+                    << isa_name(isa);
+            }
+
+            simd::tanh(x.data(), y.data(), n);
+            tanh_backward(g.data(), y.data(), out.data(), n);
+            for (size_t i = 0; i < n; ++i) {
+                double d = 1.0 - std::tanh(x[i]) * std::tanh(x[i]);
+                ASSERT_NEAR(out[i], g[i] * d, 2e-6) << isa_name(isa);
+            }
+
+            leaky_relu(x.data(), y.data(), n);
+            leaky_relu_backward(g.data(), y.data(), out.data(), n);
+            for (size_t i = 0; i < n; ++i) {
+                ASSERT_FLOAT_EQ(out[i], x[i] > 0.0f ? g[i] : 0.01f * g[i]);
+            }
+
+            relu(x.data(), y.data(), n);
+            relu_backward(g.data(), y.data(), out.data(), n);
+            for (size_t i = 0; i < n; ++i) {
+                ASSERT_EQ(out[i], x[i] > 0.0f ? g[i] : 0.0f);
+            }
+
+            gelu(x.data(), y.data(), n);
+            gelu_backward(g.data(), x.data(), y.data(), out.data(), n);
+            for (size_t i = 0; i < n; ++i) {
+                // Central difference of the scalar GELU in double precision
+                double h = 1e-3;
+                double v = x[i];
+                auto f = [](double u) {
+                    double c = std::sqrt(8.0 / M_PI) * (u + 0.044715 * u * u * u);
+                    return u / (1.0 + std::exp(-c));
+                };
+                double d = (f(v + h) - f(v - h)) / (2.0 * h);
+                ASSERT_NEAR(out[i], g[i] * d, 1e-5) << isa_name(isa) << " " << v;
+            }
+        }
+    }
+    set_isa(detected_isa());
+}
+
+TEST(SimdTest, ActivationsAreStableForLargeInputs) {
+    std::vector<float> x = {-1000.0f, -100.0f, -20.0f, -1e-4f, 0.0f, 1e-4f,
+                            20.0f, 100.0f, 1000.0f, INFINITY, -INFINITY};
+    std::vector<float> y(x.size()), g(x.size(), 1.0f), d(x.size());
+    for (Isa isa : supported_isas()) {
+        set_isa(isa);
+        simd::tanh(x.data(), y.data(), x.size());
+        for (size_t i = 0; i < x.size(); ++i) {
+            ASSERT_NEAR(y[i], std::tanh(x[i]), 1e-6) << isa_name(isa);
+        }
+        gelu(x.data(), y.data(), x.size());
+        gelu_backward(g.data(), x.data(), y.data(), d.data(), x.size() - 2);
+        for (size_t i = 0; i < x.size(); ++i) {
+            ASSERT_FALSE(std::isnan(y[i])) << isa_name(isa) << " " << x[i];
+        }
+        for (size_t i = 0; i + 2 < x.size(); ++i) {
+            ASSERT_FALSE(std::isnan(d[i])) << isa_name(isa) << " " << x[i];
+        }
+        EXPECT_FLOAT_EQ(y[0], 0.0f);
+        EXPECT_FLOAT_EQ(y[4], 0.0f);
+        EXPECT_FLOAT_EQ(y[8], 1000.0f);
+        EXPECT_NEAR(d[4], 0.5f, 1e-6f);
+        EXPECT_NEAR(d[8], 1.0f, 1e-6f);
+    }
+    set_isa(detected_isa());
+}
+
+// Matrix picks the buffer overloads of the simd function objects and keeps
+// the scalar loop for plain callables
+TEST(SimdTest, MatrixUsesVectorizedFunctors) {
+    matrix::Matrix A(3, 7, [](size_t i, size_t j) {
+        return static_cast<float>(i) - static_cast<float>(j);
+    });
+    matrix::Matrix B(3, 7, 2.0f);
+    matrix::Matrix C(3, 7);
+
+    A.elementwise_into(B, C, simd::Axpy{-0.5f});
+    for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 7; ++j) {
+            EXPECT_FLOAT_EQ(C(i, j), A(i, j) - 1.0f);
+        }
+    }
+
+    matrix::Matrix D = A.cloned();
+    A.apply(simd::Sigmoid{});
+    D.apply([](float x) { return simd::sigmoid(x); });
+    for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 7; ++j) {
+            EXPECT_NEAR(A(i, j), D(i, j), 1e-6f);
+        }
+    }
+}
+
+// Every level follows the update rules written out with doubles
+TEST(SimdTest, OptimizerUpdatesMatchReference) {
+    Update u;
+    u.grad_scale = 0.25f;
+    u.learning_rate = 0.05f;
+    u.beta1 = 0.9f;
+    u.beta2 = 0.99f;
+    u.epsilon = 1e-3f;
+    u.decay = 0.01f;
+    for (Isa isa : supported_isas()) {
+        set_isa(isa);
+        for (size_t n : lengths) {
+            auto g = random_vector(n, 2.0f);
+            auto w0 = random_vector(n + 2, 1.0f);
+            auto m0 = random_vector(n + 3, 0.5f);
+            auto v0 = random_vector(n + 4, 0.5f);
+            for (auto& x : v0) {
+                x = std::fabs(x);
+            }
+            for (int rule = 0; rule < 4; ++rule) {
+                std::vector<float> w(w0.begin(), w0.begin() + n);
+                std::vector<float> m(m0.begin(), m0.begin() + n);
+                std::vector<float> v(v0.begin(), v0.begin() + n);
+                auto* update = rule == 0   ? momentum_update
+                               : rule == 1 ? nesterov_update
+                               : rule == 2 ? rmsprop_update
+                                           : adam_update;
+                update(w.data(), m.data(), v.data(), g.data(), u, n);
+                for (size_t i = 0; i < n; ++i) {
+                    double grad = double{g[i]} * u.grad_scale;
+                    double a = m0[i];
+                    double b = v0[i];
+                    double x = w0[i] * (1.0 - u.decay);
+                    if (rule == 0 || rule == 1) {
+                        a = u.beta1 * a + grad;
+                        x -= u.learning_rate *
+                             (rule == 0 ? a : grad + u.beta1 * a);
+                    } else if (rule == 2) {
+                        b = u.beta2 * b + (1.0 - u.beta2) * grad * grad;
+                        x -= u.learning_rate * grad /
+                             (std::sqrt(b) + u.epsilon);
+                    } else {
+                        a = u.beta1 * a + (1.0 - u.beta1) * grad;
+                        b = u.beta2 * b + (1.0 - u.beta2) * grad * grad;
+                        x -= u.learning_rate * a / (std::sqrt(b) + u.epsilon);
+                    }
+                    // Rules keeping one moment leave the other alone
+                    ASSERT_NEAR(w[i], x, 1e-5) << isa_name(isa) << rule;
+                    ASSERT_NEAR(m[i], rule == 2 ? m0[i] : a, 1e-5);
+                    ASSERT_NEAR(v[i], rule < 2 ? v0[i] : b, 1e-5);
+                }
+            }
+        }
+    }
+    set_isa(detected_isa());
+}
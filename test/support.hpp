@@ -0,0 +1,148 @@
+#ifndef TEST_SUPPORT_HPP
+#define TEST_SUPPORT_HPP
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "activation.hpp"
+#include "matrix.hpp"
+#include "network.hpp"
+
+// Helpers shared by the test binaries
+namespace support {
+
+// Path of a scratch file in the test temp directory. The name carries the
+// pid: ctest runs every test case in a process of its own, and concurrent
+// cases must not rewrite each other's files while they are mapped.
+inline std::string temp_path(const std::string& name) {
+    return ::testing::TempDir() + "nnpp-" + std::to_string(getpid()) + "-" +
+           name;
+}
+
+// Writes an IDX file of unsigned bytes with the given dimensions and
+// payload to temp_path(name) and returns its path
+inline std::string write_idx(
+    const std::string& name,
+    const std::vector<uint32_t>& dims,
+    const std::vector<uint8_t>& payload
+) {
+    auto path = temp_path(name);
+    std::ofstream file(path, std::ios::binary);
+    uint8_t magic[4] = {0, 0, 0x08, static_cast<uint8_t>(dims.size())};
+    file.write(reinterpret_cast<char*>(magic), 4);
+    for (uint32_t d : dims) {
+        uint8_t be[4] = {
+            static_cast<uint8_t>(d >> 24),
+            static_cast<uint8_t>(d >> 16),
+            static_cast<uint8_t>(d >> 8),
+            static_cast<uint8_t>(d)
+        };
+        file.write(reinterpret_cast<char*>(be), 4);
+    }
+    file.write(
+        reinterpret_cast<const char*>(payload.data()),
+        static_cast<std::streamsize>(payload.size())
+    );
+    return path;
+}
+
+// n x m matrix of values drawn uniformly from [low, high) with gen
+inline matrix::Matrix random_matrix(
+    size_t n,
+    size_t m,
+    std::mt19937& gen,
+    float low = -1.0f,
+    float high = 1.0f
+) {
+    std::uniform_real_distribution<float> dist(low, high);
+    return matrix::Matrix(n, m, [&](size_t, size_t) { return dist(gen); });
+}
+
+// The same from a generator seeded with seed
+inline matrix::Matrix random_matrix(
+    size_t n, size_t m, unsigned seed, float low = -1.0f, float high = 1.0f
+) {
+    std::mt19937 gen(seed);
+    return random_matrix(n, m, gen, low, high);
+}
+
+// One-hot targets for n samples, one column per sample, labelled
+// (first + b) % classes
+inline matrix::Matrix one_hot(size_t classes, size_t n, size_t first = 0) {
+    matrix::Matrix target(classes, n);
+    for (size_t b = 0; b < n; ++b) {
+        target((first + b) % classes, b) = 1.0f;
+    }
+    return target;
+}
+
+// A small seeded network of 12 inputs and 4 classes, taking batches of up
+// to batch_size samples
+inline network::Network make_network(size_t batch_size) {
+    return network::Network(
+        {12, 9, 7, 4},
+        batch_size,
+        activation::Kind::Tanh,
+        activation::Kind::Softmax,
+        5
+    );
+}
+
+// Three noisy clusters; samples are rows of the input, and target holds
+// their one-hot labels, one per column
+inline void clusters(
+    matrix::Matrix& input, matrix::Matrix& target, unsigned seed
+) {
+    std::mt19937 gen(seed);
+    std::normal_distribution<float> noise(0.0f, 0.6f);
+    for (size_t b = 0; b < input.N; ++b) {
+        size_t label = gen() % 3;
+        for (size_t j = 0; j < input.M; ++j) {
+            float center = j % 3 == label ? 1.0f : -1.0f;
+            input(b, j) = center + noise(gen);
+        }
+        for (size_t c = 0; c < 3; ++c) {
+            target(c, b) = c == label ? 1.0f : 0.0f;
+        }
+    }
+}
+
+}  // namespace support
+
+// A test binary that defines NNPP_TEST_COUNT_ALLOCATIONS before including
+// this header counts every heap allocation it makes in
+// support::allocations. The replacements of operator new are defined here,
+// so only one source file of the binary may opt in.
+#ifdef NNPP_TEST_COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// GCC cannot tell that these replacements pair malloc with free
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+namespace support {
+inline std::atomic<size_t> allocations{0};
+}  // namespace support
+
+void* operator new(size_t size) {
+    support::allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+#endif  // NNPP_TEST_COUNT_ALLOCATIONS
+
+#endif  // TEST_SUPPORT_HPP
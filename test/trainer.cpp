@@ -0,0 +1,331 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "matrix.hpp"
+#include "network.hpp"
+#include "optimizer.hpp"
+#include "parallel.hpp"
+#include "support.hpp"
+#include "trainer.hpp"
+
+using matrix::Matrix;
+using network::Network;
+using support::make_network;
+using support::one_hot;
+using support::random_matrix;
+
+// Parameters after steps of data-parallel training on batches of n
+static std::vector<float> train(size_t workers, size_t n, int steps) {
+    auto net = make_network(16);
+    trainer::DataParallel trainer(net, workers);
+    Matrix target = one_hot(4, n);
+    for (int step = 0; step < steps; ++step) {
+        Matrix input = random_matrix(n, 12, static_cast<unsigned>(step));
+        trainer.step(input, target, 0.3f);
+    }
+    auto params = net.parameters();
+    return {params.begin(), params.end()};
+}
+
+TEST(TrainerTest, OneWorkerMatchesNetworkStep) {
+    auto net = make_network(8);
+    auto reference = make_network(8);
+    trainer::DataParallel trainer(net, 1);
+    EXPECT_EQ(trainer.workers(), 1u);
+    Matrix target = one_hot(4, 8);
+    for (int step = 0; step < 5; ++step) {
+        Matrix input = random_matrix(8, 12, static_cast<unsigned>(step));
+        auto expected = reference.forward(input);
+        reference.backward(target);
+        reference.step(0.3f);
+        auto output = trainer.step(input, target, 0.3f);
+        for (size_t i = 0; i < output.N; ++i) {
+            for (size_t j = 0; j < output.M; ++j) {
+                ASSERT_EQ(output(i, j), expected(i, j));
+            }
+        }
+    }
+    auto a = net.parameters();
+    auto b = reference.parameters();
+    for (size_t i = 0; i < a.size(); ++i) {
+        ASSERT_EQ(a[i], b[i]) << i;
+    }
+}
+
+// The chunks update through the optimizer's kernel, which a single worker
+// applies like Optimizer::step; more workers only reorder the sums
+TEST(TrainerTest, OptimizerUpdatesTheChunks) {
+    optimizer::Settings settings;
+    settings.kind = optimizer::Kind::Adam;
+    auto net = make_network(8);
+    auto reference = make_network(8);
+    auto sharded = make_network(8);
+    optimizer::Optimizer adam(net, settings);
+    optimizer::Optimizer reference_adam(reference, settings);
+    optimizer::Optimizer sharded_adam(sharded, settings);
+    trainer::DataParallel trainer(net, 1, &adam);
+    trainer::DataParallel sharded_trainer(sharded, 3, &sharded_adam);
+    Matrix target = one_hot(4, 8);
+    for (int step = 0; step < 5; ++step) {
+        Matrix input = random_matrix(8, 12, static_cast<unsigned>(step));
+        reference.forward(input);
+        reference.backward(target);
+        reference_adam.step(0.01f, 8);
+        trainer.step(input, target, 0.01f);
+        sharded_trainer.step(input, target, 0.01f);
+    }
+    EXPECT_EQ(adam.steps(), 5u);
+    EXPECT_EQ(sharded_adam.steps(), 5u);
+    auto a = net.parameters();
+    auto b = reference.parameters();
+    auto c = sharded.parameters();
+    for (size_t i = 0; i < a.size(); ++i) {
+        ASSERT_EQ(a[i], b[i]) << i;
+        ASSERT_NEAR(c[i], b[i], 1e-4f) << i;
+    }
+}
+
+// Shards of 4, 4, 4 and 3 samples
+TEST(TrainerTest, ShardsFollowTheWholeBatch) {
+    auto net = make_network(15);
+    auto reference = make_network(15);
+    trainer::DataParallel trainer(net, 4);
+    Matrix input = random_matrix(15, 12, 3);
+    Matrix target = one_hot(4, 15);
+
+    auto expected = reference.forward(input);
+    reference.backward(target);
+    auto output = trainer.step(input, target, 0.3f);
+    ASSERT_EQ(output.N, 4u);
+    ASSERT_EQ(output.M, 15u);
+    for (size_t i = 0; i < output.N; ++i) {
+        for (size_t j = 0; j < output.M; ++j) {
+            EXPECT_EQ(output(i, j), expected(i, j));
+        }
+    }
+    // The reduced gradients are the sums over the whole batch, up to the
+    // order of the additions
+    auto reduced = net.gradients();
+    auto sums = reference.gradients();
+    for (size_t i = 0; i < sums.size(); ++i) {
+        EXPECT_NEAR(reduced[i], sums[i], 1e-5f * (1.0f + std::fabs(sums[i])));
+    }
+}
+
+TEST(TrainerTest, ReproducibleForFixedWorkerCount) {
+    auto first = train(3, 16, 6);
+    EXPECT_EQ(train(3, 16, 6), first);
+
+    // Other worker counts only change the order of the additions
+    auto serial = train(1, 16, 6);
+    for (size_t i = 0; i < serial.size(); ++i) {
+        EXPECT_NEAR(first[i], serial[i], 1e-5f);
+    }
+
+    // Fewer samples than workers leaves some idle
+    auto sparse = train(8, 3, 2);
+    auto sparse_serial = train(1, 3, 2);
+    for (size_t i = 0; i < sparse.size(); ++i) {
+        EXPECT_NEAR(sparse[i], sparse_serial[i], 1e-5f);
+    }
+}
+
+// Results depend on the worker count, not on the threads running them
+TEST(TrainerTest, IndependentOfThreadCount) {
+    parallel::set_num_threads(1);
+    auto single = train(4, 16, 4);
+    parallel::set_num_threads(4);
+    auto pooled = train(0, 16, 4);
+    EXPECT_EQ(pooled, single);
+    parallel::set_num_threads(0);
+}
+
+TEST(TrainerTest, RejectsInvalidBatches) {
+    auto net = make_network(8);
+    trainer::DataParallel trainer(net, 2);
+    Matrix target = one_hot(4, 8);
+    EXPECT_THROW(
+        trainer.step(random_matrix(8, 11, 1), target, 0.1f),
+        std::invalid_argument
+    );
+    EXPECT_THROW(
+        trainer.step(random_matrix(9, 12, 1), one_hot(4, 9), 0.1f),
+        std::invalid_argument
+    );
+    EXPECT_THROW(
+        trainer.step(random_matrix(7, 12, 1), target, 0.1f),
+        std::invalid_argument
+    );
+}
+
+// Samples labelled by the largest of their first four values
+static std::vector<uint8_t> labels_of(matrix::ConstMatrixView samples) {
+    std::vector<uint8_t> labels(samples.N);
+    for (size_t s = 0; s < samples.N; ++s) {
+        const float* row = samples.row(s);
+        labels[s] = static_cast<uint8_t>(std::max_element(row, row + 4) - row);
+    }
+    return labels;
+}
+
+// Squared error of net over every sample
+static float total_cost(
+    Network& net, const Matrix& samples, const std::vector<uint8_t>& labels
+) {
+    float cost = 0.0f;
+    auto output = net.forward(samples);
+    for (size_t s = 0; s < samples.N; ++s) {
+        for (size_t i = 0; i < output.N; ++i) {
+            float diff = output(i, s) - (i == labels[s] ? 1.0f : 0.0f);
+            cost += diff * diff;
+        }
+    }
+    return cost;
+}
+
+TEST(TrainerTest, HogwildOneWorkerMatchesNetworkStep) {
+    Matrix samples = random_matrix(10, 12, 8);
+    auto labels = labels_of(samples);
+    auto net = make_network(4);
+    auto reference = make_network(4);
+
+    trainer::Hogwild hogwild(net, 1, 4);
+    EXPECT_EQ(hogwild.workers(), 1u);
+    auto report = hogwild.train(samples, labels, 0, 14, 0.3f, 9);
+    EXPECT_EQ(report.samples, 14u);
+
+    // Batches of 4, 4 and 2 ending the first epoch, then 4 in the order
+    // reshuffled for the second
+    std::vector<size_t> order(10);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 gen(9);
+    size_t correct = 0;
+    for (size_t first = 0; first < 14;) {
+        if (first % 10 == 0) {
+            std::shuffle(order.begin(), order.end(), gen);
+        }
+        size_t n = std::min<size_t>(4, 10 - first % 10);
+        Matrix input(n, 12);
+        Matrix target(4, n);
+        for (size_t s = 0; s < n; ++s) {
+            size_t index = order[first % 10 + s];
+            for (size_t j = 0; j < 12; ++j) {
+                input(s, j) = samples(index, j);
+            }
+            target(labels[index], s) = 1.0f;
+        }
+        auto y = reference.forward(input);
+        for (size_t s = 0; s < n; ++s) {
+            size_t predicted = 0;
+            for (size_t i = 1; i < 4; ++i) {
+                predicted = y(i, s) > y(predicted, s) ? i : predicted;
+            }
+            correct += target(predicted, s) == 1.0f;
+        }
+        reference.backward(target);
+        reference.step(0.3f);
+        first += n;
+    }
+    EXPECT_EQ(report.correct, correct);
+    auto a = net.parameters();
+    auto b = reference.parameters();
+    for (size_t i = 0; i < a.size(); ++i) {
+        ASSERT_EQ(a[i], b[i]) << i;
+    }
+}
+
+// A run continued from a sample trains as an uninterrupted one
+TEST(TrainerTest, HogwildContinuesFromFirstSample) {
+    Matrix samples = random_matrix(10, 12, 8);
+    auto labels = labels_of(samples);
+    auto net = make_network(4);
+    auto resumed = make_network(4);
+
+    trainer::Hogwild whole(net, 1, 4);
+    auto report = whole.train(samples, labels, 0, 28, 0.3f, 5);
+    trainer::Hogwild parts(resumed, 1, 4);
+    auto head = parts.train(samples, labels, 0, 18, 0.3f, 5);
+    auto tail = parts.train(samples, labels, 18, 10, 0.3f, 5);
+    EXPECT_EQ(head.samples + tail.samples, report.samples);
+    EXPECT_EQ(head.correct + tail.correct, report.correct);
+    auto a = net.parameters();
+    auto b = resumed.parameters();
+    for (size_t i = 0; i < a.size(); ++i) {
+        ASSERT_EQ(a[i], b[i]) << i;
+    }
+}
+
+// Racing workers still bring the cost down
+TEST(TrainerTest, HogwildConverges) {
+    parallel::set_num_threads(4);
+    Matrix samples = random_matrix(256, 12, 10);
+    auto labels = labels_of(samples);
+    auto net = make_network(256);
+    float before = total_cost(net, samples, labels);
+
+    trainer::Hogwild hogwild(net, 0, 4);
+    EXPECT_EQ(hogwild.workers(), 4u);
+    auto report = hogwild.train(samples, labels, 0, 20000, 0.2f);
+    EXPECT_EQ(report.samples, 20000u);
+    EXPECT_GT(report.samples_per_second(), 0.0);
+    EXPECT_GT(report.accuracy(), 0.5);
+    EXPECT_LT(total_cost(net, samples, labels), 0.5f * before);
+    parallel::set_num_threads(0);
+}
+
+TEST(TrainerTest, HogwildRejectsInvalidData) {
+    auto net = make_network(4);
+    EXPECT_THROW(trainer::Hogwild(net, 1, 0), std::invalid_argument);
+
+    trainer::Hogwild hogwild(net, 2, 4);
+    Matrix samples = random_matrix(6, 12, 11);
+    std::vector<uint8_t> labels(6, 1);
+    std::vector<uint8_t> short_labels(5, 1);
+    EXPECT_THROW(
+        hogwild.train(samples, short_labels, 0, 10, 0.1f),
+        std::invalid_argument
+    );
+    EXPECT_THROW(
+        hogwild.train(random_matrix(6, 11, 1), labels, 0, 10, 0.1f),
+        std::invalid_argument
+    );
+    labels[3] = 4;
+    EXPECT_THROW(
+        hogwild.train(samples, labels, 0, 10, 0.1f), std::invalid_argument
+    );
+}
+
+TEST(TrainerTest, EarlyStoppingWaitsForPatience) {
+    EXPECT_EQ(trainer::parse_monitor("loss"), trainer::Monitor::Loss);
+    EXPECT_EQ(trainer::parse_monitor("accuracy"), trainer::Monitor::Accuracy);
+    EXPECT_THROW(trainer::parse_monitor("cost"), std::invalid_argument);
+
+    trainer::EarlyStopping loss(trainer::Monitor::Loss, 2);
+    EXPECT_FALSE(loss.update(0.5, 0.1));
+    EXPECT_FALSE(loss.update(0.4, 0.1));
+    EXPECT_FALSE(loss.update(0.45, 0.9));
+    // Ties do not improve
+    EXPECT_TRUE(loss.update(0.4, 0.9));
+    EXPECT_EQ(loss.best(), 0.4);
+    EXPECT_EQ(loss.best_epoch(), 1u);
+
+    trainer::EarlyStopping accuracy(trainer::Monitor::Accuracy, 1);
+    EXPECT_FALSE(accuracy.update(0.5, 0.8));
+    EXPECT_FALSE(accuracy.update(0.9, 0.85));
+    EXPECT_TRUE(accuracy.update(0.1, 0.85));
+    EXPECT_EQ(accuracy.best(), 0.85);
+
+    // Without patience only the best is tracked
+    trainer::EarlyStopping never;
+    for (int epoch = 0; epoch < 10; ++epoch) {
+        EXPECT_FALSE(never.update(1.0 + epoch, 0.0));
+    }
+    EXPECT_EQ(never.best_epoch(), 0u);
+}
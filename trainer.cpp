@@ -0,0 +1,285 @@
+#include "trainer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+#include "parallel.hpp"
+#include "simd.hpp"
+
+namespace trainer {
+
+using matrix::ConstMatrixView;
+using matrix::MatrixView;
+
+namespace {
+
+// Parameters reduced and updated by one task, a multiple of a cache line
+constexpr size_t CHUNK = 4096;
+
+}  // namespace
+
+DataParallel::DataParallel(
+    network::Network& net, size_t workers, optimizer::Optimizer* optimizer
+)
+    : net(&net),
+      optimizer(optimizer),
+      outputs(memory::make_buffer(net.output_size() * net.batch_size())) {
+    if (workers == 0) {
+        workers = parallel::num_threads();
+    }
+    size_t shard = (net.batch_size() + workers - 1) / workers;
+    replicas.reserve(workers - 1);
+    for (size_t w = 1; w < workers; ++w) {
+        replicas.emplace_back(
+            net.sizes(),
+            shard,
+            net.hidden_activation(),
+            net.output_activation()
+        );
+        auto params = net.parameters();
+        std::copy(
+            params.begin(), params.end(), replicas.back().parameters().begin()
+        );
+        replicas.back().set_storage_format(net.storage_format());
+    }
+}
+
+ConstMatrixView DataParallel::step(
+    ConstMatrixView input, ConstMatrixView target, float learning_rate
+) {
+    size_t n = input.N;
+    if (input.M != net->input_size()) {
+        throw std::invalid_argument("Input must hold one sample of input_size() values per row");
+    }
+    if (n == 0 || n > net->batch_size()) {
+        throw std::invalid_argument("Batch must hold between 1 and batch_size() samples");
+    }
+    if (target.N != net->output_size() || target.M != n) {
+        throw std::invalid_argument("Target must hold one column per sample of the batch");
+    }
+
+    // Forward and backward of every shard; the outputs are gathered into
+    // the columns of one matrix
+    size_t shard = (n + workers() - 1) / workers();
+    size_t active = (n + shard - 1) / shard;
+    MatrixView output(outputs.get(), net->output_size(), n, net->batch_size());
+    parallel::parallel_for(active, [&](size_t w) {
+        size_t first = w * shard;
+        size_t count = std::min(shard, n - first);
+        auto& replica = worker(w);
+        auto y = replica.forward(input.rows(first, count));
+        replica.backward(target.block(0, first, target.N, count));
+        for (size_t i = 0; i < y.N; ++i) {
+            std::copy(y.row(i), y.row(i) + count, output.row(i) + first);
+        }
+    });
+
+    // All-reduce: each chunk is summed over the workers in order, into the
+    // network's gradients, updated once and copied to every replica
+    auto params = net->parameters();
+    auto grads = net->gradients();
+    size_t total = params.size();
+    float alpha = -learning_rate / static_cast<float>(n);
+    parallel::parallel_for((total + CHUNK - 1) / CHUNK, [&](size_t c) {
+        size_t begin = c * CHUNK;
+        size_t count = std::min(CHUNK, total - begin);
+        float* sum = grads.data() + begin;
+        for (size_t w = 1; w < active; ++w) {
+            simd::add(sum, worker(w).gradients().data() + begin, sum, count);
+        }
+        float* p = params.data() + begin;
+        if (optimizer != nullptr) {
+            optimizer->update(begin, count, learning_rate, n);
+        } else {
+            simd::axpy(p, sum, alpha, p, count);
+        }
+        for (auto& replica : replicas) {
+            std::copy(p, p + count, replica.parameters().data() + begin);
+        }
+    });
+
+    if (optimizer != nullptr) {
+        optimizer->advance();
+    }
+
+    // Refreshes the 16-bit copies of mixed precision from the new weights
+    if (net->storage_format() != precision::Format::FP32) {
+        parallel::parallel_for(workers(), [&](size_t w) {
+            worker(w).set_storage_format(worker(w).storage_format());
+        });
+    }
+    return output;
+}
+
+double Report::accuracy() const {
+    if (samples == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(correct) / static_cast<double>(samples);
+}
+
+double Report::samples_per_second() const {
+    if (seconds <= 0.0) {
+        return 0.0;
+    }
+    return static_cast<double>(samples) / seconds;
+}
+
+Hogwild::Hogwild(network::Network& net, size_t workers, size_t batch_size)
+    : net(&net), batch_size(batch_size) {
+    if (batch_size == 0) {
+        throw std::invalid_argument("Batch size must be positive");
+    }
+    if (workers == 0) {
+        workers = parallel::num_threads();
+    }
+    states.reserve(workers);
+    for (size_t w = 0; w < workers; ++w) {
+        states.push_back(Worker{
+            network::Network(net, batch_size),
+            memory::make_buffer(batch_size * net.input_size()),
+            memory::make_buffer(net.output_size() * batch_size),
+        });
+    }
+}
+
+Report Hogwild::train(
+    ConstMatrixView samples,
+    std::span<const uint8_t> labels,
+    size_t first,
+    size_t count,
+    float learning_rate,
+    uint32_t seed
+) {
+    if (samples.M != net->input_size() || samples.N == 0 ||
+        labels.size() != samples.N) {
+        throw std::invalid_argument("Samples must hold one row of input_size() values per label");
+    }
+    size_t classes = net->output_size();
+    if (std::any_of(labels.begin(), labels.end(), [&](uint8_t label) {
+            return label >= classes;
+        })) {
+        throw std::invalid_argument("Labels must index the output layer");
+    }
+
+    std::vector<size_t> order(samples.N);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937 gen(seed);
+    // Replays the shuffles of the epochs before first's, as BatchLoader
+    // does, so that a continued run draws the orders of an uninterrupted one
+    size_t epoch = first / samples.N;
+    for (size_t e = 0; e < epoch; ++e) {
+        std::shuffle(order.begin(), order.end(), gen);
+    }
+    for (auto& worker : states) {
+        worker.correct = 0;
+        worker.cost = 0.0;
+    }
+
+    // Index of the next sample of the epoch to claim, on a cache line of
+    // its own
+    struct alignas(memory::ALIGNMENT) Counter {
+        std::atomic<size_t> next{0};
+    } counter;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t sample = first; sample < first + count; ++epoch) {
+        std::shuffle(order.begin(), order.end(), gen);
+        size_t offset = sample - epoch * samples.N;
+        size_t end = std::min(samples.N, first + count - epoch * samples.N);
+        counter.next.store(offset, std::memory_order_relaxed);
+        parallel::parallel_for(states.size(), [&](size_t w) {
+            auto& worker = states[w];
+            MatrixView input(worker.input.get(), batch_size, samples.M);
+            MatrixView target(worker.target.get(), classes, batch_size);
+            size_t correct = 0;
+            double cost = 0.0;
+            for (;;) {
+                size_t claimed = counter.next.fetch_add(
+                    batch_size, std::memory_order_relaxed
+                );
+                if (claimed >= end) {
+                    break;
+                }
+                size_t n = std::min(batch_size, end - claimed);
+                for (size_t s = 0; s < n; ++s) {
+                    size_t index = order[claimed + s];
+                    std::copy(
+                        samples.row(index),
+                        samples.row(index) + samples.M,
+                        input.row(s)
+                    );
+                    for (size_t i = 0; i < classes; ++i) {
+                        target(i, s) = i == labels[index] ? 1.0f : 0.0f;
+                    }
+                }
+
+                auto batch_target = target.block(0, 0, classes, n);
+                auto y = worker.net.forward(input.rows(0, n));
+                for (size_t s = 0; s < n; ++s) {
+                    size_t predicted = 0;
+                    for (size_t i = 0; i < classes; ++i) {
+                        float diff = y(i, s) - batch_target(i, s);
+                        cost += diff * diff;
+                        if (y(i, s) > y(predicted, s)) {
+                            predicted = i;
+                        }
+                    }
+                    correct += batch_target(predicted, s) == 1.0f;
+                }
+                worker.net.backward(batch_target);
+                worker.net.step(learning_rate);
+            }
+            worker.correct += correct;
+            worker.cost += cost;
+        });
+        sample += end - offset;
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    Report report;
+    report.seconds = std::chrono::duration<double>(elapsed).count();
+    report.samples = count;
+    for (const auto& worker : states) {
+        report.correct += worker.correct;
+        report.cost += worker.cost;
+    }
+    return report;
+}
+
+Monitor parse_monitor(const std::string& name) {
+    for (Monitor monitor : {Monitor::Loss, Monitor::Accuracy}) {
+        if (name == trainer::name(monitor)) {
+            return monitor;
+        }
+    }
+    throw std::invalid_argument("Unknown early stopping metric: " + name);
+}
+
+const char* name(Monitor monitor) {
+    switch (monitor) {
+        case Monitor::Loss:
+            return "loss";
+        case Monitor::Accuracy:
+            return "accuracy";
+    }
+    return "unknown";
+}
+
+bool EarlyStopping::update(double loss, double accuracy) {
+    double value = watched == Monitor::Loss ? loss : accuracy;
+    bool improved = watched == Monitor::Loss ? value < best_value
+                                             : value > best_value;
+    if (epochs == 0 || improved) {
+        best_value = value;
+        best_index = epochs;
+    }
+    ++epochs;
+    return limit > 0 && epochs - 1 - best_index >= limit;
+}
+
+}  // namespace trainer
@@ -0,0 +1,195 @@
+#ifndef TRAINER_HPP
+#define TRAINER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "matrix.hpp"
+#include "memory.hpp"
+#include "network.hpp"
+#include "optimizer.hpp"
+
+namespace trainer {
+
+// Synchronous data-parallel SGD on the threads of parallel::pool().
+//
+// Every worker owns a replica of the network, with its own parameters,
+// gradients and layer buffers in its own arena, and trains on one shard of
+// each mini-batch: worker w takes the samples [w * s, (w + 1) * s) for
+// shards of s = ceil(n / workers()) samples. Worker 0 is the trained network
+// itself.
+//
+// The gradients are then all-reduced the way a ring does it, in shared
+// memory: the flat parameter range is cut into chunks, and one thread per
+// chunk sums that chunk over the workers in worker order
+// (reduce-scatter), applies the update once to the network's parameters and
+// copies the result into every replica (all-gather). Each sum is taken in
+// a fixed order, so a run is bitwise reproducible for a given seed and
+// worker count, and one worker reproduces Network::step exactly. With an
+// optimizer, the update of each chunk is its fused kernel instead of SGD,
+// still in the same pass over the chunk.
+class DataParallel {
+  public:
+    // Trains net, whose batch_size() bounds the batches, on workers replicas;
+    // 0 takes one per thread of parallel::pool(). The replicas copy its
+    // parameters, activations and storage format. net must outlive the
+    // trainer, and its parameters must only change through it while it
+    // lives. Updates go through optimizer if given, which must train net
+    // and outlive the trainer, and are plain SGD otherwise.
+    explicit DataParallel(
+        network::Network& net,
+        size_t workers = 0,
+        optimizer::Optimizer* optimizer = nullptr
+    );
+
+    DataParallel(DataParallel&&) noexcept = default;
+    DataParallel& operator=(DataParallel&&) noexcept = default;
+    DataParallel(const DataParallel&) = delete;
+    DataParallel& operator=(const DataParallel&) = delete;
+
+    size_t workers() const { return replicas.size() + 1; }
+
+    // One training step on input (n x input_size(), n <= batch_size(), one
+    // sample per row) against target (output_size() x n): forward and
+    // backward of every shard, the all-reduce and one SGD update with the
+    // gradient averaged over all n samples. Afterwards the network's
+    // gradients() hold the sums over the whole batch, as after
+    // Network::backward. Returns the output of the forward passes,
+    // output_size() x n, computed before the update.
+    matrix::ConstMatrixView step(
+        matrix::ConstMatrixView input,
+        matrix::ConstMatrixView target,
+        float learning_rate
+    );
+
+  private:
+    network::Network& worker(size_t w) {
+        return w == 0 ? *net : replicas[w - 1];
+    }
+
+    network::Network* net;
+    optimizer::Optimizer* optimizer;
+    std::vector<network::Network> replicas;
+    // Output of the last step, output_size() x batch_size()
+    memory::Buffer outputs;
+};
+
+// What an asynchronous training run did
+struct Report {
+    size_t samples = 0;
+    // Samples whose prediction, made before training on them, was right
+    size_t correct = 0;
+    // Squared error summed over the samples
+    double cost = 0.0;
+    double seconds = 0.0;
+
+    double accuracy() const;
+    double samples_per_second() const;
+};
+
+// Asynchronous lock-free SGD, after Hogwild!.
+//
+// Every worker owns a network sharing the parameters of the trained one
+// (see network::Network(Network&, size_t)) with its own gradients, layer
+// buffers and batch buffers, each in allocations of its own, so workers
+// only ever write the same cache lines in the parameters. Workers claim
+// batches from a shared counter and run forward, backward and step on
+// them with no locks: updates are plain, unsynchronized float stores, and
+// concurrent ones may overwrite each other, which SGD tolerates when each
+// update is small. This is a data race by design, so runs with more than
+// one worker are not reproducible; one worker trains exactly like
+// Network::step. Workers are tasks of parallel::pool() that run until the
+// batches run out, so workers beyond its threads start after the others
+// are done and find nothing left to train on.
+class Hogwild {
+  public:
+    // Trains net on workers workers, 0 taking one per thread of
+    // parallel::pool(), each stepping on batches of up to batch_size
+    // samples. net must outlive the trainer and train in fp32.
+    Hogwild(network::Network& net, size_t workers, size_t batch_size);
+
+    Hogwild(Hogwild&&) noexcept = default;
+    Hogwild& operator=(Hogwild&&) noexcept = default;
+    Hogwild(const Hogwild&) = delete;
+    Hogwild& operator=(const Hogwild&) = delete;
+
+    size_t workers() const { return states.size(); }
+
+    // Trains on samples first to first + count of a stream passing over
+    // samples (one per row, with their classes in labels) epoch after
+    // epoch, each in a new order drawn from seed. A run continued from
+    // first visits the samples as one trained from 0 would. Batches end
+    // with their epoch, and the workers finish one epoch before starting
+    // the next. Throws std::invalid_argument for misshaped samples or a
+    // label outside the output layer.
+    Report train(
+        matrix::ConstMatrixView samples,
+        std::span<const uint8_t> labels,
+        size_t first,
+        size_t count,
+        float learning_rate,
+        uint32_t seed = 0
+    );
+
+  private:
+    // Padded to a cache line, so that the counters of neighbouring workers
+    // do not share one
+    struct alignas(memory::ALIGNMENT) Worker {
+        network::Network net;
+        // A batch gathered from the samples, one per row, and its one-hot
+        // targets, one per column
+        memory::Buffer input;
+        memory::Buffer target;
+        size_t correct = 0;
+        double cost = 0.0;
+    };
+
+    network::Network* net;
+    size_t batch_size;
+    std::vector<Worker> states;
+};
+
+// What early stopping watches on the validation split
+enum class Monitor { Loss, Accuracy };
+
+// Parses loss or accuracy.
+// Throws std::invalid_argument for any other name.
+Monitor parse_monitor(const std::string& name);
+
+const char* name(Monitor monitor);
+
+// Decides when to stop from one validation result per epoch: once patience
+// epochs in a row did not improve on the best loss (lower) or accuracy
+// (higher) so far. A patience of 0 never stops. The decision depends only
+// on the values, so ranks that validate the same weights on the same
+// split stop together.
+class EarlyStopping {
+  public:
+    explicit EarlyStopping(
+        Monitor monitor = Monitor::Loss, size_t patience = 0
+    )
+        : watched(monitor), limit(patience) {}
+
+    // Records an epoch and returns whether training should stop
+    bool update(double loss, double accuracy);
+
+    Monitor monitor() const { return watched; }
+    // Best value of the monitored metric so far, and its epoch, counted
+    // from 0 in the order of update
+    double best() const { return best_value; }
+    size_t best_epoch() const { return best_index; }
+
+  private:
+    Monitor watched;
+    size_t limit;
+    size_t epochs = 0;
+    size_t best_index = 0;
+    double best_value = 0.0;
+};
+
+}  // namespace trainer
+
+#endif  // TRAINER_HPP